@@ -0,0 +1,281 @@
+/**
+ * AES256GCM10G25GIP Kernel Driver - crypto API "gcm(aes)" AEAD provider
+ *
+ * Requests that fit the IP (256-bit key, AAD padded to 16 plus payload within the 2 KB window,
+ * non-empty payload) are queued on a crypto engine and run one at a time through aes->bounce.
+ * Everything else is handed to the next "gcm(aes)" implementation (ARM CE or generic).
+ * The crypto manager runs its gcm(aes) vectors against the provider at registration, and
+ * throughput can be compared with the software path using tcrypt (mode=211) by reloading
+ * with a low aead_priority.
+ *
+ * Kernel keys and data pass through the registers and windows of the provider's core, so KEYIN
+ * is zeroed after every request and that core refuses raw register access and mmap. Loading
+ * with aead_priority=0 keeps the provider off and raw access on every core.
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/scatterlist.h>
+#include <linux/string.h>
+#include <crypto/aes.h>
+#include <crypto/gcm.h>
+#include <crypto/aead.h>
+#include <crypto/algapi.h>
+#include <crypto/engine.h>
+#include <crypto/internal/aead.h>
+
+#include "aes-driver.h"
+
+static int aead_priority = 400;
+module_param(aead_priority, int, 0444);
+MODULE_PARM_DESC(aead_priority, "Crypto API priority of gcm(aes), above ARM CE (300) by default. "
+                 "0 disables the provider, raw register access is refused on its core otherwise");
+
+/* Device serving the algorithm, the first one probed */
+static struct aes_dev *aead_dev;
+
+/* Transform context */
+struct aes_aead_ctx {
+    struct crypto_engine_ctx enginectx;     /* Must be first, used by the crypto engine */
+    struct aes_dev *aes;                    /* Device running the requests */
+    struct crypto_aead *fallback;           /* Software gcm(aes) for requests the IP cannot run */
+    u8 key[AES_KEYSIZE_256];                /* Key for the IP, valid when keylen is 32 */
+    unsigned int keylen;
+};
+
+/* Request context */
+struct aes_aead_reqctx {
+    u32 mode;                               /* AES_MODE_ENCRYPT or AES_MODE_DECRYPT */
+    struct aead_request fallback_req;       /* Must be last, sized for the fallback */
+};
+
+/* Run one queued request on the IP, called from the engine thread */
+static int aes_aead_do_one(struct crypto_engine *engine, void *areq)
+{
+    struct aead_request *req = container_of(areq, struct aead_request, base);
+    struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+    struct aes_aead_ctx *ctx = crypto_aead_ctx(tfm);
+    struct aes_aead_reqctx *rctx = aead_request_ctx(req);
+    struct aes_dev *aes = ctx->aes;
+    unsigned int authsize = crypto_aead_authsize(tfm);
+    u32 payload = req->cryptlen - (rctx->mode == AES_MODE_DECRYPT ? authsize : 0);
+    u32 aad_pad = ALIGN(req->assoclen, 16);
+    int src_nents = sg_nents(req->src);
+    u8 tag[16], expected[16];
+    int ret;
+
+    mutex_lock(&aes->lock);
+
+    sg_pcopy_to_buffer(req->src, src_nents, aes->bounce, req->assoclen, 0);
+    sg_pcopy_to_buffer(req->src, src_nents, aes->bounce + aad_pad, payload, req->assoclen);
+    if (rctx->mode == AES_MODE_DECRYPT)
+        sg_pcopy_to_buffer(req->src, src_nents, expected, authsize, req->assoclen + payload);
+
+    aes->kernel_key = true;
+    ret = aes_hw_crypt(aes, rctx->mode, ctx->key, req->iv, aes->bounce, req->assoclen,
+                       aes->bounce + aad_pad, aes->bounce, payload, tag, AES_WAIT_IRQ, NULL);
+    if (ret)
+        goto out;
+
+    /* Tags shorter than 16 bytes are the truncated hardware tag */
+    if (rctx->mode == AES_MODE_DECRYPT) {
+        if (crypto_memneq(tag, expected, authsize)) {
+            ret = -EBADMSG;
+            goto out;
+        }
+        sg_pcopy_from_buffer(req->dst, sg_nents(req->dst), aes->bounce, payload, req->assoclen);
+    } else {
+        sg_pcopy_from_buffer(req->dst, sg_nents(req->dst), aes->bounce, payload, req->assoclen);
+        sg_pcopy_from_buffer(req->dst, sg_nents(req->dst), tag, authsize, req->assoclen + payload);
+    }
+
+out:
+    aes_hw_wipe_key(aes);
+    mutex_unlock(&aes->lock);
+    crypto_finalize_aead_request(engine, req, ret);
+    return 0;
+}
+
+/* Queue the request for the IP, or pass it to the fallback */
+static int aes_aead_crypt(struct aead_request *req, u32 mode)
+{
+    struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+    struct aes_aead_ctx *ctx = crypto_aead_ctx(tfm);
+    struct aes_aead_reqctx *rctx = aead_request_ctx(req);
+    unsigned int authsize = crypto_aead_authsize(tfm);
+    unsigned int payload;
+
+    rctx->mode = mode;
+
+    if (mode == AES_MODE_DECRYPT && req->cryptlen < authsize)
+        goto fallback;
+    payload = req->cryptlen - (mode == AES_MODE_DECRYPT ? authsize : 0);
+
+    /* The IP starts on a non-zero DATAINCNT, empty payloads go to software */
+    if (ctx->keylen == AES_KEYSIZE_256 && payload &&
+        req->assoclen <= AES_DATA_SIZE && payload <= AES_DATA_SIZE - ALIGN(req->assoclen, 16))
+        return crypto_transfer_aead_request_to_engine(ctx->aes->engine, req);
+
+fallback:
+    aead_request_set_tfm(&rctx->fallback_req, ctx->fallback);
+    aead_request_set_callback(&rctx->fallback_req, req->base.flags,
+                              req->base.complete, req->base.data);
+    aead_request_set_crypt(&rctx->fallback_req, req->src, req->dst, req->cryptlen, req->iv);
+    aead_request_set_ad(&rctx->fallback_req, req->assoclen);
+
+    return mode == AES_MODE_DECRYPT ? crypto_aead_decrypt(&rctx->fallback_req) :
+                                      crypto_aead_encrypt(&rctx->fallback_req);
+}
+
+static int aes_aead_encrypt(struct aead_request *req)
+{
+    return aes_aead_crypt(req, AES_MODE_ENCRYPT);
+}
+
+static int aes_aead_decrypt(struct aead_request *req)
+{
+    return aes_aead_crypt(req, AES_MODE_DECRYPT);
+}
+
+/* The fallback takes every key, the IP only 256-bit ones */
+static int aes_aead_setkey(struct crypto_aead *tfm, const u8 *key, unsigned int keylen)
+{
+    struct aes_aead_ctx *ctx = crypto_aead_ctx(tfm);
+    int ret;
+
+    crypto_aead_clear_flags(ctx->fallback, CRYPTO_TFM_REQ_MASK);
+    crypto_aead_set_flags(ctx->fallback, crypto_aead_get_flags(tfm) & CRYPTO_TFM_REQ_MASK);
+    ret = crypto_aead_setkey(ctx->fallback, key, keylen);
+    if (ret)
+        return ret;
+
+    ctx->keylen = keylen;
+    if (keylen == AES_KEYSIZE_256)
+        memcpy(ctx->key, key, keylen);
+    return 0;
+}
+
+static int aes_aead_setauthsize(struct crypto_aead *tfm, unsigned int authsize)
+{
+    struct aes_aead_ctx *ctx = crypto_aead_ctx(tfm);
+    int ret;
+
+    ret = crypto_gcm_check_authsize(authsize);
+    if (ret)
+        return ret;
+    return crypto_aead_setauthsize(ctx->fallback, authsize);
+}
+
+static int aes_aead_init(struct crypto_aead *tfm)
+{
+    struct aes_aead_ctx *ctx = crypto_aead_ctx(tfm);
+
+    ctx->aes = aead_dev;
+    ctx->fallback = crypto_alloc_aead(crypto_tfm_alg_name(&tfm->base), 0, CRYPTO_ALG_NEED_FALLBACK);
+    if (IS_ERR(ctx->fallback))
+        return PTR_ERR(ctx->fallback);
+
+    crypto_aead_set_reqsize(tfm, sizeof(struct aes_aead_reqctx) + crypto_aead_reqsize(ctx->fallback));
+    ctx->enginectx.op.do_one_request = aes_aead_do_one;
+    return 0;
+}
+
+static void aes_aead_exit(struct crypto_aead *tfm)
+{
+    struct aes_aead_ctx *ctx = crypto_aead_ctx(tfm);
+
+    crypto_free_aead(ctx->fallback);
+    memzero_explicit(ctx->key, sizeof(ctx->key));
+}
+
+static struct aead_alg aes_aead_alg = {
+    .setkey         = aes_aead_setkey,
+    .setauthsize    = aes_aead_setauthsize,
+    .encrypt        = aes_aead_encrypt,
+    .decrypt        = aes_aead_decrypt,
+    .init           = aes_aead_init,
+    .exit           = aes_aead_exit,
+    .ivsize         = GCM_AES_IV_SIZE,
+    .maxauthsize    = AES_BLOCK_SIZE,
+    .base = {
+        .cra_name           = "gcm(aes)",
+        .cra_driver_name    = "gcm-aes-" DRIVER_NAME,
+        .cra_flags          = CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK |
+                              CRYPTO_ALG_KERN_DRIVER_ONLY,
+        .cra_blocksize      = 1,
+        .cra_ctxsize        = sizeof(struct aes_aead_ctx),
+        .cra_module         = THIS_MODULE,
+    },
+};
+
+/* Known answer from the GCM specification (test case 14): zero key, IV and plaintext block */
+static int aes_aead_selftest(struct aes_dev *aes)
+{
+    static const u8 zero[AES_KEYSIZE_256];
+    static const u8 ct[16] = {
+        0xce, 0xa7, 0x40, 0x3d, 0x4d, 0x60, 0x6b, 0x6e, 0x07, 0x4e, 0xc5, 0xd3, 0xba, 0xf3, 0x9d, 0x18
+    };
+    static const u8 tag[16] = {
+        0xd0, 0xd1, 0xc8, 0xa7, 0x99, 0x99, 0x6b, 0xf0, 0x26, 0x5b, 0x98, 0xb5, 0xd4, 0x8a, 0xb9, 0x19
+    };
+    u8 out_tag[16];
+    int ret;
+
+    mutex_lock(&aes->lock);
+    aes->kernel_key = true;
+    ret = aes_hw_crypt(aes, AES_MODE_ENCRYPT, zero, zero, NULL, 0, zero, aes->bounce, 16, out_tag,
+                       AES_WAIT_IRQ, NULL);
+    if (!ret && (memcmp(aes->bounce, ct, 16) || memcmp(out_tag, tag, 16)))
+        ret = -EIO;
+    aes_hw_wipe_key(aes);
+    mutex_unlock(&aes->lock);
+    return ret;
+}
+
+/* Register gcm(aes) for the first device, later devices only serve the character device */
+int aes_aead_register(struct aes_dev *aes)
+{
+    int ret;
+
+    if (aead_dev || aead_priority <= 0)
+        return 0;
+
+    ret = aes_aead_selftest(aes);
+    if (ret) {
+        dev_err(aes->dev, "GCM self-test failed (%d)\n", ret);
+        return ret;
+    }
+
+    aes->engine = crypto_engine_alloc_init(aes->dev, true);
+    if (!aes->engine)
+        return -ENOMEM;
+    ret = crypto_engine_start(aes->engine);
+    if (ret)
+        goto err_engine;
+
+    aead_dev = aes;
+    aes_aead_alg.base.cra_priority = aead_priority;
+    ret = crypto_register_aead(&aes_aead_alg);
+    if (ret) {
+        aead_dev = NULL;
+        goto err_engine;
+    }
+
+    dev_info(aes->dev, "Registered %s, priority %d\n", aes_aead_alg.base.cra_driver_name, aead_priority);
+    return 0;
+
+err_engine:
+    crypto_engine_exit(aes->engine);
+    aes->engine = NULL;
+    return ret;
+}
+
+void aes_aead_unregister(struct aes_dev *aes)
+{
+    if (aead_dev != aes)
+        return;
+
+    crypto_unregister_aead(&aes_aead_alg);
+    crypto_engine_exit(aes->engine);
+    aes->engine = NULL;
+    aead_dev = NULL;
+}
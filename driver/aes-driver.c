@@ -11,57 +11,1875 @@
 #include <linux/fs.h>
 #include <linux/cdev.h>
 #include <linux/uaccess.h>
+#include <linux/slab.h>
+#include <linux/iopoll.h>
+#include <linux/mm.h>
+#include <linux/version.h>
+#include <linux/mutex.h>
+#include <linux/interrupt.h>
+#include <linux/hrtimer.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <linux/log2.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/sysfs.h>
+#include <linux/idr.h>
+#include <linux/rwsem.h>
+#include <linux/refcount.h>
+#include <linux/sched/mm.h>
+#include <asm/unaligned.h>
+#include <crypto/algapi.h>
+
+/*
+ * IORING_OP_URING_CMD passthrough from 5.19. The module builds before 6.4 only (class_create
+ * and the crypto_engine_ctx API), so the 5.19 to 6.3 form of the helpers is the one used
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+#define AES_HAVE_URING_CMD
+#include <linux/io_uring.h>
+#endif
+
+#include "aes-driver.h"
+
+#define CREATE_TRACE_POINTS
+#include "aes-trace.h"
 
-#define DRIVER_NAME "aes256gcm10g25g"
 #define DRIVER_DESC "Driver for AES256GCM10G25GIP hardware"
 #define DEVICE_NAME "aes256gcm"
 
-/* Define ioctl commands */
-#define AES_IOC_MAGIC 'a'
-#define AES_IOC_READ_REG   _IOR(AES_IOC_MAGIC, 1, struct aes_reg_data)
-#define AES_IOC_WRITE_REG  _IOW(AES_IOC_MAGIC, 2, struct aes_reg_data)
+/* Cores are /dev/aes256gcm0..N-1, the aggregate /dev/aes256gcm takes the minor after them */
+#define AES_MAX_DEVICES     8
+#define AES_AGG_MINOR       AES_MAX_DEVICES
+#define AES_MINORS          (AES_MAX_DEVICES + 1)
+
+/* Define ioctl commands */
+#define AES_IOC_MAGIC 'a'
+#define AES_IOC_READ_REG   _IOR(AES_IOC_MAGIC, 1, struct aes_reg_data)
+#define AES_IOC_WRITE_REG  _IOW(AES_IOC_MAGIC, 2, struct aes_reg_data)
+#define AES_IOC_BATCH      _IOWR(AES_IOC_MAGIC, 3, struct aes_batch)
+#define AES_IOC_GCM_RUN    _IOWR(AES_IOC_MAGIC, 4, struct aes_gcm_run)
+#define AES_IOC_WAIT       _IO(AES_IOC_MAGIC, 5)    /* Timeout in us passed by value */
+#define AES_IOC_SET_WAIT_MODE   _IOW(AES_IOC_MAGIC, 6, uint32_t)
+#define AES_IOC_GET_WAIT_STATS  _IOR(AES_IOC_MAGIC, 7, struct aes_wait_stats)
+#define AES_IOC_KEY_REGISTER    _IOWR(AES_IOC_MAGIC, 8, struct aes_key_reg)
+#define AES_IOC_KEY_UNREGISTER  _IOW(AES_IOC_MAGIC, 9, uint32_t)
+#define AES_IOC_GET_KEY_STATS   _IOR(AES_IOC_MAGIC, 10, struct aes_key_stats)
+#define AES_IOC_RING_SETUP      _IOWR(AES_IOC_MAGIC, 11, struct aes_ring_setup)
+#define AES_IOC_RING_ENTER      _IO(AES_IOC_MAGIC, 12)
+#define AES_IOC_READ_RANGE      _IOW(AES_IOC_MAGIC, 13, struct aes_range)
+#define AES_IOC_WRITE_RANGE     _IOW(AES_IOC_MAGIC, 14, struct aes_range)
+#define AES_IOC_BUF_REGISTER    _IOWR(AES_IOC_MAGIC, 15, struct aes_buf_reg)
+#define AES_IOC_BUF_UNREGISTER  _IOW(AES_IOC_MAGIC, 16, uint32_t)
+
+/* Batch operation types */
+#define AES_BATCH_READ      0   /* Read register into value */
+#define AES_BATCH_WRITE     1   /* Write value to register */
+#define AES_BATCH_POLL      2   /* Read register until it is zero, value = timeout in us (0 = default) */
+
+#define AES_BATCH_MAX_OPS       256
+
+/* Flags for AES_IOC_GCM_RUN */
+#define AES_GCM_KEEP_KEY    (1 << 0)    /* Skip KEYIN programming, reuse the loaded key (ESTALE if the kernel replaced it) */
+#define AES_GCM_FIXED_BUF   (1 << 1)    /* aad, in and out lie in one buffer of AES_IOC_BUF_REGISTER */
+
+#define AES_KEY_MAX             16384   /* Registered keys, one table for all cores */
+#define AES_UBUF_MAX            16      /* Registered buffers per file */
+#define AES_UBUF_MAX_SIZE       (64 << 20)
+
+/* Submission/completion rings, mapped with mmap at AES_RING_MMAP_OFFSET */
+#define AES_RING_MMAP_OFFSET    0x10000000  /* Past any register space */
+#define AES_RING_MAX_ENTRIES    4096
+#define AES_RING_MAX_DATA       (64 << 20)
+#define AES_RING_NEED_WAKEUP    (1 << 0)    /* Worker is idle, AES_IOC_RING_ENTER starts it */
+
+/* Latency histograms: bucket i counts times in [2^i, 2^(i+1)) ns, the last one also everything longer */
+#define AES_HIST_BUCKETS        32
+#define AES_STATS_VERSION       3
+
+#define AES_RANGE_CHUNK         0x2000  /* Bounce size of a range copy, one BRAM */
+#define AES_HYBRID_MIN_SLEEP_NS 2000    /* Shorter sleeps cost more than they save */
+#define AES_COST_SMALL_OP       64      /* Operations up to this size calibrate the fixed cost */
+
+/* Structure for register access */
+struct aes_reg_data {
+    uint32_t offset;    /* Register offset */
+    uint64_t value;     /* Value to read or write */
+    uint8_t width;      /* Access width in bits: 8, 16, 32, 64 */
+};
+
+/* One entry of a batch */
+struct aes_batch_op {
+    uint32_t offset;    /* Register offset */
+    uint32_t op;        /* AES_BATCH_READ, AES_BATCH_WRITE or AES_BATCH_POLL */
+    uint64_t value;     /* Value to write, value read or poll timeout */
+    uint8_t width;      /* Access width in bits: 8, 16, 32, 64 */
+};
+
+/* Batch of register operations executed by one ioctl */
+struct aes_batch {
+    uint64_t ops;       /* User pointer to an array of struct aes_batch_op */
+    uint32_t count;     /* Number of operations in the array */
+    uint32_t completed; /* Number of operations completed, set by the driver */
+};
+
+/* Bulk copy between user memory and the window (AES_IOC_READ_RANGE/WRITE_RANGE) */
+struct aes_range {
+    uint32_t offset;    /* Window offset */
+    uint32_t length;    /* Bytes to copy */
+    uint64_t buf;       /* User pointer */
+};
+
+/* User buffer to pin for AES_GCM_FIXED_BUF operations */
+struct aes_buf_reg {
+    uint64_t addr;      /* User address of the buffer */
+    uint64_t len;       /* Bytes, up to AES_UBUF_MAX_SIZE */
+    uint32_t index;     /* Set by the driver, for AES_IOC_BUF_UNREGISTER */
+    uint32_t reserved;  /* Must be zero */
+};
+
+/* Whole AES-GCM operation executed by one ioctl */
+struct aes_gcm_run {
+    uint8_t key[32];    /* AES-256 key, first byte is the most significant byte of KEYIN_7 */
+    uint8_t iv[12];     /* 96-bit IV, first byte is the most significant byte of IVIN_2 */
+    uint32_t mode;      /* AES_MODE_ENCRYPT, AES_MODE_DECRYPT or AES_MODE_BYPASS */
+    uint8_t tag[16];    /* Tag out for encrypt, expected tag in for decrypt */
+    uint32_t flags;     /* AES_GCM_* flags */
+    uint32_t aad_len;   /* AAD length in bytes */
+    uint32_t data_len;  /* Payload length in bytes */
+    uint32_t key_handle;/* Registered key to use instead of key, 0 = none */
+    uint64_t aad;       /* User pointer to AAD */
+    uint64_t in;        /* User pointer to input payload */
+    uint64_t out;       /* User pointer to output payload */
+};
+
+/* Completion wait counters of one open file */
+struct aes_wait_stats {
+    uint64_t waits;         /* Completion waits */
+    uint64_t sleeps;        /* Waits that slept (IRQ mode, or hybrid before spinning) */
+    uint64_t spin_iters;    /* DATAINCNT polls spent spinning */
+    uint64_t spins_saved;   /* Estimated polls avoided by hybrid sleeps */
+    uint64_t predicted_ns;  /* Sum of predicted operation times */
+    uint64_t actual_ns;     /* Sum of observed operation times (spin and hybrid) */
+};
+
+/* Key registration, the handle is returned by the driver */
+struct aes_key_reg {
+    uint8_t key[32];    /* AES-256 key, same byte order as aes_gcm_run.key */
+    uint32_t handle;    /* Handle for aes_gcm_run.key_handle, set by the driver */
+    uint32_t reserved;  /* Must be zero */
+};
+
+/* Key cache counters of the device */
+struct aes_key_stats {
+    uint64_t hits;      /* Operations that found their key already in KEYIN */
+    uint64_t misses;    /* Operations that had to program KEYIN */
+    uint32_t registered;/* Keys in the table */
+    uint32_t loaded;    /* Handle of the key in KEYIN, 0 = none or unknown */
+};
+
+/* Counters of the device and of each open file */
+enum aes_stat {
+    AES_STAT_OPS_ENCRYPT,   /* Operations started, indexed by AES_MODE_* */
+    AES_STAT_OPS_DECRYPT,
+    AES_STAT_OPS_BYPASS,
+    AES_STAT_AAD_BYTES,
+    AES_STAT_DATA_BYTES,
+    AES_STAT_IOCTLS,
+    AES_STAT_SPIN_ITERS,    /* DATAINCNT polls spent spinning */
+    AES_STAT_TIMEOUTS,
+    AES_STAT_KEY_LOADS,     /* Operations that programmed KEYIN */
+    AES_STAT_COPY_BYTES,    /* Operation data moved by CPU copies, once per copy of a byte */
+    AES_STAT_DMA_BYTES,     /* Operation data moved between memory and the windows by DMA */
+    AES_STAT_NR
+};
+
+/* Latency histograms of the device */
+enum aes_hist {
+    AES_HIST_OP,            /* DATAINCNT written to completion seen */
+    AES_HIST_REG,           /* One register access through AES_IOC_READ_REG/WRITE_REG/BATCH */
+    AES_HIST_NR
+};
+
+/* Contents of the sysfs "stats" binary attribute, summed over all CPUs */
+struct aes_stats_snapshot {
+    uint32_t version;       /* AES_STATS_VERSION */
+    uint32_t size;          /* sizeof(struct aes_stats_snapshot) */
+    uint64_t stat[AES_STAT_NR];
+    uint64_t hist[AES_HIST_NR][AES_HIST_BUCKETS];
+};
+
+/* Command area of an IORING_OP_URING_CMD SQE with cmd_op AES_IOC_GCM_RUN */
+struct aes_uring_gcm {
+    uint64_t run;       /* User pointer to struct aes_gcm_run, read when the SQE is issued */
+    uint64_t reserved;  /* Must be zero */
+};
+
+/* Ring geometry: entries and data_size are set by user space, the offsets by the driver */
+struct aes_ring_setup {
+    uint32_t entries;   /* SQ and CQ entries, power of two up to AES_RING_MAX_ENTRIES */
+    uint32_t data_size; /* Bytes of the shared data area, up to AES_RING_MAX_DATA */
+    uint32_t sq_off;    /* Offset of the SQE array in the mapping */
+    uint32_t cq_off;    /* Offset of the CQE array */
+    uint32_t data_off;  /* Offset of the data area */
+    uint32_t size;      /* Bytes to mmap at AES_RING_MMAP_OFFSET */
+};
+
+/* Ring indices at the start of the mapping, free running, masked with entries - 1 */
+struct aes_ring_hdr {
+    uint32_t sq_head;   /* Next SQE the driver takes */
+    uint32_t sq_tail;   /* Next SQE user space fills */
+    uint32_t cq_head;   /* Next CQE user space reads */
+    uint32_t cq_tail;   /* Next CQE the driver fills */
+    uint32_t entries;   /* SQ and CQ size */
+    uint32_t flags;     /* AES_RING_* flags, set by the driver */
+};
+
+/* Submission queue entry, buffers are offsets into the data area */
+struct aes_sqe {
+    uint64_t user_data; /* Returned in the CQE */
+    uint32_t key_handle;/* Registered key (AES_IOC_KEY_REGISTER) */
+    uint32_t mode;      /* AES_MODE_ENCRYPT, AES_MODE_DECRYPT or AES_MODE_BYPASS */
+    uint8_t iv[12];     /* 96-bit IV, same byte order as aes_gcm_run.iv */
+    uint32_t aad_off;   /* AAD */
+    uint32_t aad_len;
+    uint32_t in_off;    /* Input payload */
+    uint32_t out_off;   /* Output payload, may equal in_off */
+    uint32_t data_len;
+    uint8_t tag[16];    /* Expected tag for decrypt */
+};
+
+/* Completion queue entry */
+struct aes_cqe {
+    uint64_t user_data; /* From the SQE */
+    int32_t status;     /* 0 or a negative errno, -EBADMSG when the tag does not match */
+    uint32_t reserved;
+    uint8_t tag[16];    /* Tag of the operation */
+};
+
+/* Ring of one open file, the memory is shared with user space */
+struct aes_ring {
+    struct aes_file *af;        /* Owner, operations use its keys and wait mode */
+    void *mem;                  /* vmalloc_user area: header, SQEs, CQEs, data */
+    size_t size;
+    struct aes_ring_hdr *hdr;
+    struct aes_sqe *sq;
+    struct aes_cqe *cq;
+    u8 *data;
+    u32 data_size;
+    u32 mask;                   /* entries - 1 */
+    u32 sq_head;                /* Driver copies of the indices it owns, */
+    u32 cq_tail;                /* the shared ones are only written */
+    bool stop;                  /* Set on release, the worker stops at the next entry */
+    struct work_struct work;    /* Drains the SQ */
+    wait_queue_head_t wq;       /* Woken when a CQE is posted */
+};
+
+/* Per-CPU part of the device statistics, only ever added to on the local CPU */
+struct aes_stats_cpu {
+    u64 stat[AES_STAT_NR];
+    u64 hist[AES_HIST_NR][AES_HIST_BUCKETS];
+};
+
+/* Per-CPU counters of one open file */
+struct aes_file_stats {
+    u64 stat[AES_STAT_NR];
+};
+
+/* Registered key, owned by the file that registered it */
+struct aes_key {
+    u8 key[32];
+    struct aes_file *owner;
+    u32 handle;
+    struct list_head dead;          /* On the list of keys being dropped */
+};
+
+/* User buffer pinned by AES_IOC_BUF_REGISTER, mapped once so operations walk no page tables */
+struct aes_ubuf {
+    u64 addr;                       /* User address */
+    u64 len;
+    struct page **pages;
+    unsigned int nr_pages;
+    u8 *vaddr;                      /* Kernel mapping of the pinned pages, at addr */
+    struct mm_struct *mm;           /* Charged with the locked pages */
+    refcount_t ref;                 /* The table entry and every running operation */
+};
+
+/* Per open file data */
+struct aes_file {
+    struct aes_dev *aes;            /* Core behind this file, the first core for the aggregate */
+    bool agg;                       /* Opened through the aggregate, operations go to any core */
+    struct aes_dev *last;           /* Core of the last operation, AES_GCM_KEEP_KEY goes there */
+    u32 wait_mode;                  /* AES_WAIT_IRQ, AES_WAIT_SPIN or AES_WAIT_HYBRID */
+    struct aes_wait_stats stats;    /* Completion wait counters */
+    struct aes_ring *ring;          /* Submission/completion rings, NULL until AES_IOC_RING_SETUP */
+    struct aes_file_stats __percpu *counters;   /* Operations, bytes and ioctls of this file */
+    struct aes_ubuf *ubufs[AES_UBUF_MAX];       /* Registered buffers by index */
+    spinlock_t ubuf_lock;
+    struct list_head node;          /* In aes->files */
+    pid_t pid;                      /* Opener, for the debugfs file list */
+    char comm[TASK_COMM_LEN];
+};
+
+/* Global variables */
+static struct class *aes_class;
+static int aes_major;
+
+static struct cdev aes_agg_cdev;
+static DEFINE_IDA(aes_ida);
+
+/* Probed cores by id, readers are operations of aggregate files and key eviction */
+static struct aes_dev *aes_cores[AES_MAX_DEVICES];
+static DECLARE_RWSEM(aes_cores_sem);
+static atomic_t aes_core_rr = ATOMIC_INIT(0);
+
+/* Registered keys by handle, valid on every core. Lock order: aes->lock, then aes_keys_lock */
+static DEFINE_IDR(aes_keys);
+static DEFINE_MUTEX(aes_keys_lock);
+static u32 aes_key_count;
+
+static struct workqueue_struct *aes_ring_wq;
+static struct dentry *aes_debugfs_root;
+
+static unsigned int poll_interval_us = 10;
+module_param(poll_interval_us, uint, 0644);
+MODULE_PARM_DESC(poll_interval_us, "Completion poll period in us when the device has no interrupt");
+
+static unsigned int ring_idle_us = 50;
+module_param(ring_idle_us, uint, 0644);
+MODULE_PARM_DESC(ring_idle_us, "Time the ring worker keeps polling an empty SQ before it needs a doorbell");
+
+/* Counters are per CPU so the hot path never shares a cache line with another CPU */
+static inline void aes_stat_add(struct aes_dev *aes, enum aes_stat i, u64 val)
+{
+    this_cpu_add(aes->stats->stat[i], val);
+}
+
+static inline void aes_file_stat_add(struct aes_file *af, enum aes_stat i, u64 val)
+{
+    this_cpu_add(af->counters->stat[i], val);
+}
+
+static void aes_hist_add(struct aes_dev *aes, enum aes_hist h, u64 ns)
+{
+    unsigned int b = ns ? min_t(unsigned int, ilog2(ns), AES_HIST_BUCKETS - 1) : 0;
+
+    this_cpu_inc(aes->stats->hist[h][b]);
+}
+
+/* CPU copies of operation data outside aes_hw_crypt */
+static void aes_copy_add(struct aes_file *af, struct aes_dev *aes, u64 bytes)
+{
+    aes_stat_add(aes, AES_STAT_COPY_BYTES, bytes);
+    aes_file_stat_add(af, AES_STAT_COPY_BYTES, bytes);
+}
+
+/* Charge an operation run through aes_hw_crypt to the file that asked for it */
+static void aes_file_account(struct aes_file *af, struct aes_dev *aes, u32 mode, u32 aad_len,
+                             u32 data_len, bool key_load, int ret)
+{
+    if (ret == -ETIMEDOUT) {
+        aes_file_stat_add(af, AES_STAT_TIMEOUTS, 1);
+        return;
+    }
+    if (ret)
+        return;
+    aes_file_stat_add(af, AES_STAT_OPS_ENCRYPT + mode, 1);
+    aes_file_stat_add(af, AES_STAT_AAD_BYTES, aad_len);
+    aes_file_stat_add(af, AES_STAT_DATA_BYTES, data_len);
+    aes_file_stat_add(af, AES_STAT_COPY_BYTES, ALIGN(aad_len, 16) + 2 * data_len - aes->op_dma_bytes);
+    aes_file_stat_add(af, AES_STAT_DMA_BYTES, aes->op_dma_bytes);
+    if (key_load)
+        aes_file_stat_add(af, AES_STAT_KEY_LOADS, 1);
+}
+
+/* Last reference of a core: aes_remove has run and no file is open on it any more */
+static void aes_dev_release(struct kref *ref)
+{
+    struct aes_dev *aes = container_of(ref, struct aes_dev, ref);
+
+    free_percpu(aes->stats);
+    kfree(aes->bounce);
+    kfree(aes);
+}
+
+static void aes_dev_put(struct aes_dev *aes)
+{
+    kref_put(&aes->ref, aes_dev_release);
+}
+
+/* Drops the reference of probe once the devm resources of the core are released */
+static void aes_dev_put_action(void *data)
+{
+    aes_dev_put(data);
+}
+
+/* Use the registers of a file's own core, false once aes_remove has started */
+static bool aes_dev_enter(struct aes_dev *aes)
+{
+    down_read(&aes->remove_sem);
+    if (!aes->removed)
+        return true;
+    up_read(&aes->remove_sem);
+    return false;
+}
+
+static void aes_dev_exit(struct aes_dev *aes)
+{
+    up_read(&aes->remove_sem);
+}
+
+/* File operations */
+static int aes_open(struct inode *inode, struct file *file)
+{
+    struct aes_file *af;
+    struct aes_dev *aes = NULL;
+    int i;
+    
+    af = kzalloc(sizeof(*af), GFP_KERNEL);
+    if (!af)
+        return -ENOMEM;
+
+    af->counters = alloc_percpu(struct aes_file_stats);
+    if (!af->counters) {
+        kfree(af);
+        return -ENOMEM;
+    }
+
+    /*
+     * The aggregate uses the first core for register access, mmap and waits. Instance files
+     * look their core up by minor. Either way the file keeps the core until aes_release
+     */
+    down_read(&aes_cores_sem);
+    if (inode->i_cdev == &aes_agg_cdev) {
+        for (i = 0; i < AES_MAX_DEVICES && !aes; i++)
+            aes = aes_cores[i];
+        af->agg = true;
+    } else if (iminor(inode) < AES_MAX_DEVICES) {
+        aes = aes_cores[iminor(inode)];
+    }
+    if (aes)
+        kref_get(&aes->ref);
+    up_read(&aes_cores_sem);
+    if (!aes) {
+        free_percpu(af->counters);
+        kfree(af);
+        return -ENODEV;
+    }
+    af->aes = aes;
+    af->wait_mode = AES_WAIT_IRQ;
+    spin_lock_init(&af->ubuf_lock);
+    af->pid = task_tgid_nr(current);
+    get_task_comm(af->comm, current);
+    file->private_data = af;
+
+    mutex_lock(&aes->lock);
+    list_add_tail(&af->node, &aes->files);
+    mutex_unlock(&aes->lock);
+    
+    return 0;
+}
+
+/*
+ * Free keys already removed from aes_keys. An operation that looked a key up still holds its
+ * core lock, so taking every core lock both waits for it and clears loaded_key behind it
+ */
+static void aes_key_evict(struct list_head *dead)
+{
+    struct aes_key *k, *tmp;
+    struct aes_dev *aes;
+    int i;
+
+    down_read(&aes_cores_sem);
+    for (i = 0; i < AES_MAX_DEVICES; i++) {
+        aes = aes_cores[i];
+        if (!aes)
+            continue;
+        mutex_lock(&aes->lock);
+        list_for_each_entry(k, dead, dead)
+            if (aes->loaded_key == k->handle)
+                aes->loaded_key = 0;
+        mutex_unlock(&aes->lock);
+    }
+    up_read(&aes_cores_sem);
+
+    list_for_each_entry_safe(k, tmp, dead, dead) {
+        memzero_explicit(k, sizeof(*k));
+        kfree(k);
+    }
+}
+
+/* Drop the registered keys of one file */
+static void aes_key_remove_all(struct aes_file *owner)
+{
+    struct aes_key *k;
+    LIST_HEAD(dead);
+    int id;
+
+    mutex_lock(&aes_keys_lock);
+    idr_for_each_entry(&aes_keys, k, id) {
+        if (k->owner != owner)
+            continue;
+        idr_remove(&aes_keys, id);
+        aes_key_count--;
+        list_add(&k->dead, &dead);
+    }
+    mutex_unlock(&aes_keys_lock);
+
+    if (!list_empty(&dead))
+        aes_key_evict(&dead);
+}
+
+static void aes_ring_free(struct aes_ring *ring);
+static void aes_ubuf_put(struct aes_ubuf *b);
+
+static int aes_release(struct inode *inode, struct file *file)
+{
+    struct aes_file *af = file->private_data;
+    int i;
+
+    /* No mapping is left, so the worker is the only other user of the ring */
+    if (af->ring)
+        aes_ring_free(af->ring);
+
+    aes_key_remove_all(af);
+
+    for (i = 0; i < AES_UBUF_MAX; i++)
+        if (af->ubufs[i])
+            aes_ubuf_put(af->ubufs[i]);
+
+    mutex_lock(&af->aes->lock);
+    list_del(&af->node);
+    mutex_unlock(&af->aes->lock);
+    aes_dev_put(af->aes);
+
+    free_percpu(af->counters);
+    kfree(af);
+    return 0;
+}
+
+/* Operation is finished when DATAINCNT reads zero */
+static bool aes_hw_idle(struct aes_dev *aes)
+{
+    return readl(aes->regs + AES_DATAINCNT_REG) == 0;
+}
+
+/* Mark completion, the first observer (IRQ, poll timer or waiter) records the latency */
+static void aes_op_finish(struct aes_dev *aes)
+{
+    u64 ns;
+
+    if (xchg(&aes->busy, false)) {
+        ns = ktime_to_ns(ktime_sub(ktime_get(), aes->op_start));
+        aes_hist_add(aes, AES_HIST_OP, ns);
+        trace_aes_op_complete(aes, ns);
+    }
+}
+
+/* Mark completion and wake waiters */
+static void aes_op_complete(struct aes_dev *aes)
+{
+    aes_op_finish(aes);
+    wake_up_all(&aes->wq);
+}
+
+/* Called right before DATAINCNT is written with a non-zero count */
+static void aes_op_begin(struct aes_dev *aes, u32 mode, u32 aad_len, u32 data_len)
+{
+    aes_stat_add(aes, AES_STAT_OPS_ENCRYPT + mode, 1);
+    aes_stat_add(aes, AES_STAT_AAD_BYTES, aad_len);
+    aes_stat_add(aes, AES_STAT_DATA_BYTES, data_len);
+    aes->op_bytes = aad_len + data_len;
+    trace_aes_op_start(aes, mode, aad_len, data_len);
+    aes->op_start = ktime_get();
+    WRITE_ONCE(aes->busy, true);
+    if (!aes->irq)
+        hrtimer_start(&aes->poll_timer, us_to_ktime(poll_interval_us), HRTIMER_MODE_REL);
+}
+
+/* Done interrupt from the IP */
+static irqreturn_t aes_irq_handler(int irq, void *data)
+{
+    struct aes_dev *aes = data;
+
+    if (!aes_hw_idle(aes))
+        return IRQ_NONE;
+
+    aes_op_complete(aes);
+    return IRQ_HANDLED;
+}
+
+/* Paced completion poll used when there is no IRQ line */
+static enum hrtimer_restart aes_poll_timer(struct hrtimer *timer)
+{
+    struct aes_dev *aes = container_of(timer, struct aes_dev, poll_timer);
+
+    if (!aes_hw_idle(aes)) {
+        hrtimer_forward_now(timer, us_to_ktime(poll_interval_us));
+        return HRTIMER_RESTART;
+    }
+
+    aes_op_complete(aes);
+    return HRTIMER_NORESTART;
+}
+
+/* Predicted operation time from the calibrated cost model */
+static u64 aes_cost_predict(struct aes_dev *aes, u32 bytes)
+{
+    return aes->cost_base_ns + (((u64)bytes * aes->cost_byte_q8) >> 8);
+}
+
+/* Fold an observed completion time into the cost model (EWMA, weight 1/8) */
+static void aes_cost_update(struct aes_dev *aes, u32 bytes, u64 elapsed_ns)
+{
+    u64 base = aes->cost_base_ns;
+    u64 per_byte_q8;
+
+    if (bytes <= AES_COST_SMALL_OP) {
+        aes->cost_base_ns = (u32)((base * 7 + elapsed_ns) >> 3);
+        return;
+    }
+    if (elapsed_ns <= base)
+        return;
+    per_byte_q8 = div_u64((elapsed_ns - base) << 8, bytes);
+    aes->cost_byte_q8 = (u32)((aes->cost_byte_q8 * 7ULL + per_byte_q8) >> 3);
+}
+
+/* Spin on DATAINCNT until idle or deadline */
+static int aes_hw_spin(struct aes_dev *aes, ktime_t deadline, struct aes_wait_stats *stats)
+{
+    ktime_t start = ktime_get(), now;
+    u64 iters = 0;
+
+    while (!aes_hw_idle(aes)) {
+        iters++;
+        now = ktime_get();
+        if (ktime_after(now, deadline)) {
+            dev_err(aes->dev, "Operation timeout, DATAINCNT=0x%x\n",
+                    readl(aes->regs + AES_DATAINCNT_REG));
+            aes_stat_add(aes, AES_STAT_SPIN_ITERS, iters);
+            aes_stat_add(aes, AES_STAT_TIMEOUTS, 1);
+            if (stats)
+                stats->spin_iters += iters;
+            return -ETIMEDOUT;
+        }
+        cpu_relax();
+    }
+
+    /* Cost of one poll, used to count the polls a sleep avoided */
+    if (iters)
+        aes->poll_cost_ns = (u32)((aes->poll_cost_ns * 7ULL +
+                                   div_u64(ktime_to_ns(ktime_sub(ktime_get(), start)), iters)) >> 3);
+    aes_stat_add(aes, AES_STAT_SPIN_ITERS, iters);
+    if (stats)
+        stats->spin_iters += iters;
+    return 0;
+}
+
+/* Wait for the current operation with the given policy, timeout_us = 0 uses the default */
+static int aes_hw_wait_timeout(struct aes_dev *aes, u32 mode, u32 timeout_us, struct aes_wait_stats *stats)
+{
+    u32 timeout = timeout_us ? timeout_us : AES_POLL_TIMEOUT_US;
+    ktime_t deadline = ktime_add_us(ktime_get(), timeout);
+    u64 predicted, elapsed, sleep_ns;
+    ktime_t kt;
+    long ret;
+    u32 val;
+
+    if (stats)
+        stats->waits++;
+
+    /* Not started through the driver: fall back to polling the register */
+    if (!READ_ONCE(aes->busy)) {
+        ret = readl_poll_timeout(aes->regs + AES_DATAINCNT_REG, val, val == 0, 0, timeout);
+        if (ret) {
+            dev_err(aes->dev, "Operation timeout, DATAINCNT=0x%x\n", val);
+            aes_stat_add(aes, AES_STAT_TIMEOUTS, 1);
+        }
+        return ret;
+    }
+
+    predicted = aes_cost_predict(aes, aes->op_bytes);
+    if (stats)
+        stats->predicted_ns += predicted;
+
+    switch (mode) {
+    case AES_WAIT_HYBRID:
+        /* Sleep through most of the predicted time, spin only for the last stretch */
+        elapsed = ktime_to_ns(ktime_sub(ktime_get(), aes->op_start));
+        if (predicted > elapsed + (predicted >> 3) + AES_HYBRID_MIN_SLEEP_NS) {
+            sleep_ns = predicted - elapsed - (predicted >> 3);
+            kt = ns_to_ktime(sleep_ns);
+            set_current_state(TASK_UNINTERRUPTIBLE);
+            schedule_hrtimeout(&kt, HRTIMER_MODE_REL);
+            if (stats) {
+                stats->sleeps++;
+                stats->spins_saved += div_u64(sleep_ns, max_t(u32, aes->poll_cost_ns, 1));
+            }
+        }
+        fallthrough;
+    case AES_WAIT_SPIN:
+        ret = aes_hw_spin(aes, deadline, stats);
+        if (ret)
+            return ret;
+        elapsed = ktime_to_ns(ktime_sub(ktime_get(), aes->op_start));
+        aes_cost_update(aes, aes->op_bytes, elapsed);
+        if (stats)
+            stats->actual_ns += elapsed;
+        if (!aes->irq)
+            hrtimer_try_to_cancel(&aes->poll_timer);
+        break;
+
+    case AES_WAIT_IRQ:
+    default:
+        if (stats)
+            stats->sleeps++;
+        ret = wait_event_interruptible_timeout(aes->wq, !READ_ONCE(aes->busy),
+                                               usecs_to_jiffies(timeout));
+        if (ret < 0)
+            return ret;
+        if (ret == 0 && !aes_hw_idle(aes)) {
+            dev_err(aes->dev, "Operation timeout, DATAINCNT=0x%x\n",
+                    readl(aes->regs + AES_DATAINCNT_REG));
+            aes_stat_add(aes, AES_STAT_TIMEOUTS, 1);
+            return -ETIMEDOUT;
+        }
+        break;
+    }
+
+    aes_op_finish(aes);
+    return 0;
+}
+
+/* Wait with the policy selected on this file */
+static int aes_file_wait(struct aes_file *af, u32 timeout_us)
+{
+    int ret = aes_hw_wait_timeout(af->aes, af->wait_mode, timeout_us, &af->stats);
+
+    if (ret == -ETIMEDOUT)
+        aes_file_stat_add(af, AES_STAT_TIMEOUTS, 1);
+    return ret;
+}
+
+/* Read register value based on width */
+static uint64_t aes_reg_read(struct aes_dev *aes, uint32_t offset, uint8_t width)
+{
+    u64 start = ktime_get_ns();
+    uint64_t value;
+
+    switch (width) {
+    case 8:
+        value = readb(aes->regs + offset);
+        break;
+    case 16:
+        value = readw(aes->regs + offset);
+        break;
+    case 64:
+        value = readq(aes->regs + offset);
+        break;
+    case 32:
+    default:
+        value = readl(aes->regs + offset);
+        break;
+    }
+
+    aes_hist_add(aes, AES_HIST_REG, ktime_get_ns() - start);
+    trace_aes_reg_read(aes, offset, width, value);
+    return value;
+}
+
+/* Write register value based on width */
+static void aes_reg_write(struct aes_file *af, uint32_t offset, uint8_t width, uint64_t value)
+{
+    struct aes_dev *aes = af->aes;
+    u32 mode, aad_len;
+    u64 start;
+
+    /* Writing DATAINCNT starts an operation */
+    if (offset == AES_DATAINCNT_REG && value) {
+        mode = readl(aes->regs + AES_BYPASS_REG) ? AES_MODE_BYPASS :
+               (readl(aes->regs + AES_DECEN_REG) ? AES_MODE_DECRYPT : AES_MODE_ENCRYPT);
+        aad_len = readl(aes->regs + AES_AADINCNT_REG);
+        aes_op_begin(aes, mode, aad_len, (u32)value);
+        aes_file_stat_add(af, AES_STAT_OPS_ENCRYPT + mode, 1);
+        aes_file_stat_add(af, AES_STAT_AAD_BYTES, aad_len);
+        aes_file_stat_add(af, AES_STAT_DATA_BYTES, (u32)value);
+    } else if (offset >= AES_KEYIN_0_REG && offset < AES_IVIN_0_REG) {
+        aes->kernel_key = false;
+        aes->loaded_key = 0;
+    }
+
+    trace_aes_reg_write(aes, offset, width, value);
+    start = ktime_get_ns();
+    switch (width) {
+    case 8:
+        writeb(value, aes->regs + offset);
+        break;
+    case 16:
+        writew(value, aes->regs + offset);
+        break;
+    case 64:
+        writeq(value, aes->regs + offset);
+        break;
+    case 32:
+    default:
+        writel(value, aes->regs + offset);
+        break;
+    }
+    aes_hist_add(aes, AES_HIST_REG, ktime_get_ns() - start);
+}
+
+/*
+ * Copy a range of the window to or from user memory, memcpy_toio/memcpy_fromio use the
+ * widest aligned accesses. DATAINCNT starts operations, so it is only written by WRITE_REG
+ */
+static long aes_range_copy(struct aes_file *af, struct aes_range __user *urange, bool write)
+{
+    struct aes_dev *aes = af->aes;
+    struct aes_range range;
+    u32 pos, len;
+    long ret = 0;
+    u8 *buf;
+
+    if (copy_from_user(&range, urange, sizeof(range)))
+        return -EFAULT;
+
+    if (!range.length || (u64)range.offset + range.length > resource_size(aes->res)) {
+        dev_err(aes->dev, "Invalid range: 0x%x+0x%x\n", range.offset, range.length);
+        return -EINVAL;
+    }
+    if (write && range.offset < AES_DATAINCNT_REG + 4 &&
+        range.offset + range.length > AES_DATAINCNT_REG)
+        return -EINVAL;
+
+    buf = kmalloc(min_t(u32, range.length, AES_RANGE_CHUNK), GFP_KERNEL);
+    if (!buf)
+        return -ENOMEM;
+
+    /* Operations of other paths stage data and keys in the window under the same lock */
+    mutex_lock(&aes->lock);
+    if (write && range.offset < AES_IVIN_0_REG &&
+        range.offset + range.length > AES_KEYIN_0_REG) {
+        aes->kernel_key = false;
+        aes->loaded_key = 0;
+    }
+
+    if (write)
+        trace_aes_copy_in(aes, range.length);
+    else
+        trace_aes_copy_out(aes, range.length);
+
+    for (pos = 0; pos < range.length; pos += len) {
+        len = min_t(u32, range.length - pos, AES_RANGE_CHUNK);
+        if (write) {
+            if (copy_from_user(buf, u64_to_user_ptr(range.buf + pos), len)) {
+                ret = -EFAULT;
+                break;
+            }
+            memcpy_toio(aes->regs + range.offset + pos, buf, len);
+        } else {
+            memcpy_fromio(buf, aes->regs + range.offset + pos, len);
+            if (copy_to_user(u64_to_user_ptr(range.buf + pos), buf, len)) {
+                ret = -EFAULT;
+                break;
+            }
+        }
+    }
+    mutex_unlock(&aes->lock);
+
+    kfree(buf);
+    return ret;
+}
+
+/* Run a batch of register operations back to back, stop at the first failure */
+static long aes_batch_run(struct aes_file *af, struct aes_batch __user *ubatch)
+{
+    struct aes_dev *aes = af->aes;
+    struct aes_batch batch;
+    struct aes_batch_op *ops, *op;
+    uint32_t val;
+    long ret = 0;
+    uint32_t i;
+
+    if (copy_from_user(&batch, ubatch, sizeof(batch)))
+        return -EFAULT;
+
+    if (batch.count == 0 || batch.count > AES_BATCH_MAX_OPS)
+        return -EINVAL;
+
+    ops = kmalloc_array(batch.count, sizeof(*ops), GFP_KERNEL);
+    if (!ops)
+        return -ENOMEM;
+
+    if (copy_from_user(ops, u64_to_user_ptr(batch.ops), batch.count * sizeof(*ops))) {
+        kfree(ops);
+        return -EFAULT;
+    }
+
+    /* Raw writes reach KEYIN and the windows, so they exclude the other paths like a whole operation */
+    mutex_lock(&aes->lock);
+    for (i = 0; i < batch.count; i++) {
+        op = &ops[i];
+
+        /* Validate register offset */
+        if (op->offset >= resource_size(aes->res)) {
+            dev_err(aes->dev, "Invalid register offset: 0x%x\n", op->offset);
+            ret = -EINVAL;
+            break;
+        }
+
+        switch (op->op) {
+        case AES_BATCH_READ:
+            op->value = aes_reg_read(aes, op->offset, op->width);
+            break;
+        case AES_BATCH_WRITE:
+            aes_reg_write(af, op->offset, op->width, op->value);
+            break;
+        case AES_BATCH_POLL:
+            /* Completion of a started operation sleeps instead of spinning */
+            if (op->offset == AES_DATAINCNT_REG) {
+                ret = aes_file_wait(af, op->value);
+                op->value = readl(aes->regs + op->offset);
+                break;
+            }
+            ret = readl_poll_timeout(aes->regs + op->offset, val, val == 0, 0,
+                                     op->value ? op->value : AES_POLL_TIMEOUT_US);
+            op->value = val;
+            break;
+        default:
+            ret = -EINVAL;
+            break;
+        }
+        if (ret)
+            break;
+    }
+    mutex_unlock(&aes->lock);
+
+    /* Return read results and the number of completed operations in one copy-out */
+    batch.completed = i;
+    if (copy_to_user(u64_to_user_ptr(batch.ops), ops, batch.count * sizeof(*ops)) ||
+        copy_to_user(ubatch, &batch, sizeof(batch)))
+        ret = -EFAULT;
+
+    kfree(ops);
+    return ret;
+}
+
+/* Program KEYIN_0..7 from a big-endian key */
+static void aes_hw_set_key(struct aes_dev *aes, const u8 *key)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+        writel(get_unaligned_be32(key + 4 * (7 - i)), aes->regs + AES_KEYIN_0_REG + 4 * i);
+}
+
+/* Clear KEYIN_0..7 so that a kernel key does not outlive its request, see aes-driver.h */
+void aes_hw_wipe_key(struct aes_dev *aes)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+        writel(0, aes->regs + AES_KEYIN_0_REG + 4 * i);
+    aes->loaded_key = 0;
+}
+
+/* Program IVIN_0..2 from a big-endian IV */
+static void aes_hw_set_iv(struct aes_dev *aes, const u8 *iv)
+{
+    int i;
+
+    for (i = 0; i < 3; i++)
+        writel(get_unaligned_be32(iv + 4 * (2 - i)), aes->regs + AES_IVIN_0_REG + 4 * i);
+}
+
+/* Read TAG_0..3 into a big-endian tag */
+static void aes_hw_get_tag(struct aes_dev *aes, u8 *tag)
+{
+    int i;
+
+    for (i = 0; i < 4; i++)
+        put_unaligned_be32(readl(aes->regs + AES_TAG_0_REG + 4 * i), tag + 4 * (3 - i));
+}
+
+/* Set mode and lengths, writing DATAINCNT starts the operation */
+static void aes_hw_start(struct aes_dev *aes, u32 mode, u32 aad_len, u32 data_len)
+{
+    if (mode == AES_MODE_BYPASS) {
+        writel(1, aes->regs + AES_BYPASS_REG);
+    } else {
+        writel(mode, aes->regs + AES_DECEN_REG);
+        writel(0, aes->regs + AES_BYPASS_REG);
+    }
+    writel(0, aes->regs + AES_ADDR_A1_REG);
+    writel(0, aes->regs + AES_ADDR_A2_REG);
+    writel(aad_len, aes->regs + AES_AADINCNT_REG);
+    if (data_len)
+        aes_op_begin(aes, mode, aad_len, data_len);
+    writel(data_len, aes->regs + AES_DATAINCNT_REG);
+}
+
+/* Run one operation, see aes-driver.h */
+int aes_hw_crypt(struct aes_dev *aes, u32 mode, const u8 *key, const u8 *iv,
+                 const u8 *aad, u32 aad_len, const u8 *in, u8 *out, u32 data_len, u8 *tag,
+                 u32 wait_mode, struct aes_wait_stats *stats)
+{
+    u32 aad_pad = ALIGN(aad_len, 16);
+    u32 dma = 0;
+    int ret;
+
+    aes->op_dma_bytes = 0;
+    ret = aes_hw_wait_timeout(aes, wait_mode, 0, stats);
+    if (ret)
+        return ret;
+
+    /* Callers loading a registered key set loaded_key again afterwards */
+    if (key) {
+        trace_aes_key_load(aes);
+        aes_hw_set_key(aes, key);
+        aes->loaded_key = 0;
+        aes_stat_add(aes, AES_STAT_KEY_LOADS, 1);
+    }
+    aes_hw_set_iv(aes, iv);
+
+    trace_aes_copy_in(aes, aad_pad + data_len);
+    if (aes_mover_to_dev(aes, AES_DATAIN_OFFSET, aad, aad_len))
+        dma += aad_len;
+    if (aad_pad != aad_len)
+        memset_io(aes->regs + AES_DATAIN_OFFSET + aad_len, 0, aad_pad - aad_len);
+    if (aes_mover_to_dev(aes, AES_DATAIN_OFFSET + aad_pad, in, data_len))
+        dma += data_len;
+    aes_hw_start(aes, mode, aad_len, data_len);
+
+    ret = aes_hw_wait_timeout(aes, wait_mode, 0, stats);
+    if (ret)
+        return ret;
+
+    trace_aes_copy_out(aes, data_len);
+    aes_hw_get_tag(aes, tag);
+    if (aes_mover_from_dev(aes, out, AES_DATAOUT_OFFSET + aad_pad, data_len))
+        dma += data_len;
+    aes_stat_add(aes, AES_STAT_COPY_BYTES, aad_pad + 2 * data_len - dma);
+    aes_stat_add(aes, AES_STAT_DMA_BYTES, dma);
+    aes->op_dma_bytes = dma;
+    return 0;
+}
+
+/*
+ * Core for one operation of bytes. Instance files always use their core, aggregate files the
+ * core with the least outstanding predicted work, rotating the start so idle cores share ties.
+ * The work is accounted until aes_core_put
+ */
+static struct aes_dev *aes_core_get(struct aes_file *af, bool keep_key, u32 bytes, u64 *cost)
+{
+    struct aes_dev *aes = NULL, *c;
+    s64 load, best = S64_MAX;
+    int i, start;
+
+    if (!af->agg) {
+        aes = af->aes;
+        if (!aes_dev_enter(aes))
+            return ERR_PTR(-ENODEV);
+    } else {
+        down_read(&aes_cores_sem);
+        if (keep_key) {
+            /* The loaded key is on the core of the previous operation, if it is still there */
+            c = READ_ONCE(af->last);
+            for (i = 0; i < AES_MAX_DEVICES && !aes; i++)
+                if (c && aes_cores[i] == c)
+                    aes = c;
+        } else {
+            start = atomic_inc_return(&aes_core_rr);
+            for (i = 0; i < AES_MAX_DEVICES; i++) {
+                c = aes_cores[(start + i) % AES_MAX_DEVICES];
+                if (!c)
+                    continue;
+                load = atomic64_read(&c->pending_ns);
+                if (load < best) {
+                    best = load;
+                    aes = c;
+                }
+            }
+        }
+        if (!aes) {
+            up_read(&aes_cores_sem);
+            return ERR_PTR(keep_key ? -ESTALE : -ENODEV);
+        }
+    }
+
+    *cost = aes_cost_predict(aes, bytes);
+    atomic64_add(*cost, &aes->pending_ns);
+    return aes;
+}
+
+static void aes_core_put(struct aes_file *af, struct aes_dev *aes, u64 cost)
+{
+    atomic64_sub(cost, &aes->pending_ns);
+    WRITE_ONCE(af->last, aes);
+    if (af->agg)
+        up_read(&aes_cores_sem);
+    else
+        aes_dev_exit(aes);
+}
+
+/* Key of a registered handle, NULL when it is still in KEYIN. Caller holds aes->lock */
+static int aes_key_lookup(struct aes_dev *aes, struct aes_file *af, u32 handle, const u8 **key)
+{
+    struct aes_key *k;
+
+    mutex_lock(&aes_keys_lock);
+    k = idr_find(&aes_keys, handle);
+    mutex_unlock(&aes_keys_lock);
+    if (!k || k->owner != af)
+        return -ENOENT;
+
+    /*
+     * KEYIN is only written when another key was used since this one. A writable mapping of
+     * the control registers can change KEYIN behind the driver, so it disables the cache
+     */
+    if (aes->loaded_key == handle && !atomic_read(&aes->ctrl_maps)) {
+        *key = NULL;
+        aes->key_hits++;
+    } else {
+        *key = k->key;
+        aes->key_misses++;
+    }
+    return 0;
+}
+
+/* Validate an AES_IOC_GCM_RUN request */
+static int aes_gcm_check(const struct aes_gcm_run *run)
+{
+    if (run->mode > AES_MODE_BYPASS || (run->flags & ~(AES_GCM_KEEP_KEY | AES_GCM_FIXED_BUF)) ||
+        ((run->flags & AES_GCM_KEEP_KEY) && run->key_handle))
+        return -EINVAL;
+
+    /* AAD is zero padded to 16 bytes and followed by the payload */
+    if (run->aad_len > AES_DATA_SIZE || run->data_len > AES_DATA_SIZE - ALIGN(run->aad_len, 16))
+        return -EINVAL;
+    return 0;
+}
+
+/*
+ * Run a checked request from kernel buffers, out may be aad. Decrypted data must only be
+ * released on success. Caller holds aes->lock
+ */
+static int aes_gcm_exec(struct aes_file *af, struct aes_dev *aes, const struct aes_gcm_run *run,
+                        const u8 *aad, const u8 *in, u8 *out, u8 *tag)
+{
+    const u8 *key;
+    int ret;
+
+    if (run->key_handle) {
+        ret = aes_key_lookup(aes, af, run->key_handle, &key);
+        if (ret)
+            return ret;
+    } else if (run->flags & AES_GCM_KEEP_KEY) {
+        /* A crypto API request loaded its own key since this file set one */
+        if (aes->kernel_key)
+            return -ESTALE;
+        key = NULL;
+    } else {
+        key = run->key;
+    }
+    aes->kernel_key = false;
+
+    ret = aes_hw_crypt(aes, run->mode, key, run->iv, aad, run->aad_len, in, out, run->data_len, tag,
+                       af->wait_mode, &af->stats);
+    aes_file_account(af, aes, run->mode, run->aad_len, run->data_len, key, ret);
+    if (run->key_handle)
+        aes->loaded_key = ret ? 0 : run->key_handle;
+    if (ret)
+        return ret;
+
+    if (run->mode == AES_MODE_DECRYPT && crypto_memneq(tag, run->tag, 16))
+        return -EBADMSG;
+    return 0;
+}
+
+static void aes_ubuf_put(struct aes_ubuf *b)
+{
+    if (!refcount_dec_and_test(&b->ref))
+        return;
+    vunmap((void *)((unsigned long)b->vaddr & PAGE_MASK));
+    unpin_user_pages_dirty_lock(b->pages, b->nr_pages, true);
+    account_locked_vm(b->mm, b->nr_pages, false);
+    mmdrop(b->mm);
+    kvfree(b->pages);
+    kfree(b);
+}
+
+/* [addr, addr + len) lies in the buffer */
+static bool aes_ubuf_holds(const struct aes_ubuf *b, u64 addr, u32 len)
+{
+    return addr >= b->addr && len <= b->len && addr - b->addr <= b->len - len;
+}
+
+/* Registered buffer holding [addr, addr + len), with a reference for the caller */
+static struct aes_ubuf *aes_ubuf_get(struct aes_file *af, u64 addr, u32 len)
+{
+    struct aes_ubuf *b = NULL;
+    int i;
+
+    spin_lock(&af->ubuf_lock);
+    for (i = 0; i < AES_UBUF_MAX; i++) {
+        if (af->ubufs[i] && aes_ubuf_holds(af->ubufs[i], addr, len)) {
+            b = af->ubufs[i];
+            refcount_inc(&b->ref);
+            break;
+        }
+    }
+    spin_unlock(&af->ubuf_lock);
+    return b;
+}
+
+static long aes_buf_unregister(struct aes_file *af, u32 index)
+{
+    struct aes_ubuf *b;
+
+    if (index >= AES_UBUF_MAX)
+        return -EINVAL;
+
+    spin_lock(&af->ubuf_lock);
+    b = af->ubufs[index];
+    af->ubufs[index] = NULL;
+    spin_unlock(&af->ubuf_lock);
+    if (!b)
+        return -ENOENT;
+
+    /* Operations still using the buffer hold their own reference */
+    aes_ubuf_put(b);
+    return 0;
+}
+
+/*
+ * Pin a user buffer for the lifetime of its registration, as io_uring fixed buffers. The
+ * pages are charged to RLIMIT_MEMLOCK and mapped contiguously, so an operation on the buffer
+ * is a table lookup and the copies between the pages and the window
+ */
+static long aes_buf_register(struct aes_file *af, struct aes_buf_reg __user *ureg)
+{
+    struct aes_buf_reg reg;
+    struct aes_ubuf *b;
+    unsigned long start, end;
+    void *vaddr;
+    long ret;
+    int pinned, i;
+
+    if (copy_from_user(&reg, ureg, sizeof(reg)))
+        return -EFAULT;
+    if (!reg.len || reg.len > AES_UBUF_MAX_SIZE || reg.reserved || reg.addr + reg.len < reg.addr)
+        return -EINVAL;
+
+    b = kzalloc(sizeof(*b), GFP_KERNEL);
+    if (!b)
+        return -ENOMEM;
+    start = reg.addr & PAGE_MASK;
+    end = PAGE_ALIGN(reg.addr + reg.len);
+    b->nr_pages = (end - start) >> PAGE_SHIFT;
+    b->pages = kvmalloc_array(b->nr_pages, sizeof(*b->pages), GFP_KERNEL);
+    if (!b->pages) {
+        ret = -ENOMEM;
+        goto err_free;
+    }
+
+    ret = account_locked_vm(current->mm, b->nr_pages, true);
+    if (ret)
+        goto err_free;
+    b->mm = current->mm;
+    mmgrab(b->mm);
+
+    pinned = pin_user_pages_fast(start, b->nr_pages, FOLL_WRITE | FOLL_LONGTERM, b->pages);
+    if (pinned != b->nr_pages) {
+        if (pinned > 0)
+            unpin_user_pages(b->pages, pinned);
+        ret = pinned < 0 ? pinned : -EFAULT;
+        goto err_unaccount;
+    }
+
+    vaddr = vmap(b->pages, b->nr_pages, VM_MAP, PAGE_KERNEL);
+    if (!vaddr) {
+        unpin_user_pages(b->pages, b->nr_pages);
+        ret = -ENOMEM;
+        goto err_unaccount;
+    }
+    b->vaddr = vaddr + offset_in_page(reg.addr);
+    b->addr = reg.addr;
+    b->len = reg.len;
+    refcount_set(&b->ref, 1);
+
+    spin_lock(&af->ubuf_lock);
+    for (i = 0; i < AES_UBUF_MAX && af->ubufs[i]; i++)
+        ;
+    if (i < AES_UBUF_MAX)
+        af->ubufs[i] = b;
+    spin_unlock(&af->ubuf_lock);
+    if (i == AES_UBUF_MAX) {
+        aes_ubuf_put(b);
+        return -ENOSPC;
+    }
+
+    reg.index = i;
+    if (copy_to_user(&ureg->index, &reg.index, sizeof(reg.index))) {
+        aes_buf_unregister(af, i);
+        return -EFAULT;
+    }
+    return 0;
+
+err_unaccount:
+    account_locked_vm(b->mm, b->nr_pages, false);
+    mmdrop(b->mm);
+err_free:
+    kvfree(b->pages);
+    kfree(b);
+    return ret;
+}
+
+/*
+ * AES_GCM_FIXED_BUF: AAD and payload are copied once between the pinned pages and the
+ * window. Decrypted data still passes aes->bounce so that it is only released on success
+ */
+static long aes_gcm_run_fixed(struct aes_file *af, struct aes_gcm_run __user *urun,
+                              const struct aes_gcm_run *run)
+{
+    struct aes_ubuf *b;
+    struct aes_dev *aes;
+    u8 tag[16];
+    u8 *out;
+    u64 cost;
+    long ret;
+
+    b = aes_ubuf_get(af, run->data_len ? run->in : run->aad, run->data_len ? run->data_len : run->aad_len);
+    if (!b)
+        return -EFAULT;
+    if (!aes_ubuf_holds(b, run->aad, run->aad_len) || !aes_ubuf_holds(b, run->in, run->data_len) ||
+        !aes_ubuf_holds(b, run->out, run->data_len)) {
+        ret = -EFAULT;
+        goto out_put;
+    }
+
+    aes = aes_core_get(af, run->flags & AES_GCM_KEEP_KEY, run->aad_len + run->data_len, &cost);
+    if (IS_ERR(aes)) {
+        ret = PTR_ERR(aes);
+        goto out_put;
+    }
+    mutex_lock(&aes->lock);
+
+    out = run->mode == AES_MODE_DECRYPT ? aes->bounce : b->vaddr + (run->out - b->addr);
+    ret = aes_gcm_exec(af, aes, run, b->vaddr + (run->aad - b->addr), b->vaddr + (run->in - b->addr),
+                       out, tag);
+    if (!ret && run->mode == AES_MODE_DECRYPT) {
+        memcpy(b->vaddr + (run->out - b->addr), aes->bounce, run->data_len);
+        aes_copy_add(af, aes, run->data_len);
+    }
+
+    mutex_unlock(&aes->lock);
+    aes_core_put(af, aes, cost);
+
+    if (!ret && copy_to_user(urun->tag, tag, sizeof(tag)))
+        ret = -EFAULT;
+out_put:
+    aes_ubuf_put(b);
+    return ret;
+}
+
+/* Run a whole operation: user buffers are staged through aes->bounce */
+static long aes_gcm_run(struct aes_file *af, struct aes_gcm_run __user *urun)
+{
+    struct aes_dev *aes;
+    struct aes_gcm_run run;
+    u8 tag[16];
+    u32 aad_pad;
+    u64 cost;
+    long ret;
+
+    if (copy_from_user(&run, urun, sizeof(run)))
+        return -EFAULT;
+
+    ret = aes_gcm_check(&run);
+    if (ret)
+        return ret;
+    if (run.flags & AES_GCM_FIXED_BUF)
+        return aes_gcm_run_fixed(af, urun, &run);
+    aad_pad = ALIGN(run.aad_len, 16);
+
+    aes = aes_core_get(af, run.flags & AES_GCM_KEEP_KEY, run.aad_len + run.data_len, &cost);
+    if (IS_ERR(aes))
+        return PTR_ERR(aes);
+    mutex_lock(&aes->lock);
+
+    if (copy_from_user(aes->bounce, u64_to_user_ptr(run.aad), run.aad_len) ||
+        copy_from_user(aes->bounce + aad_pad, u64_to_user_ptr(run.in), run.data_len)) {
+        ret = -EFAULT;
+        goto out;
+    }
+    aes_copy_add(af, aes, run.aad_len + run.data_len);
+
+    ret = aes_gcm_exec(af, aes, &run, aes->bounce, aes->bounce + aad_pad, aes->bounce, tag);
+    if (ret)
+        goto out;
+
+    if (copy_to_user(u64_to_user_ptr(run.out), aes->bounce, run.data_len) ||
+        copy_to_user(urun->tag, tag, sizeof(tag)))
+        ret = -EFAULT;
+    else
+        aes_copy_add(af, aes, run.data_len);
+
+out:
+    mutex_unlock(&aes->lock);
+    aes_core_put(af, aes, cost);
+    return ret;
+}
+
+/* Add a key to the device table, the user copy happens once here */
+static long aes_key_register(struct aes_file *af, struct aes_key_reg __user *ureg)
+{
+    struct aes_key_reg reg;
+    struct aes_key *k;
+    int id;
+
+    if (copy_from_user(&reg, ureg, sizeof(reg)))
+        return -EFAULT;
+    if (reg.reserved) {
+        memzero_explicit(&reg, sizeof(reg));
+        return -EINVAL;
+    }
+
+    k = kzalloc(sizeof(*k), GFP_KERNEL);
+    if (!k) {
+        memzero_explicit(&reg, sizeof(reg));
+        return -ENOMEM;
+    }
+    memcpy(k->key, reg.key, sizeof(k->key));
+    memzero_explicit(&reg, sizeof(reg));
+    k->owner = af;
+
+    /* Cyclic handles: a stale loaded_key cannot match a newly registered key */
+    mutex_lock(&aes_keys_lock);
+    if (aes_key_count >= AES_KEY_MAX)
+        id = -ENOSPC;
+    else
+        id = idr_alloc_cyclic(&aes_keys, k, 1, 0, GFP_KERNEL);
+    if (id > 0) {
+        k->handle = id;
+        aes_key_count++;
+    }
+    mutex_unlock(&aes_keys_lock);
+
+    if (id < 0) {
+        memzero_explicit(k, sizeof(*k));
+        kfree(k);
+        return id;
+    }
+
+    /* Not used yet, the handle was never returned */
+    if (put_user((u32)id, &ureg->handle)) {
+        mutex_lock(&aes_keys_lock);
+        idr_remove(&aes_keys, id);
+        aes_key_count--;
+        mutex_unlock(&aes_keys_lock);
+        memzero_explicit(k, sizeof(*k));
+        kfree(k);
+        return -EFAULT;
+    }
+    return 0;
+}
+
+static long aes_key_unregister(struct aes_file *af, u32 handle)
+{
+    struct aes_key *k;
+    LIST_HEAD(dead);
+
+    mutex_lock(&aes_keys_lock);
+    k = idr_find(&aes_keys, handle);
+    if (!k || k->owner != af) {
+        mutex_unlock(&aes_keys_lock);
+        return -ENOENT;
+    }
+    idr_remove(&aes_keys, handle);
+    aes_key_count--;
+    mutex_unlock(&aes_keys_lock);
+
+    list_add(&k->dead, &dead);
+    aes_key_evict(&dead);
+    return 0;
+}
+
+/* Key cache counters of the file's core, summed over all cores for the aggregate */
+static void aes_key_stats_get(struct aes_file *af, struct aes_key_stats *ks)
+{
+    struct aes_dev *aes;
+    int i;
+
+    memset(ks, 0, sizeof(*ks));
+    ks->registered = READ_ONCE(aes_key_count);
+
+    if (!af->agg) {
+        aes = af->aes;
+        mutex_lock(&aes->lock);
+        ks->hits = aes->key_hits;
+        ks->misses = aes->key_misses;
+        ks->loaded = aes->loaded_key;
+        mutex_unlock(&aes->lock);
+        return;
+    }
+
+    down_read(&aes_cores_sem);
+    for (i = 0; i < AES_MAX_DEVICES; i++) {
+        aes = aes_cores[i];
+        if (!aes)
+            continue;
+        mutex_lock(&aes->lock);
+        ks->hits += aes->key_hits;
+        ks->misses += aes->key_misses;
+        mutex_unlock(&aes->lock);
+    }
+    up_read(&aes_cores_sem);
+}
+
+/* Check that [off, off + len) lies in the data area */
+static bool aes_ring_range_ok(struct aes_ring *ring, u32 off, u32 len)
+{
+    return (u64)off + len <= ring->data_size;
+}
+
+/* Run one SQE, return the CQE status */
+static int aes_ring_run(struct aes_ring *ring, const struct aes_sqe *sqe, u8 *tag)
+{
+    struct aes_file *af = ring->af;
+    struct aes_dev *aes;
+    const u8 *key;
+    u8 hw_tag[16];
+    u64 cost;
+    u8 *out;
+    int ret;
+
+    if (sqe->mode > AES_MODE_BYPASS || !sqe->key_handle || sqe->aad_len > AES_DATA_SIZE ||
+        sqe->data_len > AES_DATA_SIZE - ALIGN(sqe->aad_len, 16) ||
+        !aes_ring_range_ok(ring, sqe->aad_off, sqe->aad_len) ||
+        !aes_ring_range_ok(ring, sqe->in_off, sqe->data_len) ||
+        !aes_ring_range_ok(ring, sqe->out_off, sqe->data_len))
+        return -EINVAL;
+
+    aes = aes_core_get(af, false, sqe->aad_len + sqe->data_len, &cost);
+    if (IS_ERR(aes))
+        return PTR_ERR(aes);
+
+    /* Decrypted data is only released when the tag matches */
+    out = sqe->mode == AES_MODE_DECRYPT ? aes->bounce : ring->data + sqe->out_off;
+
+    mutex_lock(&aes->lock);
+
+    ret = aes_key_lookup(aes, af, sqe->key_handle, &key);
+    if (ret)
+        goto out;
+    aes->kernel_key = false;
+
+    ret = aes_hw_crypt(aes, sqe->mode, key, sqe->iv, ring->data + sqe->aad_off, sqe->aad_len,
+                       ring->data + sqe->in_off, out, sqe->data_len, hw_tag,
+                       af->wait_mode, &af->stats);
+    aes_file_account(af, aes, sqe->mode, sqe->aad_len, sqe->data_len, key, ret);
+    aes->loaded_key = ret ? 0 : sqe->key_handle;
+    if (ret)
+        goto out;
+
+    if (sqe->mode == AES_MODE_DECRYPT) {
+        if (crypto_memneq(hw_tag, sqe->tag, sizeof(hw_tag))) {
+            ret = -EBADMSG;
+            goto out;
+        }
+        memcpy(ring->data + sqe->out_off, aes->bounce, sqe->data_len);
+        aes_copy_add(af, aes, sqe->data_len);
+    }
+    memcpy(tag, hw_tag, sizeof(hw_tag));
+
+out:
+    mutex_unlock(&aes->lock);
+    aes_core_put(af, aes, cost);
+    return ret;
+}
 
-/* Structure for register access */
-struct aes_reg_data {
-    uint32_t offset;    /* Register offset */
-    uint64_t value;     /* Value to read or write */
-    uint8_t width;      /* Access width in bits: 8, 16, 32, 64 */
+/* Nothing to do: SQ empty, or CQ full until user space reaps */
+static bool aes_ring_stalled(struct aes_ring *ring)
+{
+    return smp_load_acquire(&ring->hdr->sq_tail) == ring->sq_head ||
+           ring->cq_tail - READ_ONCE(ring->hdr->cq_head) >= ring->mask + 1;
+}
+
+/*
+ * Drain the SQ into the IP and post a CQE per entry. The worker keeps polling for
+ * ring_idle_us after the last entry so that a steady stream of submissions needs no
+ * system call, then sets AES_RING_NEED_WAKEUP and stops.
+ */
+static void aes_ring_work(struct work_struct *work)
+{
+    struct aes_ring *ring = container_of(work, struct aes_ring, work);
+    struct aes_ring_hdr *hdr = ring->hdr;
+    struct aes_sqe sqe;
+    struct aes_cqe *cqe;
+    ktime_t idle_end;
+
+    WRITE_ONCE(hdr->flags, 0);
+    smp_mb();
+    idle_end = ktime_add_us(ktime_get(), ring_idle_us);
+
+    while (!READ_ONCE(ring->stop)) {
+        if (aes_ring_stalled(ring)) {
+            if (ktime_before(ktime_get(), idle_end)) {
+                cond_resched();
+                cpu_relax();
+                continue;
+            }
+
+            /* Pairs with the barrier between the sq_tail store and the flags load in user space */
+            WRITE_ONCE(hdr->flags, AES_RING_NEED_WAKEUP);
+            smp_mb();
+            if (aes_ring_stalled(ring))
+                break;
+            WRITE_ONCE(hdr->flags, 0);
+            continue;
+        }
+
+        /* Copy the entry once, user space may still write to the slot */
+        memcpy(&sqe, &ring->sq[ring->sq_head & ring->mask], sizeof(sqe));
+        ring->sq_head++;
+        smp_store_release(&hdr->sq_head, ring->sq_head);
+
+        cqe = &ring->cq[ring->cq_tail & ring->mask];
+        memset(cqe, 0, sizeof(*cqe));
+        cqe->user_data = sqe.user_data;
+        cqe->status = aes_ring_run(ring, &sqe, cqe->tag);
+        ring->cq_tail++;
+        smp_store_release(&hdr->cq_tail, ring->cq_tail);
+
+        if (wq_has_sleeper(&ring->wq))
+            wake_up(&ring->wq);
+        idle_end = ktime_add_us(ktime_get(), ring_idle_us);
+    }
+}
+
+/* Allocate the rings of a file, they live until the file is released */
+static long aes_ring_setup(struct aes_file *af, struct aes_ring_setup __user *usetup)
+{
+    struct aes_dev *aes = af->aes;
+    struct aes_ring_setup setup;
+    struct aes_ring *ring;
+    long ret = 0;
+
+    if (copy_from_user(&setup, usetup, sizeof(setup)))
+        return -EFAULT;
+    if (!is_power_of_2(setup.entries) || setup.entries > AES_RING_MAX_ENTRIES ||
+        !setup.data_size || setup.data_size > AES_RING_MAX_DATA)
+        return -EINVAL;
+
+    /* Header, SQEs and CQEs share the first pages, the data area is page aligned */
+    setup.sq_off = ALIGN(sizeof(struct aes_ring_hdr), 64);
+    setup.cq_off = setup.sq_off + setup.entries * sizeof(struct aes_sqe);
+    setup.data_off = PAGE_ALIGN(setup.cq_off + setup.entries * sizeof(struct aes_cqe));
+    setup.size = PAGE_ALIGN(setup.data_off + setup.data_size);
+
+    ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+    if (!ring)
+        return -ENOMEM;
+    ring->mem = vmalloc_user(setup.size);
+    if (!ring->mem) {
+        kfree(ring);
+        return -ENOMEM;
+    }
+
+    ring->af = af;
+    ring->size = setup.size;
+    ring->hdr = ring->mem;
+    ring->sq = ring->mem + setup.sq_off;
+    ring->cq = ring->mem + setup.cq_off;
+    ring->data = ring->mem + setup.data_off;
+    ring->data_size = setup.data_size;
+    ring->mask = setup.entries - 1;
+    ring->hdr->entries = setup.entries;
+    ring->hdr->flags = AES_RING_NEED_WAKEUP;
+    INIT_WORK(&ring->work, aes_ring_work);
+    init_waitqueue_head(&ring->wq);
+
+    mutex_lock(&aes->lock);
+    if (af->ring)
+        ret = -EBUSY;
+    else
+        smp_store_release(&af->ring, ring);
+    mutex_unlock(&aes->lock);
+
+    if (ret) {
+        vfree(ring->mem);
+        kfree(ring);
+        return ret;
+    }
+
+    /* The ring stays set up, it is freed with the file */
+    if (copy_to_user(usetup, &setup, sizeof(setup)))
+        return -EFAULT;
+    return 0;
+}
+
+static void aes_ring_free(struct aes_ring *ring)
+{
+    WRITE_ONCE(ring->stop, true);
+    cancel_work_sync(&ring->work);
+    vfree(ring->mem);
+    kfree(ring);
+}
+
+/* Map the ring memory */
+static int aes_ring_mmap(struct aes_file *af, struct vm_area_struct *vma)
+{
+    struct aes_ring *ring = smp_load_acquire(&af->ring);
+
+    if (!ring)
+        return -ENXIO;
+    if (vma->vm_end - vma->vm_start > ring->size)
+        return -EINVAL;
+    return remap_vmalloc_range(vma, ring->mem, 0);
+}
+
+#ifdef AES_HAVE_URING_CMD
+/* One IORING_OP_URING_CMD operation in flight */
+struct aes_uring_req {
+    struct work_struct work;        /* Runs the operation on aes_ring_wq */
+    struct io_uring_cmd *ioucmd;
+    struct aes_file *af;
+    struct aes_gcm_run __user *urun;
+    struct aes_gcm_run run;         /* Copy taken at issue */
+    u8 tag[16];
+    int ret;
+    u8 buf[AES_DATA_SIZE];          /* AAD, padding and payload, then the result */
 };
 
-/* Device private data structure */
-struct aes_dev {
-    void __iomem *regs;         /* Virtual address for registers */
-    struct resource *res;       /* Device resources */
-    struct device *dev;         /* Device structure */
-    struct cdev cdev;           /* Character device structure */
-    dev_t devt;                 /* Device number */
+/* Kept in the command's private area between issue and completion */
+struct aes_uring_pdu {
+    struct aes_uring_req *req;
 };
 
-/* Global variables */
-static struct class *aes_class;
-static int aes_major;
+static struct aes_uring_pdu *aes_uring_pdu(struct io_uring_cmd *ioucmd)
+{
+    BUILD_BUG_ON(sizeof(struct aes_uring_pdu) > sizeof(ioucmd->pdu));
+    return (struct aes_uring_pdu *)ioucmd->pdu;
+}
 
-/* File operations */
-static int aes_open(struct inode *inode, struct file *file)
+/* Back in the submitting task: copy the results out and post the CQE */
+static void aes_uring_complete(struct io_uring_cmd *ioucmd)
+{
+    struct aes_uring_req *req = aes_uring_pdu(ioucmd)->req;
+    int ret = req->ret;
+
+    /* res is the payload length, a linked write can use the same length */
+    if (!ret) {
+        if (copy_to_user(u64_to_user_ptr(req->run.out), req->buf, req->run.data_len) ||
+            copy_to_user(req->urun->tag, req->tag, sizeof(req->tag)))
+            ret = -EFAULT;
+        else
+            ret = req->run.data_len;
+    }
+    kfree_sensitive(req);
+
+    /* A negative result breaks an IOSQE_IO_LINK chain */
+    io_uring_cmd_done(ioucmd, ret, 0);
+}
+
+static void aes_uring_work(struct work_struct *work)
 {
+    struct aes_uring_req *req = container_of(work, struct aes_uring_req, work);
     struct aes_dev *aes;
-    
-    aes = container_of(inode->i_cdev, struct aes_dev, cdev);
-    file->private_data = aes;
-    
-    return 0;
+    u64 cost;
+
+    /* Work items run concurrently, so aggregate commands spread over the cores */
+    aes = aes_core_get(req->af, req->run.flags & AES_GCM_KEEP_KEY,
+                       req->run.aad_len + req->run.data_len, &cost);
+    if (IS_ERR(aes)) {
+        req->ret = PTR_ERR(aes);
+    } else {
+        mutex_lock(&aes->lock);
+        req->ret = aes_gcm_exec(req->af, aes, &req->run, req->buf,
+                                req->buf + ALIGN(req->run.aad_len, 16), req->buf, req->tag);
+        mutex_unlock(&aes->lock);
+        aes_core_put(req->af, aes, cost);
+    }
+
+    io_uring_cmd_complete_in_task(req->ioucmd, aes_uring_complete);
 }
 
-static int aes_release(struct inode *inode, struct file *file)
+/*
+ * IORING_OP_URING_CMD: the request and its input are copied at issue, the IP runs from
+ * aes_ring_wq and the output is copied back in the submitting task before the CQE
+ */
+static int aes_uring_cmd(struct io_uring_cmd *ioucmd, unsigned int issue_flags)
 {
-    return 0;
+    struct aes_file *af = ioucmd->file->private_data;
+    const struct aes_uring_gcm *cmd;
+    struct aes_uring_req *req;
+    u32 aad_pad;
+    int ret;
+
+    cmd = ioucmd->cmd;
+
+    if (ioucmd->cmd_op != AES_IOC_GCM_RUN)
+        return -ENOTTY;
+    if (READ_ONCE(cmd->reserved))
+        return -EINVAL;
+
+    req = kmalloc(sizeof(*req), GFP_KERNEL);
+    if (!req)
+        return -ENOMEM;
+    req->urun = u64_to_user_ptr(READ_ONCE(cmd->run));
+
+    if (copy_from_user(&req->run, req->urun, sizeof(req->run))) {
+        ret = -EFAULT;
+        goto err;
+    }
+    ret = aes_gcm_check(&req->run);
+    if (ret)
+        goto err;
+    /* The worker has no pinned buffer reference, fixed buffers go through AES_IOC_GCM_RUN */
+    if (req->run.flags & AES_GCM_FIXED_BUF) {
+        ret = -EINVAL;
+        goto err;
+    }
+
+    aad_pad = ALIGN(req->run.aad_len, 16);
+    if (copy_from_user(req->buf, u64_to_user_ptr(req->run.aad), req->run.aad_len) ||
+        copy_from_user(req->buf + aad_pad, u64_to_user_ptr(req->run.in), req->run.data_len)) {
+        ret = -EFAULT;
+        goto err;
+    }
+
+    req->ioucmd = ioucmd;
+    req->af = af;
+    aes_uring_pdu(ioucmd)->req = req;
+    INIT_WORK(&req->work, aes_uring_work);
+    queue_work(aes_ring_wq, &req->work);
+    return -EIOCBQUEUED;
+
+err:
+    kfree_sensitive(req);
+    return ret;
 }
+#endif
 
-// function for ioctl system call
-static long aes_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+/* Dispatch one ioctl, aes_ioctl wraps it with the entry and exit tracepoints */
+static long aes_ioctl_cmd(struct file *file, unsigned int cmd, unsigned long arg)
 {
-    struct aes_dev *aes = file->private_data;
+    struct aes_file *af = file->private_data;
+    struct aes_dev *aes = af->aes;
+    u32 mode, handle;
     struct aes_reg_data reg;
+    struct aes_key_stats key_stats;
+    struct aes_ring *ring;
+
+    aes_stat_add(aes, AES_STAT_IOCTLS, 1);
+    aes_file_stat_add(af, AES_STAT_IOCTLS, 1);
     
     switch (cmd) {
     case AES_IOC_READ_REG:
@@ -75,21 +1893,7 @@ static long aes_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
         }
         
         /* Read register value based on width */
-        switch (reg.width) {
-        case 8:
-            reg.value = readb(aes->regs + reg.offset);
-            break;
-        case 16:
-            reg.value = readw(aes->regs + reg.offset);
-            break;
-        case 32:
-        default:
-            reg.value = readl(aes->regs + reg.offset);
-            break;
-        case 64:
-            reg.value = readq(aes->regs + reg.offset);
-            break;
-        }
+        reg.value = aes_reg_read(aes, reg.offset, reg.width);
         
         if (copy_to_user((void __user *)arg, &reg, sizeof(reg)))
             return -EFAULT;
@@ -105,22 +1909,72 @@ static long aes_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
             return -EINVAL;
         }
         
-        /* Write register value based on width */
-        switch (reg.width) {
-        case 8:
-            writeb(reg.value, aes->regs + reg.offset);
-            break;
-        case 16:
-            writew(reg.value, aes->regs + reg.offset);
-            break;
-        case 32:
-        default:
-            writel(reg.value, aes->regs + reg.offset);
-            break;
-        case 64:
-            writeq(reg.value, aes->regs + reg.offset);
-            break;
-        }
+        /* Write register value based on width, a KEYIN write invalidates the key cache */
+        mutex_lock(&aes->lock);
+        aes_reg_write(af, reg.offset, reg.width, reg.value);
+        mutex_unlock(&aes->lock);
+        break;
+
+    case AES_IOC_BATCH:
+        return aes_batch_run(af, (struct aes_batch __user *)arg);
+
+    case AES_IOC_READ_RANGE:
+        return aes_range_copy(af, (struct aes_range __user *)arg, false);
+
+    case AES_IOC_WRITE_RANGE:
+        return aes_range_copy(af, (struct aes_range __user *)arg, true);
+
+    case AES_IOC_BUF_REGISTER:
+        return aes_buf_register(af, (struct aes_buf_reg __user *)arg);
+
+    case AES_IOC_BUF_UNREGISTER:
+        if (copy_from_user(&handle, (void __user *)arg, sizeof(handle)))
+            return -EFAULT;
+        return aes_buf_unregister(af, handle);
+
+    case AES_IOC_GCM_RUN:
+        return aes_gcm_run(af, (struct aes_gcm_run __user *)arg);
+
+    case AES_IOC_WAIT:
+        /* Block until the device is idle, arg is the timeout in us (0 = default) */
+        return aes_file_wait(af, (u32)arg);
+
+    case AES_IOC_SET_WAIT_MODE:
+        if (copy_from_user(&mode, (void __user *)arg, sizeof(mode)))
+            return -EFAULT;
+        if (mode > AES_WAIT_HYBRID)
+            return -EINVAL;
+        af->wait_mode = mode;
+        break;
+
+    case AES_IOC_GET_WAIT_STATS:
+        if (copy_to_user((void __user *)arg, &af->stats, sizeof(af->stats)))
+            return -EFAULT;
+        break;
+
+    case AES_IOC_KEY_REGISTER:
+        return aes_key_register(af, (struct aes_key_reg __user *)arg);
+
+    case AES_IOC_KEY_UNREGISTER:
+        if (copy_from_user(&handle, (void __user *)arg, sizeof(handle)))
+            return -EFAULT;
+        return aes_key_unregister(af, handle);
+
+    case AES_IOC_GET_KEY_STATS:
+        aes_key_stats_get(af, &key_stats);
+        if (copy_to_user((void __user *)arg, &key_stats, sizeof(key_stats)))
+            return -EFAULT;
+        break;
+
+    case AES_IOC_RING_SETUP:
+        return aes_ring_setup(af, (struct aes_ring_setup __user *)arg);
+
+    case AES_IOC_RING_ENTER:
+        /* Doorbell, only needed while the worker has AES_RING_NEED_WAKEUP set */
+        ring = smp_load_acquire(&af->ring);
+        if (!ring)
+            return -ENXIO;
+        queue_work(aes_ring_wq, &ring->work);
         break;
         
     default:
@@ -130,11 +1984,302 @@ static long aes_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
     return 0;
 }
 
+/* Commands on the registers of the file's own core, the others pick a core with aes_core_get */
+static bool aes_ioctl_direct(unsigned int cmd)
+{
+    switch (cmd) {
+    case AES_IOC_READ_REG:
+    case AES_IOC_WRITE_REG:
+    case AES_IOC_BATCH:
+    case AES_IOC_READ_RANGE:
+    case AES_IOC_WRITE_RANGE:
+    case AES_IOC_WAIT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// function for ioctl system call
+static long aes_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct aes_file *af = file->private_data;
+    bool direct = aes_ioctl_direct(cmd);
+    long ret;
+
+    if (direct && !aes_dev_enter(af->aes))
+        return -ENODEV;
+    /* Kernel gcm(aes) requests stage keys and data in the registers of the provider's core */
+    if (direct && cmd != AES_IOC_WAIT && READ_ONCE(af->aes->engine)) {
+        aes_dev_exit(af->aes);
+        return -EBUSY;
+    }
+    trace_aes_ioctl_enter(af->aes, cmd, arg);
+    ret = aes_ioctl_cmd(file, cmd, arg);
+    trace_aes_ioctl_exit(af->aes, cmd, ret);
+    if (direct)
+        aes_dev_exit(af->aes);
+    return ret;
+}
+
+// function for poll/epoll: readable when no operation is in flight, or with rings when a CQE is ready
+static __poll_t aes_poll(struct file *file, poll_table *wait)
+{
+    struct aes_file *af = file->private_data;
+    struct aes_dev *aes = af->aes;
+    struct aes_ring *ring = smp_load_acquire(&af->ring);
+
+    if (ring) {
+        poll_wait(file, &ring->wq, wait);
+        if (smp_load_acquire(&ring->hdr->cq_tail) != READ_ONCE(ring->hdr->cq_head))
+            return EPOLLIN | EPOLLRDNORM;
+        return 0;
+    }
+
+    poll_wait(file, &aes->wq, wait);
+    if (!READ_ONCE(aes->busy))
+        return EPOLLIN | EPOLLRDNORM;
+    return 0;
+}
+
+/* Page protection for one page of the register space */
+static pgprot_t aes_mmap_prot(unsigned long offset, pgprot_t prot)
+{
+    /* DATAIN/DATAOUT BRAM: Normal-NC so burst stores coalesce */
+    if (offset >= AES_DATAIN_OFFSET && offset + PAGE_SIZE <= AES_WINDOW_END)
+        return pgprot_writecombine(prot);
+
+    /* Control registers and anything sharing their page: Device-nGnRnE */
+    return pgprot_noncached(prot);
+}
+
+/* Writable mappings of the control registers, counted while they exist */
+static void aes_ctrl_vma_open(struct vm_area_struct *vma)
+{
+    struct aes_dev *aes = vma->vm_private_data;
+
+    atomic_inc(&aes->ctrl_maps);
+}
+
+static void aes_ctrl_vma_close(struct vm_area_struct *vma)
+{
+    struct aes_dev *aes = vma->vm_private_data;
+
+    atomic_dec(&aes->ctrl_maps);
+}
+
+static const struct vm_operations_struct aes_ctrl_vm_ops = {
+    .open   = aes_ctrl_vma_open,
+    .close  = aes_ctrl_vma_close,
+};
+
+// function for mmap system call
+static int aes_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    struct aes_file *af = file->private_data;
+    struct aes_dev *aes = af->aes;
+    unsigned long size = vma->vm_end - vma->vm_start;
+    unsigned long offset = vma->vm_pgoff << PAGE_SHIFT;
+    unsigned long pos, len;
+    pgprot_t prot;
+    int ret = 0;
+
+    /* Only shared mappings inside the register space */
+    if (!(vma->vm_flags & VM_SHARED))
+        return -EINVAL;
+    if (offset == AES_RING_MMAP_OFFSET)
+        return aes_ring_mmap(af, vma);
+    if (offset >= resource_size(aes->res) ||
+        size > PAGE_ALIGN(resource_size(aes->res)) - offset)
+        return -EINVAL;
+    if (!aes_dev_enter(aes))
+        return -ENODEV;
+    if (READ_ONCE(aes->engine)) {
+        aes_dev_exit(aes);
+        return -EBUSY;
+    }
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    vm_flags_set(vma, VM_IO | VM_DONTEXPAND | VM_DONTDUMP);
+#else
+    vma->vm_flags |= VM_IO | VM_DONTEXPAND | VM_DONTDUMP;
+#endif
+
+    /* Remap runs of pages that share the same memory attributes */
+    for (pos = 0; pos < size; pos += len) {
+        prot = aes_mmap_prot(offset + pos, vma->vm_page_prot);
+        for (len = PAGE_SIZE; pos + len < size; len += PAGE_SIZE) {
+            if (pgprot_val(aes_mmap_prot(offset + pos + len, vma->vm_page_prot)) != pgprot_val(prot))
+                break;
+        }
+
+        ret = io_remap_pfn_range(vma, vma->vm_start + pos,
+                                 (aes->res->start + offset + pos) >> PAGE_SHIFT, len, prot);
+        if (ret) {
+            dev_err(aes->dev, "Failed to map offset 0x%lx\n", offset + pos);
+            break;
+        }
+    }
+
+    /* The VMA holds the file and with it the core, so the count outlives no structure */
+    if (!ret && offset < AES_DATAIN_OFFSET && (vma->vm_flags & VM_MAYWRITE)) {
+        vma->vm_private_data = aes;
+        vma->vm_ops = &aes_ctrl_vm_ops;
+        aes_ctrl_vma_open(vma);
+    }
+
+    aes_dev_exit(aes);
+    return ret;
+}
+
+static const char * const aes_stat_names[AES_STAT_NR] = {
+    [AES_STAT_OPS_ENCRYPT]  = "ops_encrypt",
+    [AES_STAT_OPS_DECRYPT]  = "ops_decrypt",
+    [AES_STAT_OPS_BYPASS]   = "ops_bypass",
+    [AES_STAT_AAD_BYTES]    = "aad_bytes",
+    [AES_STAT_DATA_BYTES]   = "data_bytes",
+    [AES_STAT_IOCTLS]       = "ioctls",
+    [AES_STAT_SPIN_ITERS]   = "spin_iters",
+    [AES_STAT_TIMEOUTS]     = "timeouts",
+    [AES_STAT_KEY_LOADS]    = "key_loads",
+    [AES_STAT_COPY_BYTES]   = "copy_bytes",
+    [AES_STAT_DMA_BYTES]    = "dma_bytes",
+};
+
+static const char * const aes_hist_names[AES_HIST_NR] = {
+    [AES_HIST_OP]   = "op_latency_ns",
+    [AES_HIST_REG]  = "reg_latency_ns",
+};
+
+/* Sum the per-CPU device statistics, readers never stop the hot path */
+static void aes_stats_collect(struct aes_dev *aes, struct aes_stats_snapshot *snap)
+{
+    const struct aes_stats_cpu *c;
+    int cpu, i, b;
+
+    memset(snap, 0, sizeof(*snap));
+    snap->version = AES_STATS_VERSION;
+    snap->size = sizeof(*snap);
+    for_each_possible_cpu(cpu) {
+        c = per_cpu_ptr(aes->stats, cpu);
+        for (i = 0; i < AES_STAT_NR; i++)
+            snap->stat[i] += READ_ONCE(c->stat[i]);
+        for (i = 0; i < AES_HIST_NR; i++)
+            for (b = 0; b < AES_HIST_BUCKETS; b++)
+                snap->hist[i][b] += READ_ONCE(c->hist[i][b]);
+    }
+}
+
+/* debugfs "stats": device counters, then the non-empty histogram buckets by lower bound */
+static int aes_stats_show(struct seq_file *m, void *v)
+{
+    struct aes_dev *aes = m->private;
+    struct aes_stats_snapshot *snap;
+    int i, b;
+
+    snap = kmalloc(sizeof(*snap), GFP_KERNEL);
+    if (!snap)
+        return -ENOMEM;
+    aes_stats_collect(aes, snap);
+
+    for (i = 0; i < AES_STAT_NR; i++)
+        seq_printf(m, "%-16s %llu\n", aes_stat_names[i], snap->stat[i]);
+    for (i = 0; i < AES_HIST_NR; i++) {
+        seq_printf(m, "%s:\n", aes_hist_names[i]);
+        for (b = 0; b < AES_HIST_BUCKETS; b++)
+            if (snap->hist[i][b])
+                seq_printf(m, "  %12llu %llu\n", b ? 1ULL << b : 0ULL, snap->hist[i][b]);
+    }
+
+    kfree(snap);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(aes_stats);
+
+/* debugfs "files": one line of counters per open file */
+static int aes_files_show(struct seq_file *m, void *v)
+{
+    struct aes_dev *aes = m->private;
+    struct aes_file *af;
+    u64 stat[AES_STAT_NR];
+    int cpu, i;
+
+    mutex_lock(&aes->lock);
+    list_for_each_entry(af, &aes->files, node) {
+        memset(stat, 0, sizeof(stat));
+        for_each_possible_cpu(cpu)
+            for (i = 0; i < AES_STAT_NR; i++)
+                stat[i] += READ_ONCE(per_cpu_ptr(af->counters, cpu)->stat[i]);
+        /* Spins of a file are already counted by its wait statistics */
+        stat[AES_STAT_SPIN_ITERS] = READ_ONCE(af->stats.spin_iters);
+
+        seq_printf(m, "%d %s", af->pid, af->comm);
+        for (i = 0; i < AES_STAT_NR; i++)
+            seq_printf(m, " %s=%llu", aes_stat_names[i], stat[i]);
+        seq_putc(m, '\n');
+    }
+    mutex_unlock(&aes->lock);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(aes_files);
+
+/* sysfs "stats": struct aes_stats_snapshot for scrapers, one read and no parsing */
+static ssize_t stats_read(struct file *filp, struct kobject *kobj, struct bin_attribute *attr,
+                          char *buf, loff_t off, size_t count)
+{
+    struct aes_dev *aes = dev_get_drvdata(kobj_to_dev(kobj));
+    struct aes_stats_snapshot *snap;
+    ssize_t ret;
+
+    snap = kmalloc(sizeof(*snap), GFP_KERNEL);
+    if (!snap)
+        return -ENOMEM;
+    aes_stats_collect(aes, snap);
+    ret = memory_read_from_buffer(buf, count, &off, snap, sizeof(*snap));
+    kfree(snap);
+    return ret;
+}
+static BIN_ATTR_RO(stats, sizeof(struct aes_stats_snapshot));
+
+/* sysfs "mover": DMA channel moving the window data, or "cpu" */
+static ssize_t mover_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct aes_dev *aes = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%s\n", aes_mover_name(aes));
+}
+static DEVICE_ATTR_RO(mover);
+
+static struct attribute *aes_attrs[] = {
+    &dev_attr_mover.attr,
+    NULL,
+};
+
+static struct bin_attribute *aes_bin_attrs[] = {
+    &bin_attr_stats,
+    NULL,
+};
+
+static const struct attribute_group aes_attr_group = {
+    .attrs = aes_attrs,
+    .bin_attrs = aes_bin_attrs,
+};
+
+static const struct attribute_group *aes_attr_groups[] = {
+    &aes_attr_group,
+    NULL,
+};
+
 static const struct file_operations aes_fops = {
     .owner          = THIS_MODULE,
     .open           = aes_open,
     .release        = aes_release,
     .unlocked_ioctl = aes_ioctl,
+    .mmap           = aes_mmap,
+    .poll           = aes_poll,
+#ifdef AES_HAVE_URING_CMD
+    .uring_cmd      = aes_uring_cmd,
+#endif
 };
 
 /* Probe function - called when device is detected */
@@ -148,12 +2293,32 @@ static int aes_probe(struct platform_device *pdev)
     /* Print information when device is detected */
     dev_info(&pdev->dev, "AES256GCM10G25GIP device detected\n");
 
-    /* Allocate driver private data (common)*/
-    aes = devm_kzalloc(&pdev->dev, sizeof(struct aes_dev), GFP_KERNEL);
+    /*
+     * Allocate driver private data (common). Open files hold references, so the structure,
+     * its counters and the staging buffer are freed with the last one rather than by devm
+     */
+    aes = kzalloc(sizeof(struct aes_dev), GFP_KERNEL);
     if (!aes)
         return -ENOMEM;
+    kref_init(&aes->ref);
+    ret = devm_add_action_or_reset(&pdev->dev, aes_dev_put_action, aes);
+    if (ret)
+        return ret;
 
     aes->dev = &pdev->dev;
+    mutex_init(&aes->lock);
+    init_rwsem(&aes->remove_sem);
+    INIT_LIST_HEAD(&aes->files);
+    atomic64_set(&aes->pending_ns, 0);
+
+    aes->stats = alloc_percpu(struct aes_stats_cpu);
+    if (!aes->stats)
+        return -ENOMEM;
+
+    /* Staging buffer for AES_IOC_GCM_RUN */
+    aes->bounce = kzalloc(AES_DATA_SIZE, GFP_KERNEL);
+    if (!aes->bounce)
+        return -ENOMEM;
 
     /* Get memory resource for the device (register space) */
     res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
@@ -170,32 +2335,88 @@ static int aes_probe(struct platform_device *pdev)
         return PTR_ERR(aes->regs);
     }
 
+    /* Completion: done interrupt from the device tree, or a paced kernel poll */
+    init_waitqueue_head(&aes->wq);
+    aes->cost_base_ns = 1000;       /* Starting point until the first spin or hybrid wait */
+    aes->cost_byte_q8 = 256;
+    aes->poll_cost_ns = 100;
+    hrtimer_init(&aes->poll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    aes->poll_timer.function = aes_poll_timer;
+
+    ret = platform_get_irq_optional(pdev, 0);
+    if (ret > 0) {
+        aes->irq = ret;
+        ret = devm_request_irq(&pdev->dev, aes->irq, aes_irq_handler, 0, DRIVER_NAME, aes);
+        if (ret) {
+            dev_err(&pdev->dev, "Failed to request IRQ %d\n", aes->irq);
+            return ret;
+        }
+        dev_info(&pdev->dev, "Using done interrupt %d\n", aes->irq);
+    } else if (ret == -EPROBE_DEFER) {
+        return ret;
+    } else {
+        aes->irq = 0;
+        ret = 0;
+        dev_info(&pdev->dev, "No interrupt, polling completion every %u us\n", poll_interval_us);
+    }
+
+    /* Window data: DMA channel from the device tree, or CPU copies */
+    ret = aes_mover_init(aes);
+    if (ret)
+        return ret;
+
+    /* One minor per core, in probe order */
+    ret = ida_alloc_max(&aes_ida, AES_MAX_DEVICES - 1, GFP_KERNEL);
+    if (ret < 0) {
+        dev_err(&pdev->dev, "More than %d AES cores\n", AES_MAX_DEVICES);
+        aes_mover_exit(aes);
+        return ret;
+    }
+    aes->id = ret;
+
     /* Create character device */
-    dev = MKDEV(aes_major, 0);
+    dev = MKDEV(aes_major, aes->id);
     cdev_init(&aes->cdev, &aes_fops);
     aes->cdev.owner = THIS_MODULE;
     
     ret = cdev_add(&aes->cdev, dev, 1);
     if (ret) {
         dev_err(&pdev->dev, "Failed to add character device\n");
+        ida_free(&aes_ida, aes->id);
+        aes_mover_exit(aes);
         return ret;
     }
     
-    /* Create device node */
+    /* Create device node, /sys/class/<driver>/<node>/stats carries the binary statistics */
     if (aes_class) {
         aes->devt = dev;
-        device_create(aes_class, &pdev->dev, dev, aes, DEVICE_NAME);
+        device_create_with_groups(aes_class, &pdev->dev, dev, aes, aes_attr_groups,
+                                  DEVICE_NAME "%d", aes->id);
     }
 
+    /* Counters and histograms as text in <debugfs>/<driver>/<device>/ */
+    aes->debugfs = debugfs_create_dir(dev_name(&pdev->dev), aes_debugfs_root);
+    debugfs_create_file("stats", 0444, aes->debugfs, aes, &aes_stats_fops);
+    debugfs_create_file("files", 0444, aes->debugfs, aes, &aes_files_fops);
+
     /* Store driver data for later use */
     platform_set_drvdata(pdev, aes);
 
+    /* Kernel users get the IP through the crypto API, the character device works without it */
+    if (aes_aead_register(aes))
+        dev_warn(&pdev->dev, "gcm(aes) crypto provider not registered\n");
+
+    /* The aggregate device can use the core from now on */
+    down_write(&aes_cores_sem);
+    aes_cores[aes->id] = aes;
+    up_write(&aes_cores_sem);
+
     /* Print resource information */
     dev_info(&pdev->dev, "AES256GCM10G25GIP registered at physical address 0x%llx, virtual address 0x%p\n",
              (unsigned long long)res->start, aes->regs);
     dev_info(&pdev->dev, "Register space size: 0x%llx\n", 
              (unsigned long long)(res->end - res->start + 1));
-    dev_info(&pdev->dev, "Created device node /dev/%s\n", DEVICE_NAME);
+    dev_info(&pdev->dev, "Created device node /dev/%s%d\n", DEVICE_NAME, aes->id);
 
     return ret;
 }
@@ -204,10 +2425,29 @@ static int aes_probe(struct platform_device *pdev)
 static int aes_remove(struct platform_device *pdev)
 {
     struct aes_dev *aes = platform_get_drvdata(pdev);
+
+    /* Waits for the aggregate operations running on this core */
+    down_write(&aes_cores_sem);
+    aes_cores[aes->id] = NULL;
+    up_write(&aes_cores_sem);
+
+    /*
+     * Waits for the operations of files opened on this core. Files still open keep the
+     * structure until they are released, but their register accesses fail with -ENODEV
+     */
+    down_write(&aes->remove_sem);
+    aes->removed = true;
+    up_write(&aes->remove_sem);
     
+    aes_aead_unregister(aes);
+    debugfs_remove_recursive(aes->debugfs);
+
     /* Remove device node and character device */
     device_destroy(aes_class, aes->devt);
     cdev_del(&aes->cdev);
+    hrtimer_cancel(&aes->poll_timer);
+    aes_mover_exit(aes);
+    ida_free(&aes_ida, aes->id);
     
     dev_info(&pdev->dev, "AES256GCM10G25GIP device removed\n");
     return 0;
@@ -226,6 +2466,8 @@ static struct platform_driver aes_driver = {
         .name = DRIVER_NAME,
         .owner = THIS_MODULE,
         .of_match_table = aes_of_match,
+        /* Crypto API transforms keep the provider's core, only module unload may remove it */
+        .suppress_bind_attrs = true,
     },
     .probe = aes_probe,
     .remove = aes_remove,
@@ -237,29 +2479,58 @@ static int __init aes_init(void)
     int ret;
     dev_t dev;
     
-    /* Allocate a character device region */
-    ret = alloc_chrdev_region(&dev, 0, 1, DRIVER_NAME);
+    /* Allocate a character device region: the cores and the aggregate */
+    ret = alloc_chrdev_region(&dev, 0, AES_MINORS, DRIVER_NAME);
     if (ret) {
         pr_err("Failed to allocate character device region\n");
         return ret;
     }
     
     aes_major = MAJOR(dev);
+    aes_debugfs_root = debugfs_create_dir(DRIVER_NAME, NULL);
+
+    /* Ring and uring_cmd workers poll while busy, keep them off the bound system workers */
+    aes_ring_wq = alloc_workqueue("aes_ring", WQ_UNBOUND | WQ_HIGHPRI, 0);
+    if (!aes_ring_wq) {
+        debugfs_remove_recursive(aes_debugfs_root);
+        unregister_chrdev_region(dev, AES_MINORS);
+        return -ENOMEM;
+    }
     
     /* Create device class */
     aes_class = class_create(THIS_MODULE, DRIVER_NAME);
     if (IS_ERR(aes_class)) {
         pr_err("Failed to create device class\n");
-        unregister_chrdev_region(dev, 1);
+        destroy_workqueue(aes_ring_wq);
+        debugfs_remove_recursive(aes_debugfs_root);
+        unregister_chrdev_region(dev, AES_MINORS);
         return PTR_ERR(aes_class);
     }
+
+    /* Aggregate node /dev/aes256gcm, its operations go to the least loaded core */
+    cdev_init(&aes_agg_cdev, &aes_fops);
+    aes_agg_cdev.owner = THIS_MODULE;
+    ret = cdev_add(&aes_agg_cdev, MKDEV(aes_major, AES_AGG_MINOR), 1);
+    if (ret) {
+        pr_err("Failed to add aggregate character device\n");
+        class_destroy(aes_class);
+        destroy_workqueue(aes_ring_wq);
+        debugfs_remove_recursive(aes_debugfs_root);
+        unregister_chrdev_region(dev, AES_MINORS);
+        return ret;
+    }
+    device_create(aes_class, NULL, MKDEV(aes_major, AES_AGG_MINOR), NULL, DEVICE_NAME);
     
     /* Register platform driver */
     ret = platform_driver_register(&aes_driver);
     if (ret) {
         pr_err("Failed to register platform driver\n");
+        device_destroy(aes_class, MKDEV(aes_major, AES_AGG_MINOR));
+        cdev_del(&aes_agg_cdev);
         class_destroy(aes_class);
-        unregister_chrdev_region(dev, 1);
+        destroy_workqueue(aes_ring_wq);
+        debugfs_remove_recursive(aes_debugfs_root);
+        unregister_chrdev_region(dev, AES_MINORS);
         return ret;
     }
     
@@ -270,8 +2541,13 @@ static int __init aes_init(void)
 static void __exit aes_exit(void)
 {
     platform_driver_unregister(&aes_driver);
+    device_destroy(aes_class, MKDEV(aes_major, AES_AGG_MINOR));
+    cdev_del(&aes_agg_cdev);
     class_destroy(aes_class);
-    unregister_chrdev_region(MKDEV(aes_major, 0), 1);
+    destroy_workqueue(aes_ring_wq);
+    debugfs_remove_recursive(aes_debugfs_root);
+    idr_destroy(&aes_keys);
+    unregister_chrdev_region(MKDEV(aes_major, 0), AES_MINORS);
 }
 
 module_init(aes_init);
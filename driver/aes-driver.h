@@ -0,0 +1,121 @@
+/**
+ * AES256GCM10G25GIP Kernel Driver - definitions shared between the driver objects
+ */
+#ifndef AES_DRIVER_H
+#define AES_DRIVER_H
+
+#include <linux/types.h>
+#include <linux/device.h>
+#include <linux/cdev.h>
+#include <linux/mutex.h>
+#include <linux/rwsem.h>
+#include <linux/kref.h>
+#include <linux/wait.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/atomic.h>
+
+#define DRIVER_NAME "aes256gcm10g25g"
+
+#define AES_POLL_TIMEOUT_US     1000000
+
+/* Operation modes */
+#define AES_MODE_ENCRYPT    0
+#define AES_MODE_DECRYPT    1
+#define AES_MODE_BYPASS     2
+
+/* Completion wait modes */
+#define AES_WAIT_IRQ        0   /* Sleep until the done interrupt (or the kernel poll timer) */
+#define AES_WAIT_SPIN       1   /* Spin on DATAINCNT */
+#define AES_WAIT_HYBRID     2   /* Sleep for most of the predicted time, then spin */
+
+/* Register map */
+#define AES_ADDR_A1_REG     0x00
+#define AES_ADDR_A2_REG     0x04
+#define AES_AADINCNT_REG    0x08
+#define AES_DATAINCNT_REG   0x0C
+#define AES_VER_REG         0x10
+#define AES_DECEN_REG       0x14
+#define AES_BYPASS_REG      0x18
+#define AES_KEYIN_0_REG     0x20
+#define AES_IVIN_0_REG      0x40
+#define AES_TAG_0_REG       0x50
+
+/* Data windows mapped write-combining by mmap, the rest is device memory */
+#define AES_DATAIN_OFFSET       0x2000
+#define AES_DATAOUT_OFFSET      0x4000
+#define AES_WINDOW_END          0x6000
+#define AES_DATA_SIZE           2048    /* BRAM bytes used per operation, AAD padded to 16 plus payload */
+
+struct aes_wait_stats;
+struct aes_stats_cpu;
+struct crypto_engine;
+struct dentry;
+struct dma_chan;
+
+/* Device private data structure */
+struct aes_dev {
+    void __iomem *regs;         /* Virtual address for registers */
+    struct resource *res;       /* Device resources */
+    struct device *dev;         /* Device structure */
+    struct cdev cdev;           /* Character device structure */
+    dev_t devt;                 /* Device number */
+    int id;                     /* Instance number, minor and /dev/aes256gcm<id> */
+    struct kref ref;            /* Probe and every open file, the structure outlives aes_remove */
+    struct rw_semaphore remove_sem; /* Held for reading while the file's own core is accessed */
+    bool removed;               /* Set by aes_remove under remove_sem, registers are unmapped */
+    atomic64_t pending_ns;      /* Predicted time of the operations queued on or running in this core */
+    struct mutex lock;          /* Serialises whole operations */
+    u8 *bounce;                 /* AES_DATA_SIZE staging buffer for user data */
+    int irq;                    /* Done interrupt, or 0 when polled by poll_timer */
+    bool busy;                  /* Operation started and not yet seen complete */
+    wait_queue_head_t wq;       /* Woken when an operation completes */
+    struct hrtimer poll_timer;  /* Kernel-side completion poll without an IRQ line */
+    ktime_t op_start;           /* Start time of the operation in flight */
+    u32 op_bytes;               /* AAD + payload bytes of the operation in flight */
+    u32 cost_base_ns;           /* Cost model: fixed time per operation */
+    u32 cost_byte_q8;           /* Cost model: time per byte in 1/256 ns */
+    u32 poll_cost_ns;           /* Time of one DATAINCNT poll while spinning */
+    struct crypto_engine *engine;   /* Queue of crypto API requests, NULL when not registered.
+                                       While set, raw register ioctls and mmap get -EBUSY */
+    bool kernel_key;                /* KEYIN holds a crypto API key, user AES_GCM_KEEP_KEY is stale */
+    u32 loaded_key;                 /* Handle of the registered key in KEYIN, 0 = none or unknown */
+    atomic_t ctrl_maps;             /* Writable mappings of the control registers, KEYIN is unknown */
+    u64 key_hits;                   /* Operations that skipped KEYIN programming */
+    u64 key_misses;                 /* Operations that programmed a registered key */
+    struct aes_stats_cpu __percpu *stats;   /* Counters and latency histograms of the device */
+    struct list_head files;         /* Open files, under lock */
+    struct dentry *debugfs;         /* Per-device debugfs directory */
+    struct dma_chan *dma;           /* Data mover channel, NULL when the CPU copies */
+    dma_addr_t dma_win;             /* Register space as seen by the channel */
+    u32 op_dma_bytes;               /* Bytes of the last aes_hw_crypt moved by the channel */
+};
+
+/*
+ * Run one operation: AAD is written zero padded to 16 bytes, followed by the payload from in,
+ * and the payload result is copied to out (which may alias in). key=NULL keeps the loaded key.
+ * Caller holds aes->lock
+ */
+int aes_hw_crypt(struct aes_dev *aes, u32 mode, const u8 *key, const u8 *iv,
+                 const u8 *aad, u32 aad_len, const u8 *in, u8 *out, u32 data_len, u8 *tag,
+                 u32 wait_mode, struct aes_wait_stats *stats);
+
+/* Zero KEYIN_0..7 and forget the loaded key. Caller holds aes->lock */
+void aes_hw_wipe_key(struct aes_dev *aes);
+
+/*
+ * Data mover between memory and the windows (aes-mover.c): the DMA channel when one is
+ * configured and the copy is worth it, memcpy_toio/memcpy_fromio otherwise. The copies
+ * return true when the channel moved the data
+ */
+int aes_mover_init(struct aes_dev *aes);
+void aes_mover_exit(struct aes_dev *aes);
+bool aes_mover_to_dev(struct aes_dev *aes, u32 off, const void *src, u32 len);
+bool aes_mover_from_dev(struct aes_dev *aes, void *dst, u32 off, u32 len);
+const char *aes_mover_name(struct aes_dev *aes);
+
+/* Crypto API "gcm(aes)" provider (aes-aead.c) */
+int aes_aead_register(struct aes_dev *aes);
+void aes_aead_unregister(struct aes_dev *aes);
+
+#endif /* AES_DRIVER_H */
@@ -11,6 +11,8 @@
 #include <linux/fs.h>
 #include <linux/cdev.h>
 #include <linux/uaccess.h>
+#include <linux/slab.h>
+#include <linux/iopoll.h>
 
 #define DRIVER_NAME "aes256gcm10g25g"
 #define DRIVER_DESC "Driver for AES256GCM10G25GIP hardware"
@@ -20,6 +22,19 @@
 #define AES_IOC_MAGIC 'a'
 #define AES_IOC_READ_REG   _IOR(AES_IOC_MAGIC, 1, struct aes_reg_data)
 #define AES_IOC_WRITE_REG  _IOW(AES_IOC_MAGIC, 2, struct aes_reg_data)
+#define AES_IOC_BATCH      _IOWR(AES_IOC_MAGIC, 3, struct aes_batch)
+#define AES_IOC_READ_RANGE  _IOW(AES_IOC_MAGIC, 13, struct aes_range)
+#define AES_IOC_WRITE_RANGE _IOW(AES_IOC_MAGIC, 14, struct aes_range)
+
+/* Batch operation types */
+#define AES_BATCH_READ      0   /* Read register into value */
+#define AES_BATCH_WRITE     1   /* Write value to register */
+#define AES_BATCH_POLL      2   /* Read register until it is zero, value = timeout in us (0 = default) */
+
+#define AES_BATCH_MAX_OPS       256
+#define AES_POLL_TIMEOUT_US     1000000
+#define AES_RANGE_CHUNK         0x2000  /* Bounce size of a range copy, one BRAM */
+#define AES_DATAINCNT_REG       0x0C
 
 /* Structure for register access */
 struct aes_reg_data {
@@ -27,6 +42,27 @@ struct aes_reg_data {
     uint32_t value;     /* Value to read or write */
 };
 
+/* One entry of a batch */
+struct aes_batch_op {
+    uint32_t offset;    /* Register offset */
+    uint32_t op;        /* AES_BATCH_READ, AES_BATCH_WRITE or AES_BATCH_POLL */
+    uint32_t value;     /* Value to write, value read or poll timeout */
+};
+
+/* Batch of register operations executed by one ioctl */
+struct aes_batch {
+    uint64_t ops;       /* User pointer to an array of struct aes_batch_op */
+    uint32_t count;     /* Number of operations in the array */
+    uint32_t completed; /* Number of operations completed, set by the driver */
+};
+
+/* Bulk copy between user memory and the window (AES_IOC_READ_RANGE/WRITE_RANGE) */
+struct aes_range {
+    uint32_t offset;    /* Window offset */
+    uint32_t length;    /* Bytes to copy */
+    uint64_t buf;       /* User pointer */
+};
+
 /* Device private data structure */
 struct aes_dev {
     void __iomem *regs;         /* Virtual address for registers */
@@ -56,6 +92,117 @@ static int aes_release(struct inode *inode, struct file *file)
     return 0;
 }
 
+/* Run a batch of register operations back to back, stop at the first failure */
+static long aes_batch_run(struct aes_dev *aes, struct aes_batch __user *ubatch)
+{
+    struct aes_batch batch;
+    struct aes_batch_op *ops, *op;
+    uint32_t val;
+    long ret = 0;
+    uint32_t i;
+
+    if (copy_from_user(&batch, ubatch, sizeof(batch)))
+        return -EFAULT;
+
+    if (batch.count == 0 || batch.count > AES_BATCH_MAX_OPS)
+        return -EINVAL;
+
+    ops = kmalloc_array(batch.count, sizeof(*ops), GFP_KERNEL);
+    if (!ops)
+        return -ENOMEM;
+
+    if (copy_from_user(ops, u64_to_user_ptr(batch.ops), batch.count * sizeof(*ops))) {
+        kfree(ops);
+        return -EFAULT;
+    }
+
+    for (i = 0; i < batch.count; i++) {
+        op = &ops[i];
+
+        /* Validate register offset */
+        if (op->offset >= resource_size(aes->res)) {
+            dev_err(aes->dev, "Invalid register offset: 0x%x\n", op->offset);
+            ret = -EINVAL;
+            break;
+        }
+
+        switch (op->op) {
+        case AES_BATCH_READ:
+            op->value = readl(aes->regs + op->offset);
+            break;
+        case AES_BATCH_WRITE:
+            writel(op->value, aes->regs + op->offset);
+            break;
+        case AES_BATCH_POLL:
+            ret = readl_poll_timeout(aes->regs + op->offset, val, val == 0, 0,
+                                     op->value ? op->value : AES_POLL_TIMEOUT_US);
+            op->value = val;
+            break;
+        default:
+            ret = -EINVAL;
+            break;
+        }
+        if (ret)
+            break;
+    }
+
+    /* Return read results and the number of completed operations in one copy-out */
+    batch.completed = i;
+    if (copy_to_user(u64_to_user_ptr(batch.ops), ops, batch.count * sizeof(*ops)) ||
+        copy_to_user(ubatch, &batch, sizeof(batch)))
+        ret = -EFAULT;
+
+    kfree(ops);
+    return ret;
+}
+
+/*
+ * Copy a range of the window to or from user memory, memcpy_toio/memcpy_fromio use the
+ * widest aligned accesses. DATAINCNT starts operations, so it is only written by WRITE_REG
+ */
+static long aes_range_copy(struct aes_dev *aes, struct aes_range __user *urange, bool write)
+{
+    struct aes_range range;
+    u32 pos, len;
+    long ret = 0;
+    u8 *buf;
+
+    if (copy_from_user(&range, urange, sizeof(range)))
+        return -EFAULT;
+
+    if (!range.length || (u64)range.offset + range.length > resource_size(aes->res)) {
+        dev_err(aes->dev, "Invalid range: 0x%x+0x%x\n", range.offset, range.length);
+        return -EINVAL;
+    }
+    if (write && range.offset < AES_DATAINCNT_REG + 4 &&
+        range.offset + range.length > AES_DATAINCNT_REG)
+        return -EINVAL;
+
+    buf = kmalloc(min_t(u32, range.length, AES_RANGE_CHUNK), GFP_KERNEL);
+    if (!buf)
+        return -ENOMEM;
+
+    for (pos = 0; pos < range.length; pos += len) {
+        len = min_t(u32, range.length - pos, AES_RANGE_CHUNK);
+        if (write) {
+            if (copy_from_user(buf, u64_to_user_ptr(range.buf + pos), len)) {
+                ret = -EFAULT;
+                break;
+            }
+            memcpy_toio(aes->regs + range.offset + pos, buf, len);
+        } else {
+            memcpy_fromio(buf, aes->regs + range.offset + pos, len);
+            if (copy_to_user(u64_to_user_ptr(range.buf + pos), buf, len)) {
+                ret = -EFAULT;
+                break;
+            }
+        }
+    }
+
+    kfree(buf);
+    return ret;
+}
+
 static long aes_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
     struct aes_dev *aes = file->private_data;
@@ -92,6 +239,15 @@ static long aes_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
         /* Write register value */
         writel(reg.value, aes->regs + reg.offset);
         break;
+
+    case AES_IOC_BATCH:
+        return aes_batch_run(aes, (struct aes_batch __user *)arg);
+
+    case AES_IOC_READ_RANGE:
+        return aes_range_copy(aes, (struct aes_range __user *)arg, false);
+
+    case AES_IOC_WRITE_RANGE:
+        return aes_range_copy(aes, (struct aes_range __user *)arg, true);
         
     default:
         return -ENOTTY;
@@ -0,0 +1,150 @@
+/**
+ * AES256GCM10G25GIP Kernel Driver - data mover between system memory and the BRAM windows
+ *
+ * With a "data" DMA channel in the device tree node (for the ZynqMP GDMA:
+ * dmas = <&zynqmp_dma_chan0>; dma-names = "data";) copies of at least dma_min_bytes between
+ * linear-map buffers and DATAIN/DATAOUT run on the channel while the CPU sleeps, instead of
+ * stalling on every uncached MMIO load and store. Shorter copies, vmalloc/vmap buffers (ring
+ * data areas, registered user buffers) and hosts without a channel use memcpy_toio and
+ * memcpy_fromio, which use the widest aligned accesses. dma_mover=0 forces the CPU path so
+ * both can be compared on the same board.
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/io.h>
+#include <linux/mm.h>
+#include <linux/completion.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+
+#include "aes-driver.h"
+
+#define AES_DMA_TIMEOUT_MS  100
+
+static bool dma_mover = true;
+module_param(dma_mover, bool, 0644);
+MODULE_PARM_DESC(dma_mover, "Move window data with the device tree DMA channel when there is one");
+
+static unsigned int dma_min_bytes = 256;
+module_param(dma_min_bytes, uint, 0644);
+MODULE_PARM_DESC(dma_min_bytes, "Shorter copies use the CPU, the channel setup costs more than they save");
+
+/* The channel reaches buf through the linear map only */
+static bool aes_mover_use_dma(struct aes_dev *aes, const void *buf, u32 len)
+{
+    return aes->dma && READ_ONCE(dma_mover) && len && len >= READ_ONCE(dma_min_bytes) &&
+           virt_addr_valid(buf) && virt_addr_valid(buf + len - 1);
+}
+
+static void aes_mover_done(void *arg)
+{
+    complete(arg);
+}
+
+/* One memcpy on the channel, 0 once it has completed */
+static int aes_mover_dma(struct aes_dev *aes, dma_addr_t dst, dma_addr_t src, u32 len)
+{
+    struct dma_async_tx_descriptor *tx;
+    DECLARE_COMPLETION_ONSTACK(done);
+    dma_cookie_t cookie;
+
+    tx = dmaengine_prep_dma_memcpy(aes->dma, dst, src, len, DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+    if (!tx)
+        return -ENOMEM;
+    tx->callback = aes_mover_done;
+    tx->callback_param = &done;
+
+    cookie = dmaengine_submit(tx);
+    if (dma_submit_error(cookie))
+        return -EIO;
+    dma_async_issue_pending(aes->dma);
+
+    if (!wait_for_completion_timeout(&done, msecs_to_jiffies(AES_DMA_TIMEOUT_MS))) {
+        dmaengine_terminate_sync(aes->dma);
+        return -ETIMEDOUT;
+    }
+    return 0;
+}
+
+/* Copy through the channel in the given direction, false when the CPU has to do it */
+static bool aes_mover_xfer(struct aes_dev *aes, void *buf, u32 off, u32 len,
+                           enum dma_data_direction dir)
+{
+    struct device *dd = aes->dma->device->dev;
+    dma_addr_t addr;
+    int ret;
+
+    addr = dma_map_single(dd, buf, len, dir);
+    if (dma_mapping_error(dd, addr))
+        return false;
+
+    if (dir == DMA_TO_DEVICE)
+        ret = aes_mover_dma(aes, aes->dma_win + off, addr, len);
+    else
+        ret = aes_mover_dma(aes, addr, aes->dma_win + off, len);
+    dma_unmap_single(dd, addr, len, dir);
+
+    if (ret)
+        dev_warn_ratelimited(aes->dev, "DMA copy failed (%d), copying with the CPU\n", ret);
+    return !ret;
+}
+
+bool aes_mover_to_dev(struct aes_dev *aes, u32 off, const void *src, u32 len)
+{
+    if (aes_mover_use_dma(aes, src, len) && aes_mover_xfer(aes, (void *)src, off, len, DMA_TO_DEVICE))
+        return true;
+    memcpy_toio(aes->regs + off, src, len);
+    return false;
+}
+
+bool aes_mover_from_dev(struct aes_dev *aes, void *dst, u32 off, u32 len)
+{
+    if (aes_mover_use_dma(aes, dst, len) && aes_mover_xfer(aes, dst, off, len, DMA_FROM_DEVICE))
+        return true;
+    memcpy_fromio(dst, aes->regs + off, len);
+    return false;
+}
+
+const char *aes_mover_name(struct aes_dev *aes)
+{
+    return aes->dma && READ_ONCE(dma_mover) ? dma_chan_name(aes->dma) : "cpu";
+}
+
+/* No channel is not an error, the CPU path serves every request then */
+int aes_mover_init(struct aes_dev *aes)
+{
+    struct dma_chan *chan;
+    dma_addr_t win;
+
+    chan = dma_request_chan(aes->dev, "data");
+    if (IS_ERR(chan)) {
+        if (PTR_ERR(chan) == -EPROBE_DEFER)
+            return -EPROBE_DEFER;
+        dev_info(aes->dev, "No DMA channel, window data is copied by the CPU\n");
+        return 0;
+    }
+
+    /* The windows are a slave resource of the channel's device */
+    win = dma_map_resource(chan->device->dev, aes->res->start, resource_size(aes->res),
+                           DMA_BIDIRECTIONAL, 0);
+    if (dma_mapping_error(chan->device->dev, win)) {
+        dev_warn(aes->dev, "Cannot map the windows for %s, using the CPU\n", dma_chan_name(chan));
+        dma_release_channel(chan);
+        return 0;
+    }
+
+    aes->dma = chan;
+    aes->dma_win = win;
+    dev_info(aes->dev, "Window data moved by DMA channel %s\n", dma_chan_name(chan));
+    return 0;
+}
+
+void aes_mover_exit(struct aes_dev *aes)
+{
+    if (!aes->dma)
+        return;
+    dma_unmap_resource(aes->dma->device->dev, aes->dma_win, resource_size(aes->res),
+                       DMA_BIDIRECTIONAL, 0);
+    dma_release_channel(aes->dma);
+    aes->dma = NULL;
+}
@@ -0,0 +1,165 @@
+/**
+ * AES256GCM10G25GIP Kernel Driver - tracepoints
+ *
+ * Every stage of an operation is an event of the aes256gcm system, so the same points are
+ * available to ftrace, trace-cmd, perf (perf trace -e 'aes256gcm:*') and bpftrace
+ * (tracepoint:aes256gcm:aes_op_complete). software/aes_trace_report.c turns a recorded
+ * trace into per-stage latencies.
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM aes256gcm
+
+#if !defined(AES_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define AES_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/device.h>
+
+#include "aes-driver.h"
+
+TRACE_EVENT(aes_ioctl_enter,
+    TP_PROTO(struct aes_dev *aes, unsigned int cmd, unsigned long arg),
+    TP_ARGS(aes, cmd, arg),
+    TP_STRUCT__entry(
+        __string(dev, dev_name(aes->dev))
+        __field(unsigned int, cmd)
+        __field(unsigned long, arg)
+    ),
+    TP_fast_assign(
+        __assign_str(dev, dev_name(aes->dev));
+        __entry->cmd = cmd;
+        __entry->arg = arg;
+    ),
+    TP_printk("dev=%s cmd=0x%x arg=0x%lx", __get_str(dev), __entry->cmd, __entry->arg)
+);
+
+TRACE_EVENT(aes_ioctl_exit,
+    TP_PROTO(struct aes_dev *aes, unsigned int cmd, long ret),
+    TP_ARGS(aes, cmd, ret),
+    TP_STRUCT__entry(
+        __string(dev, dev_name(aes->dev))
+        __field(unsigned int, cmd)
+        __field(long, ret)
+    ),
+    TP_fast_assign(
+        __assign_str(dev, dev_name(aes->dev));
+        __entry->cmd = cmd;
+        __entry->ret = ret;
+    ),
+    TP_printk("dev=%s cmd=0x%x ret=%ld", __get_str(dev), __entry->cmd, __entry->ret)
+);
+
+/*
+ * Register access requested by user space (AES_IOC_READ_REG/WRITE_REG/BATCH). Accesses that
+ * touch KEYIN_0..7 are recorded with value 0 so key material never reaches the trace buffers.
+ */
+DECLARE_EVENT_CLASS(aes_reg,
+    TP_PROTO(struct aes_dev *aes, u32 offset, u8 width, u64 value),
+    TP_ARGS(aes, offset, width, value),
+    TP_STRUCT__entry(
+        __string(dev, dev_name(aes->dev))
+        __field(u32, offset)
+        __field(u8, width)
+        __field(u64, value)
+    ),
+    TP_fast_assign(
+        __assign_str(dev, dev_name(aes->dev));
+        __entry->offset = offset;
+        __entry->width = width;
+        __entry->value = offset < AES_IVIN_0_REG &&
+                         offset + width / 8 > AES_KEYIN_0_REG ? 0 : value;
+    ),
+    TP_printk("dev=%s offset=0x%x width=%u value=0x%llx", __get_str(dev),
+              __entry->offset, __entry->width, __entry->value)
+);
+
+DEFINE_EVENT(aes_reg, aes_reg_read,
+    TP_PROTO(struct aes_dev *aes, u32 offset, u8 width, u64 value),
+    TP_ARGS(aes, offset, width, value)
+);
+
+DEFINE_EVENT(aes_reg, aes_reg_write,
+    TP_PROTO(struct aes_dev *aes, u32 offset, u8 width, u64 value),
+    TP_ARGS(aes, offset, width, value)
+);
+
+/* DATAINCNT is about to be written */
+TRACE_EVENT(aes_op_start,
+    TP_PROTO(struct aes_dev *aes, u32 mode, u32 aad_len, u32 data_len),
+    TP_ARGS(aes, mode, aad_len, data_len),
+    TP_STRUCT__entry(
+        __string(dev, dev_name(aes->dev))
+        __field(u32, mode)
+        __field(u32, aad_len)
+        __field(u32, data_len)
+    ),
+    TP_fast_assign(
+        __assign_str(dev, dev_name(aes->dev));
+        __entry->mode = mode;
+        __entry->aad_len = aad_len;
+        __entry->data_len = data_len;
+    ),
+    TP_printk("dev=%s mode=%u aad=%u data=%u", __get_str(dev),
+              __entry->mode, __entry->aad_len, __entry->data_len)
+);
+
+/* First observer of the completion, ns is the time since aes_op_start */
+TRACE_EVENT(aes_op_complete,
+    TP_PROTO(struct aes_dev *aes, u64 ns),
+    TP_ARGS(aes, ns),
+    TP_STRUCT__entry(
+        __string(dev, dev_name(aes->dev))
+        __field(u64, ns)
+    ),
+    TP_fast_assign(
+        __assign_str(dev, dev_name(aes->dev));
+        __entry->ns = ns;
+    ),
+    TP_printk("dev=%s ns=%llu", __get_str(dev), __entry->ns)
+);
+
+/* Copy between host memory and DATAIN/DATAOUT is about to start */
+DECLARE_EVENT_CLASS(aes_copy,
+    TP_PROTO(struct aes_dev *aes, u32 bytes),
+    TP_ARGS(aes, bytes),
+    TP_STRUCT__entry(
+        __string(dev, dev_name(aes->dev))
+        __field(u32, bytes)
+    ),
+    TP_fast_assign(
+        __assign_str(dev, dev_name(aes->dev));
+        __entry->bytes = bytes;
+    ),
+    TP_printk("dev=%s bytes=%u", __get_str(dev), __entry->bytes)
+);
+
+DEFINE_EVENT(aes_copy, aes_copy_in,
+    TP_PROTO(struct aes_dev *aes, u32 bytes),
+    TP_ARGS(aes, bytes)
+);
+
+DEFINE_EVENT(aes_copy, aes_copy_out,
+    TP_PROTO(struct aes_dev *aes, u32 bytes),
+    TP_ARGS(aes, bytes)
+);
+
+/* KEYIN is about to be programmed */
+TRACE_EVENT(aes_key_load,
+    TP_PROTO(struct aes_dev *aes),
+    TP_ARGS(aes),
+    TP_STRUCT__entry(
+        __string(dev, dev_name(aes->dev))
+    ),
+    TP_fast_assign(
+        __assign_str(dev, dev_name(aes->dev));
+    ),
+    TP_printk("dev=%s", __get_str(dev))
+);
+
+#endif /* AES_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE aes-trace
+#include <trace/define_trace.h>
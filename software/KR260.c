@@ -1,4 +1,14 @@
 #include "KR260.h"
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define KR260_BLOCK_NEON    1   // 128-bit NEON accesses on 16-byte aligned offsets
+#endif
+#ifdef KR260_SIM
+#include "KR260_sim.h"
+#endif
 
 //reads from keypress
 int getch(void) 
@@ -20,7 +30,104 @@ int getch(void)
     return ch; 
 } 
 
-uint64_t user_read(off_t addr, int wordsize) {
+// Session shared by user_read/user_write
+static struct kr260_session default_session = { .fd = -1, .base = NULL, .size = 0 };
+
+int kr260_open(struct kr260_session *s) {
+    const char *path;
+    void *base;
+
+    s->fd = -1;
+    s->base = NULL;
+    s->size = 0;
+
+#ifdef KR260_SIM
+    // Software model of the window instead of the board
+    s->fd = kr260_sim_open();
+    if (s->fd < 0) {
+        return -1;
+    }
+    s->base = kr260_sim_base();
+    s->size = AES_WINDOW_SIZE;
+    return 0;
+#endif
+
+    // Prefer the driver node, it maps the data windows write-combining and needs no root.
+    // The window of the aggregate node is the first core, AES_DEVICE selects another one
+    path = getenv("AES_DEVICE");
+    s->fd = open(path && *path ? path : "/dev/aes256gcm", O_RDWR | O_SYNC);
+    if (s->fd >= 0) {
+        base = mmap(NULL, AES_WINDOW_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, s->fd, 0);
+        if (base != MAP_FAILED) {
+            s->base = (volatile uint8_t *)base;
+            s->size = AES_WINDOW_SIZE;
+            return 0;
+        }
+        close(s->fd);
+    }
+
+    // Fall back to /dev/mem for the lifetime of the session
+    s->fd = open("/dev/mem", O_RDWR | O_SYNC);
+    if (s->fd < 0) {
+        perror("open /dev/mem failed");
+        return -1;
+    }
+
+    // Map the whole AES window once
+    base = mmap(NULL, AES_WINDOW_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, s->fd, AES_BASE_ADDR);
+    if (base == MAP_FAILED) {
+        perror("mmap failed");
+        close(s->fd);
+        s->fd = -1;
+        return -1;
+    }
+
+    s->base = (volatile uint8_t *)base;
+    s->size = AES_WINDOW_SIZE;
+    return 0;
+}
+
+void kr260_close(struct kr260_session *s) {
+#ifdef KR260_SIM
+    if (s->fd >= 0) {
+        kr260_sim_close(s->fd);
+    }
+    s->fd = -1;
+    s->base = NULL;
+    s->size = 0;
+    return;
+#endif
+
+    if (s->base) {
+        if (munmap((void *)s->base, s->size)) {
+            perror("munmap failed");
+        }
+        s->base = NULL;
+        s->size = 0;
+    }
+
+    if (s->fd >= 0) {
+        if (close(s->fd)) {
+            perror("cannot close device");
+        }
+        s->fd = -1;
+    }
+}
+
+struct kr260_session *kr260_default_session(void) {
+    if (!default_session.base && kr260_open(&default_session) < 0) {
+        return NULL;
+    }
+    return &default_session;
+}
+
+// Function to close the device when done
+void close_device(void) {
+    kr260_close(&default_session);
+}
+
+// Access outside the AES window: map the page for a single access
+static uint64_t devmem_read(off_t addr, int wordsize) {
     int mem_fd;
     void *base, *offset;
     long pagesize;
@@ -86,7 +193,8 @@ uint64_t user_read(off_t addr, int wordsize) {
 }
 
 
-uint64_t user_write(off_t addr, int wordsize, uint64_t data) {
+// Access outside the AES window: map the page for a single access
+static uint64_t devmem_write(off_t addr, int wordsize, uint64_t data) {
     int mem_fd;
     void *base, *offset;
     long pagesize;
@@ -154,3 +262,603 @@ uint64_t user_write(off_t addr, int wordsize, uint64_t data) {
 
     return result;
 }
+
+uint64_t user_read(off_t addr, int wordsize) {
+    struct kr260_session *s;
+    uint32_t offset;
+
+    if (addr < AES_BASE_ADDR || addr > (AES_BASE_ADDR + AES_ADDR_RANGE)) {
+        return devmem_read(addr, wordsize);
+    }
+
+    s = kr260_default_session();
+    if (!s) {
+        return 0;
+    }
+    offset = (uint32_t)(addr - AES_BASE_ADDR);
+
+    // Read the data based on the word size
+    switch (wordsize) {
+        case 64:
+            return kr260_read64(s, offset);
+        case 32:
+            return kr260_read32(s, offset);
+        case 16:
+            return kr260_read16(s, offset);
+        case 8:
+            return kr260_read8(s, offset);
+        default:
+            fprintf(stderr, "Invalid wordsize specified\n");
+            return 0;
+    }
+}
+
+uint64_t user_write(off_t addr, int wordsize, uint64_t data) {
+    struct kr260_session *s;
+    uint32_t offset;
+
+    if (addr < AES_BASE_ADDR || addr > (AES_BASE_ADDR + AES_ADDR_RANGE)) {
+        return devmem_write(addr, wordsize, data);
+    }
+
+    s = kr260_default_session();
+    if (!s) {
+        return 0;
+    }
+    offset = (uint32_t)(addr - AES_BASE_ADDR);
+
+    // Write the data based on the word size
+    switch (wordsize) {
+        case 64:
+            kr260_write64(s, offset, data);
+            return kr260_read64(s, offset);
+        case 32:
+            kr260_write32(s, offset, (uint32_t)data);
+            return kr260_read32(s, offset);
+        case 16:
+            kr260_write16(s, offset, (uint16_t)data);
+            return kr260_read16(s, offset);
+        case 8:
+            kr260_write8(s, offset, (uint8_t)data);
+            return kr260_read8(s, offset);
+        default:
+            fprintf(stderr, "Invalid wordsize specified\n");
+            return 0;
+    }
+}
+
+// Copy from the window into a host buffer: bytes up to alignment, then 128/64-bit words, then bytes
+void kr260_read_block(const struct kr260_session *s, uint32_t offset, void *buf, size_t len) {
+    uint8_t *dst = buf;
+    uint64_t word;
+
+    kr260_rmb();
+    while (len > 0 && (offset & 7)) {
+        *dst++ = kr260_read8(s, offset++);
+        len--;
+    }
+#ifdef KR260_BLOCK_NEON
+    if (len >= 8 && (offset & 15)) {
+        word = kr260_read64(s, offset);
+        memcpy(dst, &word, 8);
+        dst += 8;
+        offset += 8;
+        len -= 8;
+    }
+    while (len >= 16) {
+        vst1q_u8(dst, vld1q_u8((const uint8_t *)(s->base + offset)));
+        dst += 16;
+        offset += 16;
+        len -= 16;
+    }
+#endif
+    while (len >= 8) {
+        word = kr260_read64(s, offset);
+        memcpy(dst, &word, 8);
+        dst += 8;
+        offset += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        *dst++ = kr260_read8(s, offset++);
+        len--;
+    }
+}
+
+// Copy a host buffer into the window: bytes up to alignment, then 128/64-bit words, then bytes
+void kr260_write_block(struct kr260_session *s, uint32_t offset, const void *buf, size_t len) {
+    const uint8_t *src = buf;
+    uint64_t word;
+
+    while (len > 0 && (offset & 7)) {
+        kr260_write8(s, offset++, *src++);
+        len--;
+    }
+#ifdef KR260_BLOCK_NEON
+    if (len >= 8 && (offset & 15)) {
+        memcpy(&word, src, 8);
+        kr260_write64(s, offset, word);
+        src += 8;
+        offset += 8;
+        len -= 8;
+    }
+    while (len >= 16) {
+        vst1q_u8((uint8_t *)(s->base + offset), vld1q_u8(src));
+        src += 16;
+        offset += 16;
+        len -= 16;
+    }
+#endif
+    while (len >= 8) {
+        memcpy(&word, src, 8);
+        kr260_write64(s, offset, word);
+        src += 8;
+        offset += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        kr260_write8(s, offset++, *src++);
+        len--;
+    }
+    kr260_wmb();
+}
+
+// Fill part of the window with zeros
+void kr260_zero_block(struct kr260_session *s, uint32_t offset, size_t len) {
+    while (len > 0 && (offset & 7)) {
+        kr260_write8(s, offset++, 0);
+        len--;
+    }
+    while (len >= 8) {
+        kr260_write64(s, offset, 0);
+        offset += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        kr260_write8(s, offset++, 0);
+        len--;
+    }
+    kr260_wmb();
+}
+
+int read_block(off_t addr, void *buf, size_t len) {
+    struct kr260_session *s;
+
+    if (addr < AES_BASE_ADDR || addr + len > (AES_BASE_ADDR + AES_WINDOW_SIZE)) {
+        fprintf(stderr, "Error: Block 0x%lx+0x%zx is outside AES device range\n", (unsigned long)addr, len);
+        return -1;
+    }
+
+    s = kr260_default_session();
+    if (!s) {
+        return -1;
+    }
+
+    kr260_read_block(s, (uint32_t)(addr - AES_BASE_ADDR), buf, len);
+    return 0;
+}
+
+int write_block(off_t addr, const void *buf, size_t len, int zero_padding) {
+    struct kr260_session *s;
+    uint32_t offset;
+    size_t pad = 0;
+
+    offset = (uint32_t)(addr - AES_BASE_ADDR);
+    if (zero_padding) {
+        pad = ((offset + len + 15) & ~(size_t)15) - (offset + len);
+    }
+
+    if (addr < AES_BASE_ADDR || addr + len + pad > (AES_BASE_ADDR + AES_WINDOW_SIZE)) {
+        fprintf(stderr, "Error: Block 0x%lx+0x%zx is outside AES device range\n", (unsigned long)addr, len + pad);
+        return -1;
+    }
+
+    s = kr260_default_session();
+    if (!s) {
+        return -1;
+    }
+
+    kr260_write_block(s, offset, buf, len);
+    kr260_zero_block(s, offset + len, pad);
+    return 0;
+}
+
+void batch_read(struct aes_batch_op *op, off_t addr, int wordsize) {
+    op->offset = (uint32_t)(addr - AES_BASE_ADDR);
+    op->op = AES_BATCH_READ;
+    op->value = 0;
+    op->width = wordsize;
+}
+
+void batch_write(struct aes_batch_op *op, off_t addr, int wordsize, uint64_t data) {
+    op->offset = (uint32_t)(addr - AES_BASE_ADDR);
+    op->op = AES_BATCH_WRITE;
+    op->value = data;
+    op->width = wordsize;
+}
+
+void batch_poll(struct aes_batch_op *op, off_t addr, uint32_t timeout_us) {
+    op->offset = (uint32_t)(addr - AES_BASE_ADDR);
+    op->op = AES_BATCH_POLL;
+    op->value = timeout_us;
+    op->width = 32;
+}
+
+// Completion wait policy and counters of the mapped path
+static uint32_t wait_mode = AES_WAIT_SPIN;
+static struct aes_wait_stats wait_stats;
+
+// Cost model of one operation, calibrated from spin-observed completions
+static double cost_base_ns = 1000.0;
+static double cost_byte_ns = 1.0;
+static double poll_cost_ns = 100.0;
+
+#define HYBRID_MIN_SLEEP_NS     60000   // nanosleep wakeup slack makes shorter sleeps useless
+#define COST_SMALL_OP           64      // operations up to this size calibrate the fixed cost
+
+static uint64_t elapsed_ns(const struct timespec *start) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000000ULL + (now.tv_nsec - start->tv_nsec);
+}
+
+// Spin on a 32-bit register until it reads zero. Return 0, or -1 on timeout
+static int poll_zero(struct kr260_session *s, uint32_t offset, uint32_t timeout_us, uint64_t *last) {
+    struct timespec start;
+    uint32_t value;
+    uint64_t iters = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while ((value = kr260_read32(s, offset)) != 0) {
+        iters++;
+        if (elapsed_ns(&start) > (uint64_t)timeout_us * 1000) {
+            wait_stats.spin_iters += iters;
+            *last = value;
+            return -1;
+        }
+        kr260_cpu_relax();
+    }
+
+    if (iters) {
+        poll_cost_ns = (poll_cost_ns * 7 + (double)elapsed_ns(&start) / iters) / 8;
+    }
+    wait_stats.spin_iters += iters;
+    *last = 0;
+    return 0;
+}
+
+// Wait for an operation of bytes started at start with the selected policy
+static int wait_done(struct kr260_session *s, uint32_t bytes, const struct timespec *start) {
+    struct timespec sleep_time;
+    double predicted = cost_base_ns + cost_byte_ns * bytes;
+    uint64_t elapsed, sleep_ns;
+    uint64_t last;
+
+    wait_stats.waits++;
+    wait_stats.predicted_ns += (uint64_t)predicted;
+
+    // Sleep through most of the predicted time, spin only for the last stretch
+    elapsed = elapsed_ns(start);
+    if (wait_mode == AES_WAIT_HYBRID && predicted > elapsed + predicted / 8 + HYBRID_MIN_SLEEP_NS) {
+        sleep_ns = (uint64_t)(predicted - elapsed - predicted / 8);
+        sleep_time.tv_sec = sleep_ns / 1000000000ULL;
+        sleep_time.tv_nsec = sleep_ns % 1000000000ULL;
+        nanosleep(&sleep_time, NULL);
+        wait_stats.sleeps++;
+        wait_stats.spins_saved += (uint64_t)(sleep_ns / (poll_cost_ns > 1.0 ? poll_cost_ns : 1.0));
+    }
+
+    if (poll_zero(s, AES_DATAINCNT_REG, 1000000, &last) < 0) {
+        return -1;
+    }
+
+    // Fold the observed time into the cost model (EWMA, weight 1/8)
+    elapsed = elapsed_ns(start);
+    wait_stats.actual_ns += elapsed;
+    if (bytes <= COST_SMALL_OP) {
+        cost_base_ns = (cost_base_ns * 7 + elapsed) / 8;
+    } else if (elapsed > cost_base_ns) {
+        cost_byte_ns = (cost_byte_ns * 7 + (elapsed - cost_base_ns) / bytes) / 8;
+    }
+    return 0;
+}
+
+int aes_set_wait_mode(uint32_t mode) {
+    // The done interrupt is only reachable through the driver ioctls
+    if (mode != AES_WAIT_SPIN && mode != AES_WAIT_HYBRID) {
+        errno = EINVAL;
+        return -1;
+    }
+    wait_mode = mode;
+    return 0;
+}
+
+int aes_get_wait_stats(struct aes_wait_stats *stats) {
+    *stats = wait_stats;
+    return 0;
+}
+
+int user_batch(struct aes_batch_op *ops, unsigned int count) {
+    struct kr260_session *s;
+    unsigned int i;
+
+    s = kr260_default_session();
+    if (!s) {
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (ops[i].offset > AES_ADDR_RANGE) {
+            fprintf(stderr, "Error: Invalid register offset: 0x%x\n", ops[i].offset);
+            break;
+        }
+
+        if (ops[i].op == AES_BATCH_READ) {
+            switch (ops[i].width) {
+                case 64: ops[i].value = kr260_read64(s, ops[i].offset); break;
+                case 16: ops[i].value = kr260_read16(s, ops[i].offset); break;
+                case 8:  ops[i].value = kr260_read8(s, ops[i].offset); break;
+                default: ops[i].value = kr260_read32(s, ops[i].offset); break;
+            }
+        } else if (ops[i].op == AES_BATCH_WRITE) {
+            switch (ops[i].width) {
+                case 64: kr260_write64(s, ops[i].offset, ops[i].value); break;
+                case 16: kr260_write16(s, ops[i].offset, (uint16_t)ops[i].value); break;
+                case 8:  kr260_write8(s, ops[i].offset, (uint8_t)ops[i].value); break;
+                default: kr260_write32(s, ops[i].offset, (uint32_t)ops[i].value); break;
+            }
+        } else if (ops[i].op == AES_BATCH_POLL) {
+            if (poll_zero(s, ops[i].offset, ops[i].value ? ops[i].value : 1000000, &ops[i].value) < 0) {
+                break;
+            }
+        } else {
+            break;
+        }
+    }
+
+    return (int)i;
+}
+
+// Convert 4 big-endian bytes to a register value
+static uint32_t be32_to_reg(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// KEYIN_7 holds the first key bytes
+static void write_key(struct kr260_session *s, const uint8_t *key) {
+    for (int i = 0; i < 8; i++) {
+        kr260_write32(s, AES_KEYIN_0_REG + 4 * i, be32_to_reg(key + 4 * (7 - i)));
+    }
+}
+
+// IVIN_2 holds the first IV bytes
+static void write_iv(struct kr260_session *s, const uint8_t *iv) {
+    for (int i = 0; i < 3; i++) {
+        kr260_write32(s, AES_IVIN_0_REG + 4 * i, be32_to_reg(iv + 4 * (2 - i)));
+    }
+}
+
+// TAG_3 holds the first tag bytes
+static void read_tag(struct kr260_session *s, uint8_t *tag) {
+    uint32_t value;
+
+    for (int i = 0; i < 4; i++) {
+        value = kr260_read32(s, AES_TAG_0_REG + 4 * i);
+        tag[4 * (3 - i) + 0] = (uint8_t)(value >> 24);
+        tag[4 * (3 - i) + 1] = (uint8_t)(value >> 16);
+        tag[4 * (3 - i) + 2] = (uint8_t)(value >> 8);
+        tag[4 * (3 - i) + 3] = (uint8_t)value;
+    }
+}
+
+int aes_gcm_run(unsigned int mode, const uint8_t *key, const uint8_t *iv,
+                const uint8_t *aad, uint32_t aad_len,
+                const uint8_t *in, uint8_t *out, uint32_t data_len, uint8_t *tag) {
+    struct kr260_session *s;
+    uint32_t aad_pad = (aad_len + 15) & ~15u;
+    uint64_t last;
+    uint8_t hw_tag[16], diff = 0;
+    struct timespec start;
+
+    // DATAINCNT=0 never starts an operation, and a decrypt needs the expected tag
+    if (mode > AES_MODE_BYPASS || aad_len > AES_DATA_SIZE || data_len == 0 ||
+        data_len > AES_DATA_SIZE - aad_pad || (mode == AES_MODE_DECRYPT && !tag)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    s = kr260_default_session();
+    if (!s) {
+        return -1;
+    }
+
+    if (poll_zero(s, AES_DATAINCNT_REG, 1000000, &last) < 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    if (key) {
+        write_key(s, key);
+    }
+    write_iv(s, iv);
+
+    // AAD zero padded to 16 bytes, then the payload
+    kr260_write_block(s, AES_DATAIN_OFFSET, aad, aad_len);
+    kr260_zero_block(s, AES_DATAIN_OFFSET + aad_len, aad_pad - aad_len);
+    kr260_write_block(s, AES_DATAIN_OFFSET + aad_pad, in, data_len);
+
+    if (mode == AES_MODE_BYPASS) {
+        kr260_write32(s, AES_BYPASS_REG, 1);
+    } else {
+        kr260_write32(s, AES_DECEN_REG, mode);
+        kr260_write32(s, AES_BYPASS_REG, 0);
+    }
+    kr260_write32(s, AES_ADDR_A1_REG, 0);
+    kr260_write32(s, AES_ADDR_A2_REG, 0);
+    kr260_write32(s, AES_AADINCNT_REG, aad_len);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    kr260_write32(s, AES_DATAINCNT_REG, data_len);
+
+    if (wait_done(s, aad_len + data_len, &start) < 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    read_tag(s, hw_tag);
+
+    // Decrypted data is only released when the tag matches, compared in constant time
+    if (mode == AES_MODE_DECRYPT) {
+        for (int i = 0; i < 16; i++) {
+            diff |= hw_tag[i] ^ tag[i];
+        }
+        if (diff) {
+            errno = EBADMSG;
+            return -1;
+        }
+    }
+
+    kr260_read_block(s, AES_DATAOUT_OFFSET + aad_pad, out, data_len);
+    if (tag) {
+        memcpy(tag, hw_tag, sizeof(hw_tag));
+    }
+    return 0;
+}
+
+int aes_pipe_init(struct aes_pipe *p, struct kr260_session *s, unsigned int slots) {
+    if (slots < 1 || slots > AES_PIPE_MAX_SLOTS) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!s) {
+        s = kr260_default_session();
+        if (!s) {
+            return -1;
+        }
+    }
+    p->s = s;
+    p->slots = slots;
+    p->slot_size = (AES_DATA_SIZE / slots) & ~15u;
+    return 0;
+}
+
+// Copy the padded AAD and the payload of a job into its DATAIN slot
+static void pipe_load(struct aes_pipe *p, const struct aes_pipe_job *job, uint32_t slot) {
+    uint32_t base = AES_DATAIN_OFFSET + slot * p->slot_size;
+    uint32_t aad_pad = (job->aad_len + 15) & ~15u;
+
+    kr260_write_block(p->s, base, job->aad, job->aad_len);
+    kr260_zero_block(p->s, base + job->aad_len, aad_pad - job->aad_len);
+    kr260_write_block(p->s, base + aad_pad, job->in, job->data_len);
+}
+
+// Program a loaded job and start it, A1/A2 are byte offsets of its slot in DATAIN/DATAOUT
+static void pipe_start(struct aes_pipe *p, const struct aes_pipe_job *job, uint32_t slot, struct timespec *start) {
+    struct kr260_session *s = p->s;
+
+    write_iv(s, job->iv);
+    if (job->mode == AES_MODE_BYPASS) {
+        kr260_write32(s, AES_BYPASS_REG, 1);
+    } else {
+        kr260_write32(s, AES_DECEN_REG, job->mode);
+        kr260_write32(s, AES_BYPASS_REG, 0);
+    }
+    kr260_write32(s, AES_ADDR_A1_REG, slot * p->slot_size);
+    kr260_write32(s, AES_ADDR_A2_REG, slot * p->slot_size);
+    kr260_write32(s, AES_AADINCNT_REG, job->aad_len);
+    clock_gettime(CLOCK_MONOTONIC, start);
+    kr260_write32(s, AES_DATAINCNT_REG, job->data_len);
+}
+
+// Copy the output of a finished job out of its DATAOUT slot, decrypted data only when the tag matched
+static void pipe_unload(struct aes_pipe *p, const struct aes_pipe_job *job, uint32_t slot) {
+    uint32_t aad_pad = (job->aad_len + 15) & ~15u;
+
+    if (job->status == 0) {
+        kr260_read_block(p->s, AES_DATAOUT_OFFSET + slot * p->slot_size + aad_pad, job->out, job->data_len);
+    }
+}
+
+int aes_pipe_run(struct aes_pipe *p, const uint8_t *key, struct aes_pipe_job *jobs, unsigned int count) {
+    struct kr260_session *s = p->s;
+    uint32_t limit = p->slot_size;
+    unsigned int loaded = 0, unloaded = 0, n;
+    struct timespec start;
+    uint8_t hw_tag[16];
+    uint64_t last;
+    int good = 0;
+
+    for (n = 0; n < count; n++) {
+        uint32_t aad_pad = (jobs[n].aad_len + 15) & ~15u;
+
+        if (jobs[n].mode > AES_MODE_BYPASS || jobs[n].aad_len > limit || jobs[n].data_len > limit - aad_pad) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    if (poll_zero(s, AES_DATAINCNT_REG, 1000000, &last) < 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+    if (key) {
+        write_key(s, key);
+    }
+
+    for (n = 0; n < count; n++) {
+        // Job n writes the DATAOUT slot of job n - slots, which must be copied out first
+        while (loaded <= n) {
+            pipe_load(p, &jobs[loaded], loaded % p->slots);
+            loaded++;
+        }
+        while (unloaded + p->slots <= n) {
+            pipe_unload(p, &jobs[unloaded], unloaded % p->slots);
+            unloaded++;
+        }
+        pipe_start(p, &jobs[n], n % p->slots, &start);
+
+        // Overlap the IP: fill the other DATAIN slots, drain the other DATAOUT slots
+        while (loaded < count && loaded < n + p->slots) {
+            pipe_load(p, &jobs[loaded], loaded % p->slots);
+            loaded++;
+        }
+        while (unloaded < n) {
+            pipe_unload(p, &jobs[unloaded], unloaded % p->slots);
+            unloaded++;
+        }
+
+        if (wait_done(s, jobs[n].aad_len + jobs[n].data_len, &start) < 0) {
+            for (; n < count; n++) {
+                jobs[n].status = ETIMEDOUT;
+            }
+            break;
+        }
+
+        // The tag registers are overwritten by the next start
+        read_tag(s, hw_tag);
+        if (jobs[n].mode == AES_MODE_DECRYPT && memcmp(hw_tag, jobs[n].tag, sizeof(hw_tag)) != 0) {
+            jobs[n].status = EBADMSG;
+        } else {
+            memcpy(jobs[n].tag, hw_tag, sizeof(hw_tag));
+            jobs[n].status = 0;
+            good++;
+        }
+    }
+
+    while (unloaded < count) {
+        pipe_unload(p, &jobs[unloaded], unloaded % p->slots);
+        unloaded++;
+    }
+    return good;
+}
+
+int aes_wait_idle(uint32_t timeout_us) {
+    struct kr260_session *s;
+    uint64_t last;
+
+    s = kr260_default_session();
+    if (!s) {
+        return -1;
+    }
+    return poll_zero(s, AES_DATAINCNT_REG, timeout_us ? timeout_us : 1000000, &last);
+}
@@ -8,11 +8,93 @@
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <termios.h>
+#include <sched.h>
 
 //change input/output func from UART to match terminal
 #define gen_printf			printf
 #define get_char			getch
 
+#define AES_BASE_ADDR   0xA0000000
+#define AES_ADDR_RANGE  0xFFFF
+#define AES_WINDOW_SIZE (AES_ADDR_RANGE + 1)
+
+/* Batch operation types, same encoding as the driver batch ioctl */
+#define AES_BATCH_READ      0   /* Read register into value */
+#define AES_BATCH_WRITE     1   /* Write value to register */
+#define AES_BATCH_POLL      2   /* Read register until it is zero, value = timeout in us (0 = default) */
+#define AES_BATCH_MAX_OPS   256
+
+/* Operation modes for aes_gcm_run */
+#define AES_MODE_ENCRYPT    0
+#define AES_MODE_DECRYPT    1
+#define AES_MODE_BYPASS     2
+
+/* Completion wait modes */
+#define AES_WAIT_IRQ        0   /* Sleep until the done interrupt (or the kernel poll timer) */
+#define AES_WAIT_SPIN       1   /* Spin on DATAINCNT */
+#define AES_WAIT_HYBRID     2   /* Sleep for most of the predicted time, then spin */
+
+/* Register map, offsets relative to AES_BASE_ADDR */
+#define AES_ADDR_A1_REG     0x00
+#define AES_ADDR_A2_REG     0x04
+#define AES_AADINCNT_REG    0x08
+#define AES_DATAINCNT_REG   0x0C
+#define AES_VER_REG         0x10
+#define AES_DECEN_REG       0x14
+#define AES_BYPASS_REG      0x18
+#define AES_KEYIN_0_REG     0x20
+#define AES_IVIN_0_REG      0x40
+#define AES_TAG_0_REG       0x50
+#define AES_DATAIN_OFFSET   0x2000
+#define AES_DATAOUT_OFFSET  0x4000
+#define AES_DATA_SIZE       2048    /* BRAM bytes used per operation, AAD padded to 16 plus payload */
+#define AES_PIPE_MAX_SLOTS  4
+
+/* One entry of a batch */
+struct aes_batch_op {
+    uint32_t offset;    /* Register offset */
+    uint32_t op;        /* AES_BATCH_READ, AES_BATCH_WRITE or AES_BATCH_POLL */
+    uint64_t value;     /* Value to write, value read or poll timeout */
+    uint8_t width;      /* Access width in bits: 8, 16, 32, 64 */
+};
+
+/* Completion wait counters */
+struct aes_wait_stats {
+    uint64_t waits;         /* Completion waits */
+    uint64_t sleeps;        /* Waits that slept (IRQ mode, or hybrid before spinning) */
+    uint64_t spin_iters;    /* DATAINCNT polls spent spinning */
+    uint64_t spins_saved;   /* Estimated polls avoided by hybrid sleeps */
+    uint64_t predicted_ns;  /* Sum of predicted operation times */
+    uint64_t actual_ns;     /* Sum of observed operation times (spin and hybrid) */
+};
+
+/* One operation of a pipelined run */
+struct aes_pipe_job {
+    unsigned int mode;      /* AES_MODE_ENCRYPT, AES_MODE_DECRYPT or AES_MODE_BYPASS */
+    uint8_t iv[12];
+    const uint8_t *aad;
+    uint32_t aad_len;
+    const uint8_t *in;
+    uint8_t *out;
+    uint32_t data_len;
+    uint8_t tag[16];        /* Tag out for encrypt, expected tag for decrypt */
+    int status;             /* Set by aes_pipe_run: 0, EBADMSG or ETIMEDOUT */
+};
+
+/* The AES_DATA_SIZE bytes of DATAIN/DATAOUT split into slots: slot i starts at i * slot_size in both */
+struct aes_pipe {
+    struct kr260_session *s;
+    unsigned int slots;     /* 1 = serial, 2 = ping-pong, up to AES_PIPE_MAX_SLOTS */
+    uint32_t slot_size;     /* Bytes per slot, multiple of 16 */
+};
+
+/* Persistent mapping of the whole AES register window */
+struct kr260_session {
+    int               fd;       /* File descriptor of /dev/aes256gcm or /dev/mem */
+    volatile uint8_t *base;     /* Virtual address of AES_BASE_ADDR */
+    size_t            size;     /* Length of the mapping in bytes */
+};
+
 // Function to read a single character from keyboard without echoing it
 int getch(void);
 
@@ -22,4 +104,137 @@ uint64_t user_read(off_t addr, int wordsize);
 // Function to write to a memory-mapped address
 uint64_t user_write(off_t addr, int wordsize, uint64_t data);
 
+// Fill one batch entry, addr is a physical address as for user_read/user_write
+void batch_read(struct aes_batch_op *op, off_t addr, int wordsize);
+void batch_write(struct aes_batch_op *op, off_t addr, int wordsize, uint64_t data);
+void batch_poll(struct aes_batch_op *op, off_t addr, uint32_t timeout_us);
+
+// Run count operations back to back with one call. Return the number of operations completed, or -1
+int user_batch(struct aes_batch_op *ops, unsigned int count);
+
+// Run a whole AES-GCM operation with one call. key=NULL reuses the loaded key, tag is output for
+// encrypt and expected tag for decrypt (required). data_len must be at least 1. Return 0, or -1 with
+// errno=EBADMSG when the tag does not match, EINVAL for bad arguments
+int aes_gcm_run(unsigned int mode, const uint8_t *key, const uint8_t *iv,
+                const uint8_t *aad, uint32_t aad_len,
+                const uint8_t *in, uint8_t *out, uint32_t data_len, uint8_t *tag);
+
+// Split the AES_DATA_SIZE bytes of BRAM into slots for aes_pipe_run, s=NULL uses the default session.
+// A job must fit its slot, so more slots take smaller messages. Return 0, or -1 with errno=EINVAL
+// when slots is out of range
+int aes_pipe_init(struct aes_pipe *p, struct kr260_session *s, unsigned int slots);
+
+// Run count jobs in order with the slots of p. While the IP runs job N, job N+1 is copied into its
+// DATAIN slot and job N-1 out of its DATAOUT slot. key=NULL reuses the loaded key. Return the number
+// of jobs with status 0, or -1 with errno=EINVAL when a job does not fit a slot (nothing is run)
+int aes_pipe_run(struct aes_pipe *p, const uint8_t *key, struct aes_pipe_job *jobs, unsigned int count);
+
+// Spin until the device is idle, timeout_us=0 uses 1 s. Return 0, or -1 on timeout
+int aes_wait_idle(uint32_t timeout_us);
+
+// Select how completion is awaited: AES_WAIT_SPIN or AES_WAIT_HYBRID (no IRQ through the mapping).
+// Return 0 or -1
+int aes_set_wait_mode(uint32_t mode);
+
+// Read the completion wait counters. Return 0 or -1
+int aes_get_wait_stats(struct aes_wait_stats *stats);
+
+// Function to close the device when done
+void close_device(void);
+
+// Copy len bytes from the AES window at addr into buf
+int read_block(off_t addr, void *buf, size_t len);
+
+// Copy len bytes from buf into the AES window at addr, zero_padding=1 fills up to the next 16-byte boundary
+int write_block(off_t addr, const void *buf, size_t len, int zero_padding);
+
+// Map 0xA0000000-0xA000FFFF once through /dev/aes256gcm, or /dev/mem if the driver is not loaded.
+// Return 0 on success, -1 on error
+int kr260_open(struct kr260_session *s);
+
+// Unmap the window and close the device
+void kr260_close(struct kr260_session *s);
+
+// Return the session used by user_read/user_write, opening it on first use
+struct kr260_session *kr260_default_session(void);
+
+// Block copies between a host buffer and the window using the widest aligned accesses
+void kr260_read_block(const struct kr260_session *s, uint32_t offset, void *buf, size_t len);
+void kr260_write_block(struct kr260_session *s, uint32_t offset, const void *buf, size_t len);
+void kr260_zero_block(struct kr260_session *s, uint32_t offset, size_t len);
+
+// The driver maps DATAIN/DATAOUT write-combining and the registers as device memory,
+// so window stores must be ordered before the start register and window loads after the poll
+static inline void kr260_wmb(void)
+{
+#if defined(__aarch64__)
+    __asm__ volatile("dmb oshst" ::: "memory");
+#else
+    __sync_synchronize();
+#endif
+}
+
+static inline void kr260_rmb(void)
+{
+#if defined(__aarch64__)
+    __asm__ volatile("dmb oshld" ::: "memory");
+#else
+    __sync_synchronize();
+#endif
+}
+
+// Spin-loop hint while polling a register. The simulated device runs on a host thread that
+// may share the core, so polling yields instead
+static inline void kr260_cpu_relax(void)
+{
+#if defined(KR260_SIM)
+    sched_yield();
+#elif defined(__aarch64__)
+    __asm__ volatile("yield" ::: "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+    __asm__ volatile("pause" ::: "memory");
+#endif
+}
+
+// Register accessors, offset is relative to AES_BASE_ADDR
+static inline uint8_t kr260_read8(const struct kr260_session *s, uint32_t offset)
+{
+    return *(volatile uint8_t *)(s->base + offset);
+}
+
+static inline uint16_t kr260_read16(const struct kr260_session *s, uint32_t offset)
+{
+    return *(volatile uint16_t *)(s->base + offset);
+}
+
+static inline uint32_t kr260_read32(const struct kr260_session *s, uint32_t offset)
+{
+    return *(volatile uint32_t *)(s->base + offset);
+}
+
+static inline uint64_t kr260_read64(const struct kr260_session *s, uint32_t offset)
+{
+    return *(volatile uint64_t *)(s->base + offset);
+}
+
+static inline void kr260_write8(struct kr260_session *s, uint32_t offset, uint8_t data)
+{
+    *(volatile uint8_t *)(s->base + offset) = data;
+}
+
+static inline void kr260_write16(struct kr260_session *s, uint32_t offset, uint16_t data)
+{
+    *(volatile uint16_t *)(s->base + offset) = data;
+}
+
+static inline void kr260_write32(struct kr260_session *s, uint32_t offset, uint32_t data)
+{
+    *(volatile uint32_t *)(s->base + offset) = data;
+}
+
+static inline void kr260_write64(struct kr260_session *s, uint32_t offset, uint64_t data)
+{
+    *(volatile uint64_t *)(s->base + offset) = data;
+}
+
 #endif // KR260_H
@@ -1,15 +1,33 @@
 // Not support 64 bit read/write
 #include "KR260_ioctl.h"
+#include <poll.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <sys/mman.h>
+#ifdef KR260_SIM
+// Driver ioctls run against the software model
+#include "KR260_sim.h"
+#define ioctl(fd, cmd, arg) kr260_sim_ioctl((fd), (cmd), (unsigned long)(arg))
+#endif
 
 #define AES_BASE_ADDR 0xA0000000
 #define AES_ADDR_RANGE 0xFFFF
+#define AES_RING_WAIT_SPINS 4096    /* CQ polls before aes_ring_wait_cqe sleeps */
+
 // Global file descriptor for the AES device
 static int aes_fd = -1;
 
-// Opens the AES device if not already open
+// Opens the AES device if not already open: AES_DEVICE, else the aggregate node of all cores
 static int ensure_device_open(void) {
+    const char *path = getenv("AES_DEVICE");
+
     if (aes_fd < 0) {
-        aes_fd = open("/dev/aes256gcm", O_RDWR);
+#ifdef KR260_SIM
+        (void)path;
+        aes_fd = kr260_sim_open();
+#else
+        aes_fd = open(path && *path ? path : "/dev/aes256gcm", O_RDWR);
+#endif
         if (aes_fd < 0) {
             perror("Failed to open AES device");
             return -1;
@@ -141,7 +159,488 @@ uint64_t user_write(off_t addr, int wordsize, uint64_t data) {
 // Function to close the device when done
 void close_device(void) {
     if (aes_fd >= 0) {
+#ifdef KR260_SIM
+        kr260_sim_close(aes_fd);
+#else
         close(aes_fd);
+#endif
         aes_fd = -1;
     }
-}
\ No newline at end of file
+}
+
+// Check that [addr, addr+len) lies in the AES window and open the device
+static int block_prepare(off_t addr, size_t len) {
+    if (addr < AES_BASE_ADDR || addr + len > (AES_BASE_ADDR + 0x10000)) {
+        fprintf(stderr, "Error: Block 0x%lx+0x%zx is outside AES device range (0x%x-0x%x)\n",
+                (unsigned long)addr, len, AES_BASE_ADDR, AES_BASE_ADDR + 0xFFFF);
+        return -1;
+    }
+    return ensure_device_open();
+}
+
+// Bulk copy on an already opened device, offset relative to AES_BASE_ADDR
+static int range_access(unsigned long cmd, uint32_t offset, const void *buf, size_t len) {
+    struct aes_range range;
+
+    range.offset = offset;
+    range.length = (uint32_t)len;
+    range.buf = (uint64_t)(uintptr_t)buf;
+
+    if (ioctl(aes_fd, cmd, &range) < 0) {
+        perror(cmd == AES_IOC_READ_RANGE ? "ioctl range read failed" : "ioctl range write failed");
+        return -1;
+    }
+    return 0;
+}
+
+// Copy len bytes from the AES window into buf with one ioctl
+int read_block(off_t addr, void *buf, size_t len) {
+    if (block_prepare(addr, len) < 0) {
+        return -1;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    return range_access(AES_IOC_READ_RANGE, (uint32_t)(addr - AES_BASE_ADDR), buf, len);
+}
+
+// Copy len bytes from buf into the AES window, zero_padding=1 fills up to the next 16-byte boundary
+int write_block(off_t addr, const void *buf, size_t len, int zero_padding) {
+    static const uint8_t zeros[16];
+    uint32_t offset = (uint32_t)(addr - AES_BASE_ADDR);
+    size_t pad = 0;
+
+    if (zero_padding) {
+        pad = ((offset + len + 15) & ~(size_t)15) - (offset + len);
+    }
+    if (block_prepare(addr, len + pad) < 0) {
+        return -1;
+    }
+
+    if (len > 0 && range_access(AES_IOC_WRITE_RANGE, offset, buf, len) < 0) {
+        return -1;
+    }
+    if (pad > 0 && range_access(AES_IOC_WRITE_RANGE, offset + (uint32_t)len, zeros, pad) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+void batch_read(struct aes_batch_op *op, off_t addr, int wordsize) {
+    op->offset = (uint32_t)(addr - AES_BASE_ADDR);
+    op->op = AES_BATCH_READ;
+    op->value = 0;
+    op->width = wordsize;
+}
+
+void batch_write(struct aes_batch_op *op, off_t addr, int wordsize, uint64_t data) {
+    op->offset = (uint32_t)(addr - AES_BASE_ADDR);
+    op->op = AES_BATCH_WRITE;
+    op->value = data;
+    op->width = wordsize;
+}
+
+void batch_poll(struct aes_batch_op *op, off_t addr, uint32_t timeout_us) {
+    op->offset = (uint32_t)(addr - AES_BASE_ADDR);
+    op->op = AES_BATCH_POLL;
+    op->value = timeout_us;
+    op->width = 32;
+}
+
+int user_batch(struct aes_batch_op *ops, unsigned int count) {
+    struct aes_batch batch;
+
+    if (ensure_device_open() < 0) {
+        return -1;
+    }
+
+    batch.ops = (uint64_t)(uintptr_t)ops;
+    batch.count = count;
+    batch.completed = 0;
+
+    // All operations run in one ioctl, completed tells how far a failing batch got
+    if (ioctl(aes_fd, AES_IOC_BATCH, &batch) < 0) {
+        perror("ioctl batch failed");
+        return (int)batch.completed;
+    }
+
+    return (int)batch.completed;
+}
+
+void aes_gcm_prep(struct aes_gcm_run *run, uint32_t handle, const uint8_t *key,
+                  unsigned int mode, const uint8_t *iv,
+                  const uint8_t *aad, uint32_t aad_len,
+                  const uint8_t *in, uint8_t *out, uint32_t data_len, const uint8_t *tag) {
+    memset(run, 0, sizeof(*run));
+    if (handle) {
+        run->key_handle = handle;
+    } else if (key) {
+        memcpy(run->key, key, sizeof(run->key));
+    } else {
+        run->flags |= AES_GCM_KEEP_KEY;
+    }
+    memcpy(run->iv, iv, sizeof(run->iv));
+    if (mode == AES_MODE_DECRYPT && tag) {
+        memcpy(run->tag, tag, sizeof(run->tag));
+    }
+    run->mode = mode;
+    run->aad = (uint64_t)(uintptr_t)aad;
+    run->aad_len = aad_len;
+    run->in = (uint64_t)(uintptr_t)in;
+    run->out = (uint64_t)(uintptr_t)out;
+    run->data_len = data_len;
+}
+
+// Issue a prepared AES_IOC_GCM_RUN and return the tag
+static int gcm_run(struct aes_gcm_run *run, uint8_t *tag) {
+    // Key, IV, data load, start, completion wait, data and tag read-back in one ioctl
+    if (ioctl(aes_fd, AES_IOC_GCM_RUN, run) < 0) {
+        if (errno != EBADMSG) {
+            perror("ioctl gcm run failed");
+        }
+        return -1;
+    }
+
+    if (tag) {
+        memcpy(tag, run->tag, sizeof(run->tag));
+    }
+    return 0;
+}
+
+int aes_gcm_run(unsigned int mode, const uint8_t *key, const uint8_t *iv,
+                const uint8_t *aad, uint32_t aad_len,
+                const uint8_t *in, uint8_t *out, uint32_t data_len, uint8_t *tag) {
+    struct aes_gcm_run run;
+
+    if (ensure_device_open() < 0) {
+        return -1;
+    }
+
+    aes_gcm_prep(&run, 0, key, mode, iv, aad, aad_len, in, out, data_len, tag);
+    return gcm_run(&run, tag);
+}
+
+int aes_gcm_run_key(uint32_t handle, unsigned int mode, const uint8_t *iv,
+                    const uint8_t *aad, uint32_t aad_len,
+                    const uint8_t *in, uint8_t *out, uint32_t data_len, uint8_t *tag) {
+    struct aes_gcm_run run;
+
+    if (ensure_device_open() < 0) {
+        return -1;
+    }
+
+    aes_gcm_prep(&run, handle, NULL, mode, iv, aad, aad_len, in, out, data_len, tag);
+    return gcm_run(&run, tag);
+}
+
+int aes_key_register(const uint8_t *key) {
+    struct aes_key_reg reg;
+    int ret;
+
+    if (ensure_device_open() < 0) {
+        return -1;
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    memcpy(reg.key, key, sizeof(reg.key));
+    ret = ioctl(aes_fd, AES_IOC_KEY_REGISTER, &reg);
+    memset(&reg.key, 0, sizeof(reg.key));
+    if (ret < 0) {
+        perror("ioctl key register failed");
+        return -1;
+    }
+    return (int)reg.handle;
+}
+
+int aes_key_unregister(uint32_t handle) {
+    if (ensure_device_open() < 0) {
+        return -1;
+    }
+
+    if (ioctl(aes_fd, AES_IOC_KEY_UNREGISTER, &handle) < 0) {
+        perror("ioctl key unregister failed");
+        return -1;
+    }
+    return 0;
+}
+
+int aes_get_key_stats(struct aes_key_stats *stats) {
+    if (ensure_device_open() < 0) {
+        return -1;
+    }
+
+    if (ioctl(aes_fd, AES_IOC_GET_KEY_STATS, stats) < 0) {
+        perror("ioctl get key stats failed");
+        return -1;
+    }
+    return 0;
+}
+
+int aes_buf_register(void *buf, size_t len) {
+    struct aes_buf_reg reg;
+
+    if (ensure_device_open() < 0) {
+        return -1;
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    reg.addr = (uint64_t)(uintptr_t)buf;
+    reg.len = len;
+    if (ioctl(aes_fd, AES_IOC_BUF_REGISTER, &reg) < 0) {
+        perror("ioctl buffer register failed");
+        return -1;
+    }
+    return (int)reg.index;
+}
+
+int aes_buf_unregister(int index) {
+    uint32_t idx = (uint32_t)index;
+
+    if (ensure_device_open() < 0) {
+        return -1;
+    }
+
+    if (ioctl(aes_fd, AES_IOC_BUF_UNREGISTER, &idx) < 0) {
+        perror("ioctl buffer unregister failed");
+        return -1;
+    }
+    return 0;
+}
+
+int aes_gcm_run_fixed(uint32_t handle, unsigned int mode, const uint8_t *iv,
+                      const uint8_t *aad, uint32_t aad_len,
+                      const uint8_t *in, uint8_t *out, uint32_t data_len, uint8_t *tag) {
+    struct aes_gcm_run run;
+
+    if (ensure_device_open() < 0) {
+        return -1;
+    }
+
+    aes_gcm_prep(&run, handle, NULL, mode, iv, aad, aad_len, in, out, data_len, tag);
+    run.flags |= AES_GCM_FIXED_BUF;
+    return gcm_run(&run, tag);
+}
+
+int aes_read_stats(struct aes_stats_snapshot *snap) {
+#ifdef KR260_SIM
+    return kr260_sim_read_stats(snap);
+#else
+    struct aes_stats_snapshot core;
+    char path[64];
+    int n, found = 0;
+    FILE *f;
+
+    memset(snap, 0, sizeof(*snap));
+    snap->version = AES_STATS_VERSION;
+    snap->size = sizeof(*snap);
+    for (n = 0; n < aes_device_count(); n++) {
+        snprintf(path, sizeof(path), "/sys/class/aes256gcm10g25g/aes256gcm%d/stats", n);
+        f = fopen(path, "rb");
+        if (!f) {
+            continue;
+        }
+        if (fread(&core, sizeof(core), 1, f) == 1 && core.version == AES_STATS_VERSION &&
+            core.size == sizeof(core)) {
+            for (int i = 0; i < AES_STAT_NR; i++) snap->stat[i] += core.stat[i];
+            for (int i = 0; i < AES_HIST_NR; i++) {
+                for (int b = 0; b < AES_HIST_BUCKETS; b++) snap->hist[i][b] += core.hist[i][b];
+            }
+            found++;
+        }
+        fclose(f);
+    }
+    return found ? 0 : -1;
+#endif
+}
+
+// Pause between polls of the shared ring indices
+static inline void ring_relax(void) {
+#if defined(KR260_SIM)
+    sched_yield();
+#elif defined(__aarch64__)
+    __asm__ volatile("yield" ::: "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+    __asm__ volatile("pause" ::: "memory");
+#endif
+}
+
+int aes_ring_setup(struct aes_ring *ring, uint32_t entries, uint32_t data_size) {
+    struct aes_ring_setup setup;
+    void *mem;
+
+    if (ensure_device_open() < 0) {
+        return -1;
+    }
+
+    memset(&setup, 0, sizeof(setup));
+    setup.entries = entries;
+    setup.data_size = data_size;
+    if (ioctl(aes_fd, AES_IOC_RING_SETUP, &setup) < 0) {
+        perror("ioctl ring setup failed");
+        return -1;
+    }
+
+#ifdef KR260_SIM
+    mem = kr260_sim_ring_map(setup.size);
+#else
+    mem = mmap(NULL, setup.size, PROT_READ | PROT_WRITE, MAP_SHARED, aes_fd, AES_RING_MMAP_OFFSET);
+#endif
+    if (mem == MAP_FAILED) {
+        perror("mmap ring failed");
+        return -1;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    ring->mem = mem;
+    ring->size = setup.size;
+    ring->hdr = (struct aes_ring_hdr *)mem;
+    ring->sq = (struct aes_sqe *)((uint8_t *)mem + setup.sq_off);
+    ring->cq = (struct aes_cqe *)((uint8_t *)mem + setup.cq_off);
+    ring->data = (uint8_t *)mem + setup.data_off;
+    ring->data_size = setup.data_size;
+    ring->mask = entries - 1;
+    ring->sq_tail = ring->hdr->sq_tail;
+    return 0;
+}
+
+struct aes_sqe *aes_ring_get_sqe(struct aes_ring *ring) {
+    uint32_t head = __atomic_load_n(&ring->hdr->sq_head, __ATOMIC_ACQUIRE);
+
+    if (ring->sq_tail - head > ring->mask) {
+        return NULL;
+    }
+    return &ring->sq[ring->sq_tail++ & ring->mask];
+}
+
+int aes_ring_submit(struct aes_ring *ring) {
+    __atomic_store_n(&ring->hdr->sq_tail, ring->sq_tail, __ATOMIC_RELEASE);
+
+    // Pairs with the barrier between setting AES_RING_NEED_WAKEUP and the last SQ check in the driver
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!(__atomic_load_n(&ring->hdr->flags, __ATOMIC_RELAXED) & AES_RING_NEED_WAKEUP)) {
+        return 0;
+    }
+
+    if (ioctl(aes_fd, AES_IOC_RING_ENTER, 0) < 0) {
+        perror("ioctl ring enter failed");
+        return -1;
+    }
+    return 1;
+}
+
+struct aes_cqe *aes_ring_peek_cqe(struct aes_ring *ring) {
+    uint32_t head = ring->hdr->cq_head;
+
+    if (__atomic_load_n(&ring->hdr->cq_tail, __ATOMIC_ACQUIRE) == head) {
+        return NULL;
+    }
+    return &ring->cq[head & ring->mask];
+}
+
+void aes_ring_cqe_seen(struct aes_ring *ring) {
+    __atomic_store_n(&ring->hdr->cq_head, ring->hdr->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+struct aes_cqe *aes_ring_wait_cqe(struct aes_ring *ring) {
+    struct aes_cqe *cqe;
+    unsigned int spins;
+
+    for (spins = 0; ; spins++) {
+        cqe = aes_ring_peek_cqe(ring);
+        if (cqe) {
+            return cqe;
+        }
+
+        // A worker that stopped on a full CQ needs the doorbell once entries were reaped
+        if (__atomic_load_n(&ring->hdr->sq_head, __ATOMIC_ACQUIRE) != ring->hdr->sq_tail &&
+            aes_ring_submit(ring) < 0) {
+            return NULL;
+        }
+
+#ifndef KR260_SIM
+        if (spins >= AES_RING_WAIT_SPINS) {
+            struct pollfd pfd = { .fd = aes_fd, .events = POLLIN };
+
+            // Readable once the driver posted a CQE
+            if (poll(&pfd, 1, 1000) < 0 && errno != EINTR) {
+                perror("poll ring failed");
+                return NULL;
+            }
+            continue;
+        }
+#endif
+        ring_relax();
+    }
+}
+
+void aes_ring_unmap(struct aes_ring *ring) {
+#ifndef KR260_SIM
+    if (ring->mem) {
+        munmap(ring->mem, ring->size);
+    }
+#endif
+    memset(ring, 0, sizeof(*ring));
+}
+
+int aes_wait_idle(uint32_t timeout_us) {
+    if (ensure_device_open() < 0) {
+        return -1;
+    }
+
+    // The driver sleeps on the done interrupt (or its own paced poll) instead of spinning here
+    if (ioctl(aes_fd, AES_IOC_WAIT, (unsigned long)timeout_us) < 0) {
+        perror("ioctl wait failed");
+        return -1;
+    }
+    return 0;
+}
+
+int aes_device_count(void) {
+#ifdef KR260_SIM
+    return 1;
+#else
+    char path[32];
+    int n;
+
+    // Instances are numbered in probe order from 0
+    for (n = 0; n < 64; n++) {
+        snprintf(path, sizeof(path), "/dev/aes256gcm%d", n);
+        if (access(path, F_OK) != 0) {
+            break;
+        }
+    }
+    return n;
+#endif
+}
+
+int aes_device_fd(void) {
+    if (ensure_device_open() < 0) {
+        return -1;
+    }
+    return aes_fd;
+}
+
+int aes_set_wait_mode(uint32_t mode) {
+    if (ensure_device_open() < 0) {
+        return -1;
+    }
+
+    // Applies to GCM_RUN, AES_IOC_WAIT and DATAINCNT polls in batches on this file
+    if (ioctl(aes_fd, AES_IOC_SET_WAIT_MODE, &mode) < 0) {
+        perror("ioctl set wait mode failed");
+        return -1;
+    }
+    return 0;
+}
+
+int aes_get_wait_stats(struct aes_wait_stats *stats) {
+    if (ensure_device_open() < 0) {
+        return -1;
+    }
+
+    if (ioctl(aes_fd, AES_IOC_GET_WAIT_STATS, stats) < 0) {
+        perror("ioctl get wait stats failed");
+        return -1;
+    }
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <termios.h>
@@ -17,6 +18,55 @@
 #define AES_IOC_MAGIC 'a'
 #define AES_IOC_READ_REG   _IOR(AES_IOC_MAGIC, 1, struct aes_reg_data)
 #define AES_IOC_WRITE_REG  _IOW(AES_IOC_MAGIC, 2, struct aes_reg_data)
+#define AES_IOC_BATCH      _IOWR(AES_IOC_MAGIC, 3, struct aes_batch)
+#define AES_IOC_GCM_RUN    _IOWR(AES_IOC_MAGIC, 4, struct aes_gcm_run)
+#define AES_IOC_WAIT       _IO(AES_IOC_MAGIC, 5)    /* Timeout in us passed by value */
+#define AES_IOC_SET_WAIT_MODE   _IOW(AES_IOC_MAGIC, 6, uint32_t)
+#define AES_IOC_GET_WAIT_STATS  _IOR(AES_IOC_MAGIC, 7, struct aes_wait_stats)
+#define AES_IOC_KEY_REGISTER    _IOWR(AES_IOC_MAGIC, 8, struct aes_key_reg)
+#define AES_IOC_KEY_UNREGISTER  _IOW(AES_IOC_MAGIC, 9, uint32_t)
+#define AES_IOC_GET_KEY_STATS   _IOR(AES_IOC_MAGIC, 10, struct aes_key_stats)
+#define AES_IOC_RING_SETUP      _IOWR(AES_IOC_MAGIC, 11, struct aes_ring_setup)
+#define AES_IOC_RING_ENTER      _IO(AES_IOC_MAGIC, 12)
+#define AES_IOC_READ_RANGE      _IOW(AES_IOC_MAGIC, 13, struct aes_range)
+#define AES_IOC_WRITE_RANGE     _IOW(AES_IOC_MAGIC, 14, struct aes_range)
+#define AES_IOC_BUF_REGISTER    _IOWR(AES_IOC_MAGIC, 15, struct aes_buf_reg)
+#define AES_IOC_BUF_UNREGISTER  _IOW(AES_IOC_MAGIC, 16, uint32_t)
+
+/* Batch operation types */
+#define AES_BATCH_READ      0   /* Read register into value */
+#define AES_BATCH_WRITE     1   /* Write value to register */
+#define AES_BATCH_POLL      2   /* Read register until it is zero, value = timeout in us (0 = default) */
+#define AES_BATCH_MAX_OPS   256
+
+/* Operation modes for AES_IOC_GCM_RUN */
+#define AES_MODE_ENCRYPT    0
+#define AES_MODE_DECRYPT    1
+#define AES_MODE_BYPASS     2
+
+/* Completion wait modes */
+#define AES_WAIT_IRQ        0   /* Sleep until the done interrupt (or the kernel poll timer) */
+#define AES_WAIT_SPIN       1   /* Spin on DATAINCNT */
+#define AES_WAIT_HYBRID     2   /* Sleep for most of the predicted time, then spin */
+
+/* Flags for AES_IOC_GCM_RUN */
+#define AES_GCM_KEEP_KEY    (1 << 0)    /* Skip KEYIN programming, reuse the loaded key (ESTALE if the kernel replaced it) */
+#define AES_GCM_FIXED_BUF   (1 << 1)    /* aad, in and out lie in one buffer of aes_buf_register */
+
+/* Registered buffers, pinned by the driver until unregistered or the device is closed */
+#define AES_UBUF_MAX        16
+#define AES_UBUF_MAX_SIZE   (64 << 20)
+
+/* Device statistics, /sys/class/aes256gcm10g25g/aes256gcmN/stats */
+#define AES_STATS_VERSION   3
+#define AES_HIST_BUCKETS    32
+#define AES_HIST_NR         2   /* Operation latency, register access latency */
+
+/* Submission/completion rings, mapped with mmap at AES_RING_MMAP_OFFSET */
+#define AES_RING_MMAP_OFFSET    0x10000000
+#define AES_RING_MAX_ENTRIES    4096
+#define AES_RING_MAX_DATA       (64 << 20)
+#define AES_RING_NEED_WAKEUP    (1 << 0)    /* Worker is idle, AES_IOC_RING_ENTER starts it */
 
 /* Structure for register access */
 struct aes_reg_data {
@@ -25,6 +75,165 @@ struct aes_reg_data {
     uint8_t width;      /* Access width in bits: 8, 16, 32, 64 */
 };
 
+/* One entry of a batch */
+struct aes_batch_op {
+    uint32_t offset;    /* Register offset */
+    uint32_t op;        /* AES_BATCH_READ, AES_BATCH_WRITE or AES_BATCH_POLL */
+    uint64_t value;     /* Value to write, value read or poll timeout */
+    uint8_t width;      /* Access width in bits: 8, 16, 32, 64 */
+};
+
+/* Batch of register operations executed by one ioctl */
+struct aes_batch {
+    uint64_t ops;       /* User pointer to an array of struct aes_batch_op */
+    uint32_t count;     /* Number of operations in the array */
+    uint32_t completed; /* Number of operations completed, set by the driver */
+};
+
+/* Bulk copy between user memory and the window (AES_IOC_READ_RANGE/WRITE_RANGE) */
+struct aes_range {
+    uint32_t offset;    /* Window offset */
+    uint32_t length;    /* Bytes to copy */
+    uint64_t buf;       /* User pointer */
+};
+
+/* Completion wait counters */
+struct aes_wait_stats {
+    uint64_t waits;         /* Completion waits */
+    uint64_t sleeps;        /* Waits that slept (IRQ mode, or hybrid before spinning) */
+    uint64_t spin_iters;    /* DATAINCNT polls spent spinning */
+    uint64_t spins_saved;   /* Estimated polls avoided by hybrid sleeps */
+    uint64_t predicted_ns;  /* Sum of predicted operation times */
+    uint64_t actual_ns;     /* Sum of observed operation times (spin and hybrid) */
+};
+
+/* Whole AES-GCM operation executed by one ioctl */
+struct aes_gcm_run {
+    uint8_t key[32];    /* AES-256 key, first byte is the most significant byte of KEYIN_7 */
+    uint8_t iv[12];     /* 96-bit IV, first byte is the most significant byte of IVIN_2 */
+    uint32_t mode;      /* AES_MODE_ENCRYPT, AES_MODE_DECRYPT or AES_MODE_BYPASS */
+    uint8_t tag[16];    /* Tag out for encrypt, expected tag in for decrypt */
+    uint32_t flags;     /* AES_GCM_* flags */
+    uint32_t aad_len;   /* AAD length in bytes */
+    uint32_t data_len;  /* Payload length in bytes */
+    uint32_t key_handle;/* Registered key to use instead of key, 0 = none */
+    uint64_t aad;       /* User pointer to AAD */
+    uint64_t in;        /* User pointer to input payload */
+    uint64_t out;       /* User pointer to output payload */
+};
+
+/*
+ * Command area of an io_uring IORING_OP_URING_CMD SQE (fd = aes_device_fd(), cmd_op =
+ * AES_IOC_GCM_RUN). The aes_gcm_run and its input are read when the SQE is issued, the
+ * output and tag are written before the CQE, whose res is data_len or a negative errno.
+ */
+struct aes_uring_gcm {
+    uint64_t run;       /* Pointer to struct aes_gcm_run, must stay valid until the CQE */
+    uint64_t reserved;  /* Must be zero */
+};
+
+/* User buffer to pin for AES_GCM_FIXED_BUF operations */
+struct aes_buf_reg {
+    uint64_t addr;      /* Address of the buffer */
+    uint64_t len;       /* Bytes, up to AES_UBUF_MAX_SIZE */
+    uint32_t index;     /* Set by the driver, for AES_IOC_BUF_UNREGISTER */
+    uint32_t reserved;  /* Must be zero */
+};
+
+/* Counters of struct aes_stats_snapshot */
+enum aes_stat {
+    AES_STAT_OPS_ENCRYPT,   /* Operations started, indexed by AES_MODE_* */
+    AES_STAT_OPS_DECRYPT,
+    AES_STAT_OPS_BYPASS,
+    AES_STAT_AAD_BYTES,
+    AES_STAT_DATA_BYTES,
+    AES_STAT_IOCTLS,
+    AES_STAT_SPIN_ITERS,    /* DATAINCNT polls spent spinning */
+    AES_STAT_TIMEOUTS,
+    AES_STAT_KEY_LOADS,     /* Operations that programmed KEYIN */
+    AES_STAT_COPY_BYTES,    /* Operation data moved by CPU copies, once per copy of a byte */
+    AES_STAT_DMA_BYTES,     /* Operation data moved between memory and the windows by DMA */
+    AES_STAT_NR
+};
+
+/* Contents of the sysfs "stats" attribute of one core */
+struct aes_stats_snapshot {
+    uint32_t version;       /* AES_STATS_VERSION */
+    uint32_t size;          /* sizeof(struct aes_stats_snapshot) */
+    uint64_t stat[AES_STAT_NR];
+    uint64_t hist[AES_HIST_NR][AES_HIST_BUCKETS];
+};
+
+/* Key registration, the handle is returned by the driver */
+struct aes_key_reg {
+    uint8_t key[32];    /* AES-256 key, same byte order as aes_gcm_run.key */
+    uint32_t handle;    /* Handle for aes_gcm_run.key_handle, set by the driver */
+    uint32_t reserved;  /* Must be zero */
+};
+
+/* Key cache counters of the device */
+struct aes_key_stats {
+    uint64_t hits;      /* Operations that found their key already in KEYIN */
+    uint64_t misses;    /* Operations that had to program KEYIN */
+    uint32_t registered;/* Keys in the table */
+    uint32_t loaded;    /* Handle of the key in KEYIN, 0 = none or unknown */
+};
+
+/* Ring geometry: entries and data_size are set by user space, the offsets by the driver */
+struct aes_ring_setup {
+    uint32_t entries;   /* SQ and CQ entries, power of two up to AES_RING_MAX_ENTRIES */
+    uint32_t data_size; /* Bytes of the shared data area, up to AES_RING_MAX_DATA */
+    uint32_t sq_off;    /* Offset of the SQE array in the mapping */
+    uint32_t cq_off;    /* Offset of the CQE array */
+    uint32_t data_off;  /* Offset of the data area */
+    uint32_t size;      /* Bytes to mmap at AES_RING_MMAP_OFFSET */
+};
+
+/* Ring indices at the start of the mapping, free running, masked with entries - 1 */
+struct aes_ring_hdr {
+    uint32_t sq_head;   /* Next SQE the driver takes */
+    uint32_t sq_tail;   /* Next SQE user space fills */
+    uint32_t cq_head;   /* Next CQE user space reads */
+    uint32_t cq_tail;   /* Next CQE the driver fills */
+    uint32_t entries;   /* SQ and CQ size */
+    uint32_t flags;     /* AES_RING_* flags, set by the driver */
+};
+
+/* Submission queue entry, buffers are offsets into the data area */
+struct aes_sqe {
+    uint64_t user_data; /* Returned in the CQE */
+    uint32_t key_handle;/* Registered key (aes_key_register) */
+    uint32_t mode;      /* AES_MODE_ENCRYPT, AES_MODE_DECRYPT or AES_MODE_BYPASS */
+    uint8_t iv[12];     /* 96-bit IV, same byte order as aes_gcm_run.iv */
+    uint32_t aad_off;   /* AAD */
+    uint32_t aad_len;
+    uint32_t in_off;    /* Input payload */
+    uint32_t out_off;   /* Output payload, may equal in_off */
+    uint32_t data_len;
+    uint8_t tag[16];    /* Expected tag for decrypt */
+};
+
+/* Completion queue entry */
+struct aes_cqe {
+    uint64_t user_data; /* From the SQE */
+    int32_t status;     /* 0 or a negative errno, -EBADMSG when the tag does not match */
+    uint32_t reserved;
+    uint8_t tag[16];    /* Tag of the operation */
+};
+
+/* Rings of this process as mapped by aes_ring_setup */
+struct aes_ring {
+    struct aes_ring_hdr *hdr;
+    struct aes_sqe *sq;
+    struct aes_cqe *cq;
+    uint8_t *data;      /* Shared data area, SQE offsets are relative to it */
+    uint32_t data_size;
+    uint32_t mask;      /* entries - 1 */
+    uint32_t sq_tail;   /* Entries handed out by aes_ring_get_sqe, published by aes_ring_submit */
+    void *mem;          /* Whole mapping */
+    size_t size;
+};
+
 // Function to read a single character from keyboard without echoing it
 int getch(void);
 
@@ -34,6 +243,98 @@ uint64_t user_read(off_t addr, int wordsize);
 // Function to write to a hardware register using ioctl
 uint64_t user_write(off_t addr, int wordsize, uint64_t data);
 
+// Copy len bytes from the AES window at addr into buf
+int read_block(off_t addr, void *buf, size_t len);
+
+// Copy len bytes from buf into the AES window at addr, zero_padding=1 fills up to the next 16-byte boundary
+int write_block(off_t addr, const void *buf, size_t len, int zero_padding);
+
+// Fill one batch entry, addr is a physical address as for user_read/user_write
+void batch_read(struct aes_batch_op *op, off_t addr, int wordsize);
+void batch_write(struct aes_batch_op *op, off_t addr, int wordsize, uint64_t data);
+void batch_poll(struct aes_batch_op *op, off_t addr, uint32_t timeout_us);
+
+// Run count operations back to back with one call. Return the number of operations completed, or -1
+int user_batch(struct aes_batch_op *ops, unsigned int count);
+
+// Run a whole AES-GCM operation with one call. key=NULL reuses the loaded key, tag is output for
+// encrypt and expected tag for decrypt. Return 0, or -1 with errno=EBADMSG when the tag does not match
+int aes_gcm_run(unsigned int mode, const uint8_t *key, const uint8_t *iv,
+                const uint8_t *aad, uint32_t aad_len,
+                const uint8_t *in, uint8_t *out, uint32_t data_len, uint8_t *tag);
+
+// Fill run for asynchronous submission (struct aes_uring_gcm) without issuing it. handle=0 takes
+// key, key=NULL as well reuses the loaded key. tag is the expected tag for decrypt
+void aes_gcm_prep(struct aes_gcm_run *run, uint32_t handle, const uint8_t *key,
+                  unsigned int mode, const uint8_t *iv,
+                  const uint8_t *aad, uint32_t aad_len,
+                  const uint8_t *in, uint8_t *out, uint32_t data_len, const uint8_t *tag);
+
+// Register a key with the driver for the lifetime of this process. Return a handle, or -1
+int aes_key_register(const uint8_t *key);
+
+// Drop a registered key. Return 0 or -1
+int aes_key_unregister(uint32_t handle);
+
+// aes_gcm_run with a registered key: KEYIN is only programmed when another key was used since
+int aes_gcm_run_key(uint32_t handle, unsigned int mode, const uint8_t *iv,
+                    const uint8_t *aad, uint32_t aad_len,
+                    const uint8_t *in, uint8_t *out, uint32_t data_len, uint8_t *tag);
+
+// Read the key cache counters. Return 0 or -1
+int aes_get_key_stats(struct aes_key_stats *stats);
+
+// Pin buf for AES_GCM_FIXED_BUF operations, steady-state operations then walk no page tables
+// and copy once between the buffer and the IP. Return the buffer index or -1
+int aes_buf_register(void *buf, size_t len);
+
+// Unpin a buffer of aes_buf_register. Return 0 or -1
+int aes_buf_unregister(int index);
+
+// aes_gcm_run_key with aad, in and out inside one registered buffer
+int aes_gcm_run_fixed(uint32_t handle, unsigned int mode, const uint8_t *iv,
+                      const uint8_t *aad, uint32_t aad_len,
+                      const uint8_t *in, uint8_t *out, uint32_t data_len, uint8_t *tag);
+
+// Device counters summed over all cores (the simulator counts AES_IOC_GCM_RUN only). Return 0 or -1
+int aes_read_stats(struct aes_stats_snapshot *snap);
+
+// Create and map the rings of this process: entries SQEs/CQEs and data_size bytes of shared
+// data. The driver keeps them until close_device. Return 0 or -1
+int aes_ring_setup(struct aes_ring *ring, uint32_t entries, uint32_t data_size);
+
+// Next free SQE to fill, or NULL when the SQ is full. Entries are only seen after aes_ring_submit
+struct aes_sqe *aes_ring_get_sqe(struct aes_ring *ring);
+
+// Publish the filled SQEs, the doorbell ioctl is only made when the driver worker is idle.
+// Return 1 when a system call was made, 0 when not, -1 on error
+int aes_ring_submit(struct aes_ring *ring);
+
+// Oldest unread CQE, or NULL. Release it with aes_ring_cqe_seen
+struct aes_cqe *aes_ring_peek_cqe(struct aes_ring *ring);
+void aes_ring_cqe_seen(struct aes_ring *ring);
+
+// Wait for a CQE: spin briefly, then sleep in poll(). Return it, or NULL on error
+struct aes_cqe *aes_ring_wait_cqe(struct aes_ring *ring);
+
+// Unmap the rings
+void aes_ring_unmap(struct aes_ring *ring);
+
+// Sleep until the device is idle, timeout_us=0 uses the driver default. Return 0, or -1 on timeout
+int aes_wait_idle(uint32_t timeout_us);
+
+// Number of AES cores, /dev/aes256gcm0../dev/aes256gcmN-1 (the aggregate spreads work over them)
+int aes_device_count(void);
+
+// File descriptor of the device for poll/epoll (readable when idle, or with rings when a CQE is ready), or -1
+int aes_device_fd(void);
+
+// Select how completion is awaited: AES_WAIT_IRQ, AES_WAIT_SPIN or AES_WAIT_HYBRID. Return 0 or -1
+int aes_set_wait_mode(uint32_t mode);
+
+// Read the completion wait counters. Return 0 or -1
+int aes_get_wait_stats(struct aes_wait_stats *stats);
+
 // Function to close the device when done
 void close_device(void);
 
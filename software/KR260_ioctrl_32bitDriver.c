@@ -1,4 +1,4 @@
-#include "KR260_ioctl.h"
+#include "KR260_ioctrl_32bitDriver.h"
 
 #define AES_BASE_ADDR 0xA0000000
 
@@ -148,4 +148,110 @@ void close_device(void) {
         close(aes_fd);
         aes_fd = -1;
     }
-}
\ No newline at end of file
+}
+
+// Check that [addr, addr+len) lies in the AES window and open the device
+static int block_prepare(off_t addr, size_t len) {
+    if (addr < AES_BASE_ADDR || addr + len > (AES_BASE_ADDR + 0x10000)) {
+        fprintf(stderr, "Error: Block 0x%lx+0x%zx is outside AES device range (0x%x-0x%x)\n",
+                (unsigned long)addr, len, AES_BASE_ADDR, AES_BASE_ADDR + 0xFFFF);
+        return -1;
+    }
+    return ensure_device_open();
+}
+
+// Bulk copy on an already opened device, offset relative to AES_BASE_ADDR
+static int range_access(unsigned long cmd, uint32_t offset, const void *buf, size_t len) {
+    struct aes_range range;
+
+    range.offset = offset;
+    range.length = (uint32_t)len;
+    range.buf = (uint64_t)(uintptr_t)buf;
+
+    if (ioctl(aes_fd, cmd, &range) < 0) {
+        perror(cmd == AES_IOC_READ_RANGE ? "ioctl range read failed" : "ioctl range write failed");
+        return -1;
+    }
+    return 0;
+}
+
+// Copy len bytes from the AES window into buf with one ioctl
+int read_block(off_t addr, void *buf, size_t len) {
+    if (block_prepare(addr, len) < 0) {
+        return -1;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    return range_access(AES_IOC_READ_RANGE, (uint32_t)(addr - AES_BASE_ADDR), buf, len);
+}
+
+// Copy len bytes from buf into the AES window, zero_padding=1 fills up to the next 16-byte boundary
+int write_block(off_t addr, const void *buf, size_t len, int zero_padding) {
+    static const uint8_t zeros[16];
+    uint32_t offset = (uint32_t)(addr - AES_BASE_ADDR);
+    size_t pad = 0;
+
+    if (zero_padding) {
+        pad = ((offset + len + 15) & ~(size_t)15) - (offset + len);
+    }
+    if (block_prepare(addr, len + pad) < 0) {
+        return -1;
+    }
+
+    if (len > 0 && range_access(AES_IOC_WRITE_RANGE, offset, buf, len) < 0) {
+        return -1;
+    }
+    if (pad > 0 && range_access(AES_IOC_WRITE_RANGE, offset + (uint32_t)len, zeros, pad) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+void batch_read(struct aes_batch_op *op, off_t addr, int wordsize) {
+    op->offset = (uint32_t)(addr - AES_BASE_ADDR);
+    op->op = AES_BATCH_READ;
+    op->value = 0;
+    (void)wordsize;  // the 32-bit driver always uses 32-bit access
+}
+
+void batch_write(struct aes_batch_op *op, off_t addr, int wordsize, uint64_t data) {
+    op->offset = (uint32_t)(addr - AES_BASE_ADDR);
+    op->op = AES_BATCH_WRITE;
+    op->value = data;
+    (void)wordsize;  // the 32-bit driver always uses 32-bit access
+}
+
+void batch_poll(struct aes_batch_op *op, off_t addr, uint32_t timeout_us) {
+    op->offset = (uint32_t)(addr - AES_BASE_ADDR);
+    op->op = AES_BATCH_POLL;
+    op->value = timeout_us;
+}
+
+int user_batch(struct aes_batch_op *ops, unsigned int count) {
+    struct aes_batch batch;
+
+    if (ensure_device_open() < 0) {
+        return -1;
+    }
+
+    batch.ops = (uint64_t)(uintptr_t)ops;
+    batch.count = count;
+    batch.completed = 0;
+
+    // All operations run in one ioctl, completed tells how far a failing batch got
+    if (ioctl(aes_fd, AES_IOC_BATCH, &batch) < 0) {
+        perror("ioctl batch failed");
+        return (int)batch.completed;
+    }
+
+    return (int)batch.completed;
+}
+
+int aes_wait_idle(uint32_t timeout_us) {
+    struct aes_batch_op op;
+
+    // The 32-bit driver has no wait ioctl, poll DATAINCNT inside one batch instead
+    batch_poll(&op, AES_BASE_ADDR + 0x0C, timeout_us);
+    return (user_batch(&op, 1) == 1) ? 0 : -1;
+}
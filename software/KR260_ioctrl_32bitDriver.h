@@ -4,6 +4,7 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <termios.h>
@@ -17,6 +18,15 @@
 #define AES_IOC_MAGIC 'a'
 #define AES_IOC_READ_REG   _IOR(AES_IOC_MAGIC, 1, struct aes_reg_data)
 #define AES_IOC_WRITE_REG  _IOW(AES_IOC_MAGIC, 2, struct aes_reg_data)
+#define AES_IOC_BATCH      _IOWR(AES_IOC_MAGIC, 3, struct aes_batch)
+#define AES_IOC_READ_RANGE  _IOW(AES_IOC_MAGIC, 13, struct aes_range)
+#define AES_IOC_WRITE_RANGE _IOW(AES_IOC_MAGIC, 14, struct aes_range)
+
+/* Batch operation types */
+#define AES_BATCH_READ      0   /* Read register into value */
+#define AES_BATCH_WRITE     1   /* Write value to register */
+#define AES_BATCH_POLL      2   /* Read register until it is zero, value = timeout in us (0 = default) */
+#define AES_BATCH_MAX_OPS   256
 
 /* Structure for register access */
 struct aes_reg_data {
@@ -24,6 +34,27 @@ struct aes_reg_data {
     uint32_t value;     /* Value to read or write */
 };
 
+/* One entry of a batch */
+struct aes_batch_op {
+    uint32_t offset;    /* Register offset */
+    uint32_t op;        /* AES_BATCH_READ, AES_BATCH_WRITE or AES_BATCH_POLL */
+    uint32_t value;     /* Value to write, value read or poll timeout */
+};
+
+/* Batch of register operations executed by one ioctl */
+struct aes_batch {
+    uint64_t ops;       /* User pointer to an array of struct aes_batch_op */
+    uint32_t count;     /* Number of operations in the array */
+    uint32_t completed; /* Number of operations completed, set by the driver */
+};
+
+/* Bulk copy between user memory and the window (AES_IOC_READ_RANGE/WRITE_RANGE) */
+struct aes_range {
+    uint32_t offset;    /* Window offset */
+    uint32_t length;    /* Bytes to copy */
+    uint64_t buf;       /* User pointer */
+};
+
 // Function to read a single character from keyboard without echoing it
 int getch(void);
 
@@ -33,6 +64,23 @@ uint64_t user_read(off_t addr, int wordsize);
 // Function to write to a hardware register using ioctl
 uint64_t user_write(off_t addr, int wordsize, uint64_t data);
 
+// Copy len bytes from the AES window at addr into buf
+int read_block(off_t addr, void *buf, size_t len);
+
+// Copy len bytes from buf into the AES window at addr, zero_padding=1 fills up to the next 16-byte boundary
+int write_block(off_t addr, const void *buf, size_t len, int zero_padding);
+
+// Fill one batch entry, addr is a physical address as for user_read/user_write
+void batch_read(struct aes_batch_op *op, off_t addr, int wordsize);
+void batch_write(struct aes_batch_op *op, off_t addr, int wordsize, uint64_t data);
+void batch_poll(struct aes_batch_op *op, off_t addr, uint32_t timeout_us);
+
+// Run count operations back to back with one call. Return the number of operations completed, or -1
+int user_batch(struct aes_batch_op *ops, unsigned int count);
+
+// Wait until the device is idle, timeout_us=0 uses the driver default. Return 0, or -1 on timeout
+int aes_wait_idle(uint32_t timeout_us);
+
 // Function to close the device when done
 void close_device(void);
 
@@ -0,0 +1,891 @@
+#include "KR260_sim.h"
+#include "KR260_ioctl.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <openssl/evp.h>
+#include <openssl/crypto.h>
+
+/* Register map of the modelled IP, offsets in the window */
+#define SIM_ADDR_A1_REG     0x00
+#define SIM_ADDR_A2_REG     0x04
+#define SIM_AADINCNT_REG    0x08
+#define SIM_DATAINCNT_REG   0x0C
+#define SIM_VER_REG         0x10
+#define SIM_DECEN_REG       0x14
+#define SIM_BYPASS_REG      0x18
+#define SIM_KEYIN_0_REG     0x20
+#define SIM_IVIN_0_REG      0x40
+#define SIM_TAG_0_REG       0x50
+#define SIM_DATAIN_OFFSET   0x2000
+#define SIM_DATAOUT_OFFSET  0x4000
+#define SIM_WINDOW_SIZE     0x10000
+#define SIM_DATA_SIZE       2048    /* BRAM behind DATAIN and DATAOUT, ADDR_A1/ADDR_A2 offsets included */
+
+#define SIM_IDLE_SPIN_NS    10000000    /* Spin this long after an operation, then poll every 50 us */
+#define SIM_TIMEOUT_US      1000000
+#define SIM_KEY_MAX         16384       /* Registered keys, as the driver */
+#define SIM_RING_IDLE_NS    50000       /* Ring worker polls an empty SQ this long, as ring_idle_us */
+
+static struct {
+    pthread_mutex_t   lock;         /* Protects refs and the thread start/stop */
+    int               refs;
+    pthread_t         thread;
+    volatile int      stop;
+    volatile uint8_t *base;
+    uint32_t          base_ns;
+    uint32_t          ps_per_byte;
+    uint32_t          wait_mode;    /* Accepted for the ioctl API, the model always spins */
+    struct aes_wait_stats stats;
+    uint8_t           bounce[SIM_DATA_SIZE];
+    uint8_t         (*keys)[32];    /* Registered keys, handle = index + 1 */
+    uint8_t          *key_used;
+    uint32_t          key_slots;
+    uint32_t          loaded_key;   /* Handle of the key in KEYIN, 0 = none or unknown */
+    struct aes_key_stats key_stats;
+    struct { uint64_t addr, len; } bufs[AES_UBUF_MAX];  /* Registered buffers, len = 0 when free */
+    uint64_t          stat[AES_STAT_NR];
+    pthread_mutex_t   op_lock;      /* Serialises ioctls and ring entries, as aes->lock */
+    struct {
+        uint8_t            *mem;    /* Header, SQEs, CQEs and data, as the driver lays them out */
+        size_t              size;
+        struct aes_ring_hdr *hdr;
+        struct aes_sqe     *sq;
+        struct aes_cqe     *cq;
+        uint8_t            *data;
+        uint32_t            data_size;
+        uint32_t            mask;
+        uint32_t            sq_head;
+        uint32_t            cq_tail;
+        pthread_t           thread;
+        pthread_mutex_t     lock;   /* Protects kicked and stop */
+        pthread_cond_t      cond;
+        int                 kicked;
+        int                 stop;
+    } ring;
+} sim = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .op_lock = PTHREAD_MUTEX_INITIALIZER,
+    .ring = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER },
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Spin loops give the CPU away, the model and the caller may share a single core
+static inline void cpu_relax(void) {
+    sched_yield();
+}
+
+static inline uint32_t reg_read(uint32_t offset) {
+    return *(volatile uint32_t *)(sim.base + offset);
+}
+
+static inline void reg_write(uint32_t offset, uint32_t value) {
+    *(volatile uint32_t *)(sim.base + offset) = value;
+}
+
+static inline void put_be32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static inline uint32_t get_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// AES-256-GCM encrypt of in into out, tag out. Return 0 or -1
+static int gcm_encrypt(const uint8_t *key, const uint8_t *iv, const uint8_t *aad, int aad_len,
+                       const uint8_t *in, uint8_t *out, int len, uint8_t *tag) {
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    int outl, ok;
+
+    ok = ctx && EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, key, iv) == 1 &&
+         EVP_EncryptUpdate(ctx, NULL, &outl, aad, aad_len) == 1 &&
+         EVP_EncryptUpdate(ctx, out, &outl, in, len) == 1 &&
+         EVP_EncryptFinal_ex(ctx, out + outl, &outl) == 1 &&
+         EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16, tag) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok ? 0 : -1;
+}
+
+/*
+ * One operation as the IP runs it: AADINCNT bytes of AAD at DATAIN+A1 padded to 16, then the
+ * payload; the result goes to DATAOUT+A2 at the same layout and the tag to TAG_0..3.
+ * Decryption reports the tag computed over the ciphertext, the caller compares it.
+ */
+static void sim_execute(uint32_t data_len) {
+    uint8_t in[SIM_DATA_SIZE], out[SIM_DATA_SIZE];
+    uint8_t key[32], iv[12], tag[16], check[SIM_DATA_SIZE];
+    uint32_t a1 = reg_read(SIM_ADDR_A1_REG), a2 = reg_read(SIM_ADDR_A2_REG);
+    uint32_t aad_len = reg_read(SIM_AADINCNT_REG);
+    uint32_t aad_pad = (aad_len + 15) & ~15u;
+    uint32_t total = aad_pad + data_len;
+    int i;
+
+    memset(tag, 0, sizeof(tag));
+    if (aad_len > SIM_DATA_SIZE || data_len > SIM_DATA_SIZE ||
+        a1 > SIM_DATA_SIZE - total || a2 > SIM_DATA_SIZE - total) {
+        return;
+    }
+
+    for (i = 0; i < 8; i++) {
+        put_be32(key + 4 * (7 - i), reg_read(SIM_KEYIN_0_REG + 4 * i));
+    }
+    for (i = 0; i < 3; i++) {
+        put_be32(iv + 4 * (2 - i), reg_read(SIM_IVIN_0_REG + 4 * i));
+    }
+    memcpy(in, (const void *)(sim.base + SIM_DATAIN_OFFSET + a1), total);
+    memcpy(out, in, aad_pad);
+
+    if (reg_read(SIM_BYPASS_REG) & 1) {
+        memcpy(out + aad_pad, in + aad_pad, data_len);
+    } else if (reg_read(SIM_DECEN_REG) & 1) {
+        // CTR is symmetric, the tag is the one the plaintext encrypts to
+        gcm_encrypt(key, iv, in, aad_len, in + aad_pad, out + aad_pad, data_len, tag);
+        gcm_encrypt(key, iv, in, aad_len, out + aad_pad, check, data_len, tag);
+    } else {
+        gcm_encrypt(key, iv, in, aad_len, in + aad_pad, out + aad_pad, data_len, tag);
+    }
+
+    memcpy((void *)(sim.base + SIM_DATAOUT_OFFSET + a2), out, total);
+    for (i = 0; i < 4; i++) {
+        reg_write(SIM_TAG_0_REG + 4 * i, get_be32(tag + 4 * (3 - i)));
+    }
+}
+
+// Model thread: DATAINCNT != 0 starts an operation, writing it back to 0 completes it
+static void *sim_thread(void *arg) {
+    uint64_t idle_since = now_ns(), start, deadline;
+    uint32_t data_len;
+
+    (void)arg;
+    while (!sim.stop) {
+        data_len = reg_read(SIM_DATAINCNT_REG);
+        if (!data_len) {
+            if (now_ns() - idle_since > SIM_IDLE_SPIN_NS) {
+                usleep(50);
+            } else {
+                cpu_relax();
+            }
+            continue;
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        start = now_ns();
+        sim_execute(data_len);
+        deadline = start + sim.base_ns +
+                   ((uint64_t)(reg_read(SIM_AADINCNT_REG) + data_len) * sim.ps_per_byte) / 1000;
+        while (now_ns() < deadline) {
+            cpu_relax();
+        }
+
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        reg_write(SIM_DATAINCNT_REG, 0);
+        idle_since = now_ns();
+    }
+    return NULL;
+}
+
+static uint32_t env_u32(const char *name, uint32_t def) {
+    const char *value = getenv(name);
+
+    return value ? (uint32_t)strtoul(value, NULL, 0) : def;
+}
+
+int kr260_sim_open(void) {
+    void *base;
+    int fd;
+
+    // A real descriptor, so close() and poll() on it behave
+    fd = open("/dev/null", O_RDWR);
+    if (fd < 0) {
+        perror("open /dev/null failed");
+        return -1;
+    }
+
+    pthread_mutex_lock(&sim.lock);
+    if (sim.refs++ == 0) {
+        base = mmap(NULL, SIM_WINDOW_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            perror("mmap failed");
+            goto fail;
+        }
+        sim.base = (volatile uint8_t *)base;
+        sim.base_ns = env_u32("KR260_SIM_BASE_NS", KR260_SIM_BASE_NS);
+        sim.ps_per_byte = env_u32("KR260_SIM_PS_PER_BYTE", KR260_SIM_PS_PER_BYTE);
+        sim.wait_mode = AES_WAIT_IRQ;
+        memset(&sim.stats, 0, sizeof(sim.stats));
+        reg_write(SIM_VER_REG, KR260_SIM_VERSION);
+        sim.stop = 0;
+        if (pthread_create(&sim.thread, NULL, sim_thread, NULL) != 0) {
+            perror("pthread_create failed");
+            munmap(base, SIM_WINDOW_SIZE);
+            sim.base = NULL;
+            goto fail;
+        }
+    }
+    pthread_mutex_unlock(&sim.lock);
+    return fd;
+
+fail:
+    sim.refs--;
+    pthread_mutex_unlock(&sim.lock);
+    close(fd);
+    return -1;
+}
+
+static void sim_ring_free(void);
+
+void kr260_sim_close(int fd) {
+    pthread_mutex_lock(&sim.lock);
+    if (sim.refs > 0 && --sim.refs == 0) {
+        sim_ring_free();
+        sim.stop = 1;
+        pthread_join(sim.thread, NULL);
+        munmap((void *)sim.base, SIM_WINDOW_SIZE);
+        sim.base = NULL;
+        if (sim.keys) {
+            OPENSSL_cleanse(sim.keys, sim.key_slots * sizeof(*sim.keys));
+        }
+        free(sim.keys);
+        free(sim.key_used);
+        sim.keys = NULL;
+        sim.key_used = NULL;
+        sim.key_slots = 0;
+        sim.loaded_key = 0;
+        memset(&sim.key_stats, 0, sizeof(sim.key_stats));
+        memset(sim.bufs, 0, sizeof(sim.bufs));
+    }
+    pthread_mutex_unlock(&sim.lock);
+    close(fd);
+}
+
+volatile uint8_t *kr260_sim_base(void) {
+    return sim.base;
+}
+
+void kr260_sim_set_latency(uint32_t base_ns, uint32_t ps_per_byte) {
+    sim.base_ns = base_ns;
+    sim.ps_per_byte = ps_per_byte;
+}
+
+static uint64_t sim_read(uint32_t offset, uint8_t width) {
+    // Callers poll DATAINCNT in a loop, let the model run while it is busy
+    if (offset == SIM_DATAINCNT_REG && reg_read(offset)) {
+        cpu_relax();
+    }
+    switch (width) {
+        case 8:
+            return *(volatile uint8_t *)(sim.base + offset);
+        case 16:
+            return *(volatile uint16_t *)(sim.base + offset);
+        case 64:
+            return *(volatile uint64_t *)(sim.base + offset);
+        case 32:
+        default:
+            return *(volatile uint32_t *)(sim.base + offset);
+    }
+}
+
+static void sim_write(uint32_t offset, uint8_t width, uint64_t value) {
+    // Data must be visible to the model thread before the start register
+    if (offset == SIM_DATAINCNT_REG) {
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    } else if (offset >= SIM_KEYIN_0_REG && offset < SIM_IVIN_0_REG) {
+        sim.loaded_key = 0;
+    }
+    switch (width) {
+        case 8:
+            *(volatile uint8_t *)(sim.base + offset) = (uint8_t)value;
+            break;
+        case 16:
+            *(volatile uint16_t *)(sim.base + offset) = (uint16_t)value;
+            break;
+        case 64:
+            *(volatile uint64_t *)(sim.base + offset) = value;
+            break;
+        case 32:
+        default:
+            *(volatile uint32_t *)(sim.base + offset) = (uint32_t)value;
+            break;
+    }
+}
+
+// Spin until the register reads zero, as the driver's completion wait
+static int sim_poll(uint32_t offset, uint32_t timeout_us) {
+    uint64_t start = now_ns(), iters = 0;
+    uint64_t timeout_ns = (uint64_t)(timeout_us ? timeout_us : SIM_TIMEOUT_US) * 1000;
+
+    sim.stats.waits++;
+    while (reg_read(offset) != 0) {
+        iters++;
+        if (now_ns() - start > timeout_ns) {
+            sim.stats.spin_iters += iters;
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        cpu_relax();
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    sim.stats.spin_iters += iters;
+    sim.stats.actual_ns += now_ns() - start;
+    return 0;
+}
+
+static int sim_batch(struct aes_batch *batch) {
+    struct aes_batch_op *ops = (struct aes_batch_op *)(uintptr_t)batch->ops;
+    int ret = 0;
+    uint32_t i;
+
+    if (batch->count == 0 || batch->count > AES_BATCH_MAX_OPS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (i = 0; i < batch->count && ret == 0; i++) {
+        struct aes_batch_op *op = &ops[i];
+
+        if (op->offset >= SIM_WINDOW_SIZE) {
+            errno = EINVAL;
+            ret = -1;
+            break;
+        }
+        switch (op->op) {
+            case AES_BATCH_READ:
+                op->value = sim_read(op->offset, op->width);
+                break;
+            case AES_BATCH_WRITE:
+                sim_write(op->offset, op->width, op->value);
+                break;
+            case AES_BATCH_POLL:
+                ret = sim_poll(op->offset, (uint32_t)op->value);
+                op->value = reg_read(op->offset);
+                break;
+            default:
+                errno = EINVAL;
+                ret = -1;
+                break;
+        }
+        if (ret) {
+            break;
+        }
+    }
+    batch->completed = i;
+    return ret;
+}
+
+// [addr, addr + len) lies in a registered buffer
+static int sim_buf_holds(uint64_t addr, uint32_t len) {
+    for (int i = 0; i < AES_UBUF_MAX; i++) {
+        if (sim.bufs[i].len && addr >= sim.bufs[i].addr && len <= sim.bufs[i].len &&
+            addr - sim.bufs[i].addr <= sim.bufs[i].len - len) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Same sequence as the driver's AES_IOC_GCM_RUN, staged through a bounce buffer unless the
+// buffers are registered
+static int sim_gcm_run(struct aes_gcm_run *run) {
+    uint32_t aad_pad = (run->aad_len + 15) & ~15u;
+    int fixed = run->flags & AES_GCM_FIXED_BUF;
+    const uint8_t *key = NULL;
+    uint8_t *datain = (uint8_t *)(sim.base + SIM_DATAIN_OFFSET);
+    uint8_t tag[16];
+    int i;
+
+    if (run->mode > AES_MODE_BYPASS || (run->flags & ~(AES_GCM_KEEP_KEY | AES_GCM_FIXED_BUF)) ||
+        ((run->flags & AES_GCM_KEEP_KEY) && run->key_handle) ||
+        run->aad_len > SIM_DATA_SIZE || run->data_len > SIM_DATA_SIZE - aad_pad) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (fixed && (!sim_buf_holds(run->aad, run->aad_len) || !sim_buf_holds(run->in, run->data_len) ||
+                  !sim_buf_holds(run->out, run->data_len))) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    // KEYIN is only written when another key was used since this one
+    if (run->key_handle) {
+        if (run->key_handle > sim.key_slots || !sim.key_used[run->key_handle - 1]) {
+            errno = ENOENT;
+            return -1;
+        }
+        if (sim.loaded_key == run->key_handle) {
+            sim.key_stats.hits++;
+        } else {
+            key = sim.keys[run->key_handle - 1];
+            sim.key_stats.misses++;
+        }
+    } else if (!(run->flags & AES_GCM_KEEP_KEY)) {
+        key = run->key;
+    }
+
+    if (!fixed) {
+        memset(sim.bounce, 0, aad_pad);
+        memcpy(sim.bounce, (const void *)(uintptr_t)run->aad, run->aad_len);
+        memcpy(sim.bounce + aad_pad, (const void *)(uintptr_t)run->in, run->data_len);
+        sim.stat[AES_STAT_COPY_BYTES] += run->aad_len + run->data_len;
+    }
+
+    if (sim_poll(SIM_DATAINCNT_REG, 0) < 0) {
+        return -1;
+    }
+    if (key) {
+        for (i = 0; i < 8; i++) {
+            reg_write(SIM_KEYIN_0_REG + 4 * i, get_be32(key + 4 * (7 - i)));
+        }
+        sim.loaded_key = run->key_handle;
+    }
+    for (i = 0; i < 3; i++) {
+        reg_write(SIM_IVIN_0_REG + 4 * i, get_be32(run->iv + 4 * (2 - i)));
+    }
+    if (fixed) {
+        memcpy(datain, (const void *)(uintptr_t)run->aad, run->aad_len);
+        memset(datain + run->aad_len, 0, aad_pad - run->aad_len);
+        memcpy(datain + aad_pad, (const void *)(uintptr_t)run->in, run->data_len);
+    } else {
+        memcpy(datain, sim.bounce, aad_pad + run->data_len);
+    }
+    sim.stat[AES_STAT_COPY_BYTES] += aad_pad + run->data_len;
+
+    if (run->mode == AES_MODE_BYPASS) {
+        reg_write(SIM_BYPASS_REG, 1);
+    } else {
+        reg_write(SIM_DECEN_REG, run->mode);
+        reg_write(SIM_BYPASS_REG, 0);
+    }
+    reg_write(SIM_ADDR_A1_REG, 0);
+    reg_write(SIM_ADDR_A2_REG, 0);
+    reg_write(SIM_AADINCNT_REG, run->aad_len);
+    sim_write(SIM_DATAINCNT_REG, 32, run->data_len);
+
+    if (sim_poll(SIM_DATAINCNT_REG, 0) < 0) {
+        return -1;
+    }
+    for (i = 0; i < 4; i++) {
+        put_be32(tag + 4 * (3 - i), reg_read(SIM_TAG_0_REG + 4 * i));
+    }
+    sim.stat[AES_STAT_OPS_ENCRYPT + run->mode]++;
+    sim.stat[AES_STAT_AAD_BYTES] += run->aad_len;
+    sim.stat[AES_STAT_DATA_BYTES] += run->data_len;
+    sim.stat[AES_STAT_KEY_LOADS] += key != NULL;
+
+    // Encrypted data of a registered buffer goes straight out, decrypted data waits for the tag
+    if (fixed && run->mode != AES_MODE_DECRYPT) {
+        memcpy((void *)(uintptr_t)run->out, (const void *)(sim.base + SIM_DATAOUT_OFFSET + aad_pad), run->data_len);
+        sim.stat[AES_STAT_COPY_BYTES] += run->data_len;
+    } else {
+        memcpy(sim.bounce, (const void *)(sim.base + SIM_DATAOUT_OFFSET + aad_pad), run->data_len);
+        sim.stat[AES_STAT_COPY_BYTES] += run->data_len;
+        if (run->mode == AES_MODE_DECRYPT && CRYPTO_memcmp(tag, run->tag, sizeof(tag)) != 0) {
+            errno = EBADMSG;
+            return -1;
+        }
+        memcpy((void *)(uintptr_t)run->out, sim.bounce, run->data_len);
+        sim.stat[AES_STAT_COPY_BYTES] += run->data_len;
+    }
+    memcpy(run->tag, tag, sizeof(tag));
+    return 0;
+}
+
+// Registration only records the range, the model has no pages to pin
+static int sim_buf_register(struct aes_buf_reg *reg) {
+    int i;
+
+    if (!reg->len || reg->len > AES_UBUF_MAX_SIZE || reg->reserved) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (i = 0; i < AES_UBUF_MAX && sim.bufs[i].len; i++) {
+    }
+    if (i == AES_UBUF_MAX) {
+        errno = ENOSPC;
+        return -1;
+    }
+    sim.bufs[i].addr = reg->addr;
+    sim.bufs[i].len = reg->len;
+    reg->index = (uint32_t)i;
+    return 0;
+}
+
+static int sim_buf_unregister(uint32_t index) {
+    if (index >= AES_UBUF_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!sim.bufs[index].len) {
+        errno = ENOENT;
+        return -1;
+    }
+    sim.bufs[index].len = 0;
+    return 0;
+}
+
+int kr260_sim_read_stats(struct aes_stats_snapshot *snap) {
+    pthread_mutex_lock(&sim.op_lock);
+    memset(snap, 0, sizeof(*snap));
+    snap->version = AES_STATS_VERSION;
+    snap->size = sizeof(*snap);
+    memcpy(snap->stat, sim.stat, sizeof(sim.stat));
+    pthread_mutex_unlock(&sim.op_lock);
+    return 0;
+}
+
+static int sim_key_register(struct aes_key_reg *reg) {
+    uint32_t slot;
+
+    if (reg->reserved) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (slot = 0; slot < sim.key_slots && sim.key_used[slot]; slot++) {
+    }
+    if (slot == sim.key_slots) {
+        uint32_t slots = sim.key_slots ? sim.key_slots * 2 : 64;
+        void *keys, *used;
+
+        if (sim.key_slots >= SIM_KEY_MAX) {
+            errno = ENOSPC;
+            return -1;
+        }
+        keys = realloc(sim.keys, slots * sizeof(*sim.keys));
+        if (!keys) {
+            errno = ENOMEM;
+            return -1;
+        }
+        sim.keys = keys;
+        used = realloc(sim.key_used, slots);
+        if (!used) {
+            errno = ENOMEM;
+            return -1;
+        }
+        sim.key_used = used;
+        memset(sim.key_used + sim.key_slots, 0, slots - sim.key_slots);
+        sim.key_slots = slots;
+    }
+
+    memcpy(sim.keys[slot], reg->key, sizeof(reg->key));
+    sim.key_used[slot] = 1;
+    sim.key_stats.registered++;
+    reg->handle = slot + 1;
+    return 0;
+}
+
+static int sim_key_unregister(uint32_t handle) {
+    if (handle == 0 || handle > sim.key_slots || !sim.key_used[handle - 1]) {
+        errno = ENOENT;
+        return -1;
+    }
+    OPENSSL_cleanse(sim.keys[handle - 1], sizeof(sim.keys[0]));
+    sim.key_used[handle - 1] = 0;
+    sim.key_stats.registered--;
+    if (sim.loaded_key == handle) {
+        sim.loaded_key = 0;
+    }
+    return 0;
+}
+
+// Ring worker is stalled: SQ empty, or CQ full until the caller reaps
+static int sim_ring_stalled(void) {
+    return __atomic_load_n(&sim.ring.hdr->sq_tail, __ATOMIC_ACQUIRE) == sim.ring.sq_head ||
+           sim.ring.cq_tail - __atomic_load_n(&sim.ring.hdr->cq_head, __ATOMIC_RELAXED) > sim.ring.mask;
+}
+
+// Run one SQE through the GCM_RUN path, return the CQE status
+static int32_t sim_ring_run(const struct aes_sqe *sqe, uint8_t *tag) {
+    struct aes_gcm_run run;
+    uint64_t size = sim.ring.data_size;
+    int ret;
+
+    if (!sqe->key_handle || (uint64_t)sqe->aad_off + sqe->aad_len > size ||
+        (uint64_t)sqe->in_off + sqe->data_len > size || (uint64_t)sqe->out_off + sqe->data_len > size) {
+        return -EINVAL;
+    }
+
+    memset(&run, 0, sizeof(run));
+    memcpy(run.iv, sqe->iv, sizeof(run.iv));
+    memcpy(run.tag, sqe->tag, sizeof(run.tag));
+    run.mode = sqe->mode;
+    run.key_handle = sqe->key_handle;
+    run.aad = (uint64_t)(uintptr_t)(sim.ring.data + sqe->aad_off);
+    run.aad_len = sqe->aad_len;
+    run.in = (uint64_t)(uintptr_t)(sim.ring.data + sqe->in_off);
+    run.out = (uint64_t)(uintptr_t)(sim.ring.data + sqe->out_off);
+    run.data_len = sqe->data_len;
+
+    pthread_mutex_lock(&sim.op_lock);
+    ret = sim_gcm_run(&run) < 0 ? -errno : 0;
+    pthread_mutex_unlock(&sim.op_lock);
+    if (ret == 0) {
+        memcpy(tag, run.tag, sizeof(run.tag));
+    }
+    return ret;
+}
+
+// Drain the SQ as the driver worker does, then set AES_RING_NEED_WAKEUP
+static void sim_ring_drain(void) {
+    struct aes_ring_hdr *hdr = sim.ring.hdr;
+    struct aes_sqe sqe;
+    struct aes_cqe *cqe;
+    uint64_t idle_end;
+
+    __atomic_store_n(&hdr->flags, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    idle_end = now_ns() + SIM_RING_IDLE_NS;
+
+    while (!sim.ring.stop) {
+        if (sim_ring_stalled()) {
+            if (now_ns() < idle_end) {
+                cpu_relax();
+                continue;
+            }
+            __atomic_store_n(&hdr->flags, AES_RING_NEED_WAKEUP, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (sim_ring_stalled()) {
+                break;
+            }
+            __atomic_store_n(&hdr->flags, 0, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        memcpy(&sqe, &sim.ring.sq[sim.ring.sq_head & sim.ring.mask], sizeof(sqe));
+        sim.ring.sq_head++;
+        __atomic_store_n(&hdr->sq_head, sim.ring.sq_head, __ATOMIC_RELEASE);
+
+        cqe = &sim.ring.cq[sim.ring.cq_tail & sim.ring.mask];
+        memset(cqe, 0, sizeof(*cqe));
+        cqe->user_data = sqe.user_data;
+        cqe->status = sim_ring_run(&sqe, cqe->tag);
+        sim.ring.cq_tail++;
+        __atomic_store_n(&hdr->cq_tail, sim.ring.cq_tail, __ATOMIC_RELEASE);
+        idle_end = now_ns() + SIM_RING_IDLE_NS;
+    }
+}
+
+// Ring worker thread: sleeps until AES_IOC_RING_ENTER
+static void *sim_ring_thread(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&sim.ring.lock);
+        while (!sim.ring.kicked && !sim.ring.stop) {
+            pthread_cond_wait(&sim.ring.cond, &sim.ring.lock);
+        }
+        sim.ring.kicked = 0;
+        if (sim.ring.stop) {
+            pthread_mutex_unlock(&sim.ring.lock);
+            return NULL;
+        }
+        pthread_mutex_unlock(&sim.ring.lock);
+        sim_ring_drain();
+    }
+}
+
+static int sim_ring_setup(struct aes_ring_setup *setup) {
+    void *mem;
+
+    if (sim.ring.mem) {
+        errno = EBUSY;
+        return -1;
+    }
+    if (!setup->entries || (setup->entries & (setup->entries - 1)) ||
+        setup->entries > AES_RING_MAX_ENTRIES || !setup->data_size || setup->data_size > AES_RING_MAX_DATA) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    setup->sq_off = (sizeof(struct aes_ring_hdr) + 63) & ~63u;
+    setup->cq_off = setup->sq_off + setup->entries * sizeof(struct aes_sqe);
+    setup->data_off = (setup->cq_off + setup->entries * sizeof(struct aes_cqe) + 4095) & ~4095u;
+    setup->size = (setup->data_off + setup->data_size + 4095) & ~4095u;
+
+    mem = mmap(NULL, setup->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        errno = ENOMEM;
+        return -1;
+    }
+    sim.ring.mem = mem;
+    sim.ring.size = setup->size;
+    sim.ring.hdr = (struct aes_ring_hdr *)mem;
+    sim.ring.sq = (struct aes_sqe *)(sim.ring.mem + setup->sq_off);
+    sim.ring.cq = (struct aes_cqe *)(sim.ring.mem + setup->cq_off);
+    sim.ring.data = sim.ring.mem + setup->data_off;
+    sim.ring.data_size = setup->data_size;
+    sim.ring.mask = setup->entries - 1;
+    sim.ring.sq_head = 0;
+    sim.ring.cq_tail = 0;
+    sim.ring.hdr->entries = setup->entries;
+    sim.ring.hdr->flags = AES_RING_NEED_WAKEUP;
+    sim.ring.kicked = 0;
+    sim.ring.stop = 0;
+
+    if (pthread_create(&sim.ring.thread, NULL, sim_ring_thread, NULL) != 0) {
+        munmap(mem, setup->size);
+        sim.ring.mem = NULL;
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+static int sim_ring_enter(void) {
+    if (!sim.ring.mem) {
+        errno = ENXIO;
+        return -1;
+    }
+    pthread_mutex_lock(&sim.ring.lock);
+    sim.ring.kicked = 1;
+    pthread_cond_signal(&sim.ring.cond);
+    pthread_mutex_unlock(&sim.ring.lock);
+    return 0;
+}
+
+static void sim_ring_free(void) {
+    if (!sim.ring.mem) {
+        return;
+    }
+    pthread_mutex_lock(&sim.ring.lock);
+    sim.ring.stop = 1;
+    pthread_cond_signal(&sim.ring.cond);
+    pthread_mutex_unlock(&sim.ring.lock);
+    pthread_join(sim.ring.thread, NULL);
+    munmap(sim.ring.mem, sim.ring.size);
+    sim.ring.mem = NULL;
+}
+
+void *kr260_sim_ring_map(size_t size) {
+    if (!sim.ring.mem || size > sim.ring.size) {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+    return sim.ring.mem;
+}
+
+// Bulk copy as the driver's memcpy_toio/memcpy_fromio, DATAINCNT is left to WRITE_REG
+static int sim_range(const struct aes_range *range, int write) {
+    uint8_t *buf = (uint8_t *)(uintptr_t)range->buf;
+
+    if (range->length == 0 || (uint64_t)range->offset + range->length > SIM_WINDOW_SIZE ||
+        (write && range->offset < SIM_DATAINCNT_REG + 4 && range->offset + range->length > SIM_DATAINCNT_REG)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (write) {
+        if (range->offset < SIM_IVIN_0_REG && range->offset + range->length > SIM_KEYIN_0_REG) {
+            sim.loaded_key = 0;
+        }
+        memcpy((uint8_t *)sim.base + range->offset, buf, range->length);
+    } else {
+        memcpy(buf, (const uint8_t *)sim.base + range->offset, range->length);
+    }
+    return 0;
+}
+
+static int sim_ioctl(unsigned long cmd, unsigned long arg) {
+    struct aes_reg_data *reg = (struct aes_reg_data *)arg;
+    uint32_t mode;
+
+    switch (cmd) {
+        case AES_IOC_READ_REG:
+            if (reg->offset >= SIM_WINDOW_SIZE) {
+                errno = EINVAL;
+                return -1;
+            }
+            reg->value = sim_read(reg->offset, reg->width);
+            return 0;
+
+        case AES_IOC_WRITE_REG:
+            if (reg->offset >= SIM_WINDOW_SIZE) {
+                errno = EINVAL;
+                return -1;
+            }
+            sim_write(reg->offset, reg->width, reg->value);
+            return 0;
+
+        case AES_IOC_BATCH:
+            return sim_batch((struct aes_batch *)arg);
+
+        case AES_IOC_BUF_REGISTER:
+            return sim_buf_register((struct aes_buf_reg *)arg);
+
+        case AES_IOC_BUF_UNREGISTER:
+            return sim_buf_unregister(*(const uint32_t *)arg);
+
+        case AES_IOC_READ_RANGE:
+            return sim_range((const struct aes_range *)arg, 0);
+
+        case AES_IOC_WRITE_RANGE:
+            return sim_range((const struct aes_range *)arg, 1);
+
+        case AES_IOC_GCM_RUN:
+            return sim_gcm_run((struct aes_gcm_run *)arg);
+
+        case AES_IOC_WAIT:
+            return sim_poll(SIM_DATAINCNT_REG, (uint32_t)arg);
+
+        case AES_IOC_SET_WAIT_MODE:
+            mode = *(const uint32_t *)arg;
+            if (mode > AES_WAIT_HYBRID) {
+                errno = EINVAL;
+                return -1;
+            }
+            sim.wait_mode = mode;
+            return 0;
+
+        case AES_IOC_GET_WAIT_STATS:
+            memcpy((void *)arg, &sim.stats, sizeof(sim.stats));
+            return 0;
+
+        case AES_IOC_KEY_REGISTER:
+            return sim_key_register((struct aes_key_reg *)arg);
+
+        case AES_IOC_KEY_UNREGISTER:
+            return sim_key_unregister(*(const uint32_t *)arg);
+
+        case AES_IOC_GET_KEY_STATS:
+            sim.key_stats.loaded = sim.loaded_key;
+            memcpy((void *)arg, &sim.key_stats, sizeof(sim.key_stats));
+            return 0;
+
+        case AES_IOC_RING_SETUP:
+            return sim_ring_setup((struct aes_ring_setup *)arg);
+
+        default:
+            errno = ENOTTY;
+            return -1;
+    }
+}
+
+int kr260_sim_ioctl(int fd, unsigned long cmd, unsigned long arg) {
+    int ret;
+
+    (void)fd;
+    if (!sim.base) {
+        errno = EBADF;
+        return -1;
+    }
+
+    // Kernel entry and exit of the real ioctl
+    getppid();
+
+    // The doorbell does not wait for the ring worker's entry in flight
+    if (cmd == AES_IOC_RING_ENTER) {
+        return sim_ring_enter();
+    }
+
+    pthread_mutex_lock(&sim.op_lock);
+    ret = sim_ioctl(cmd, arg);
+    pthread_mutex_unlock(&sim.op_lock);
+    return ret;
+}
@@ -0,0 +1,46 @@
+#ifndef KR260_SIM_H
+#define KR260_SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Software model of the AES256GCM10G25G register window for hosts without the KR260.
+ * Build KR260.c or KR260_ioctl.c with -DKR260_SIM and link KR260_sim.c -lcrypto -lpthread:
+ * the mmap library then maps the model instead of /dev/mem, the ioctl library runs the driver
+ * ioctls against it. A model thread starts an operation when DATAINCNT becomes non-zero,
+ * computes it with OpenSSL and clears DATAINCNT after base + per-byte latency.
+ *
+ * Latency can be set with KR260_SIM_BASE_NS and KR260_SIM_PS_PER_BYTE in the environment.
+ */
+
+#define KR260_SIM_BASE_NS       1000    /* Fixed time per operation */
+#define KR260_SIM_PS_PER_BYTE   320     /* 25 Gbps of AAD + payload */
+#define KR260_SIM_VERSION       0x53494D01
+
+// Open the model, starting it on first use. Return a file descriptor to pass back, or -1
+int kr260_sim_open(void);
+
+// Drop one reference, the model stops with the last one
+void kr260_sim_close(int fd);
+
+// Start of the 64 KB register window
+volatile uint8_t *kr260_sim_base(void);
+
+// Run one driver ioctl against the model, same return convention as ioctl(2). Each call
+// also makes one real system call so that kernel entry cost stays in the numbers
+int kr260_sim_ioctl(int fd, unsigned long cmd, unsigned long arg);
+
+// Memory of the rings created by AES_IOC_RING_SETUP, stands in for mmap at AES_RING_MMAP_OFFSET.
+// Return MAP_FAILED when there is no ring or size is larger than it
+void *kr260_sim_ring_map(size_t size);
+
+struct aes_stats_snapshot;
+
+// Counters of the AES_IOC_GCM_RUN operations run by the model. Return 0
+int kr260_sim_read_stats(struct aes_stats_snapshot *snap);
+
+// Change the modelled latency
+void kr260_sim_set_latency(uint32_t base_ns, uint32_t ps_per_byte);
+
+#endif // KR260_SIM_H
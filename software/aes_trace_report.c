@@ -0,0 +1,371 @@
+/*
+ * Per-stage latency breakdown from a trace of the aes256gcm driver tracepoints.
+ *
+ * Record with any of:
+ *   echo 1 > /sys/kernel/tracing/events/aes256gcm/enable; <run>; cat /sys/kernel/tracing/trace > trace.txt
+ *   trace-cmd record -e aes256gcm <run>; trace-cmd report -t > trace.txt
+ *   perf record -e 'aes256gcm:*' <run>; perf script --ns > trace.txt
+ * then run: aes_trace_report [trace.txt]   (stdin when no file is given)
+ *
+ * The ftrace text output has microsecond timestamps, trace-cmd -t and perf --ns keep nanoseconds.
+ * Operations on one device are serialised by the driver, so the stages of an operation are the
+ * gaps between consecutive events of that device:
+ *   entry     ioctl entry to key load or copy-in (user copies, lock wait)
+ *   key_load  KEYIN programming
+ *   copy_in   AAD and payload into DATAIN, IV and mode registers
+ *   hw        DATAINCNT written to completion seen
+ *   wakeup    completion seen to copy-out (IRQ delivery, scheduling)
+ *   copy_out  payload out of DATAOUT, tag, user copy and ioctl exit
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define MAX_DEVS        16
+#define MAX_TASKS       1024
+#define MAX_IOCTL_NR    32
+
+enum event {
+    EV_IOCTL_ENTER, EV_IOCTL_EXIT, EV_REG_READ, EV_REG_WRITE, EV_OP_START, EV_OP_COMPLETE,
+    EV_COPY_IN, EV_COPY_OUT, EV_KEY_LOAD, EV_NR
+};
+
+static const char *const event_names[EV_NR] = {
+    "aes_ioctl_enter", "aes_ioctl_exit", "aes_reg_read", "aes_reg_write", "aes_op_start",
+    "aes_op_complete", "aes_copy_in", "aes_copy_out", "aes_key_load",
+};
+
+enum stage { ST_ENTRY, ST_KEY_LOAD, ST_COPY_IN, ST_HW, ST_WAKEUP, ST_COPY_OUT, ST_NR };
+
+static const char *const stage_names[ST_NR] = {
+    "entry", "key_load", "copy_in", "hw", "wakeup", "copy_out",
+};
+
+/* ioctl numbers of aes-driver.c */
+static const char *const ioctl_names[MAX_IOCTL_NR] = {
+    [1] = "READ_REG", [2] = "WRITE_REG", [3] = "BATCH", [4] = "GCM_RUN", [5] = "WAIT",
+    [6] = "SET_WAIT_MODE", [7] = "GET_WAIT_STATS", [8] = "KEY_REGISTER", [9] = "KEY_UNREGISTER",
+    [10] = "GET_KEY_STATS", [11] = "RING_SETUP", [12] = "RING_ENTER", [13] = "READ_RANGE",
+    [14] = "WRITE_RANGE", [15] = "BUF_REGISTER", [16] = "BUF_UNREGISTER",
+};
+
+struct samples {
+    uint64_t *v;
+    size_t n, cap;
+};
+
+/* Open operation of one device, 0 = mark not seen */
+struct dev_state {
+    char name[64];
+    uint64_t key, copy_in, start, complete, copy_out;
+    int copy_out_pid;
+};
+
+/* Open ioctl of one task */
+struct task_state {
+    int pid;
+    uint64_t enter;
+    int marked;     /* entry stage already taken for this ioctl */
+};
+
+static struct samples stages[ST_NR];
+static struct samples ioctls[MAX_IOCTL_NR];
+static uint64_t event_count[EV_NR];
+static struct dev_state devs[MAX_DEVS];
+static struct task_state tasks[MAX_TASKS];
+static int num_devs, num_tasks;
+
+static void add_sample(struct samples *s, uint64_t v) {
+    if (s->n == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 1024;
+        s->v = realloc(s->v, s->cap * sizeof(*s->v));
+        if (!s->v) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    s->v[s->n++] = v;
+}
+
+static struct dev_state *find_dev(const char *name) {
+    for (int i = 0; i < num_devs; i++) {
+        if (strcmp(devs[i].name, name) == 0) {
+            return &devs[i];
+        }
+    }
+    if (num_devs == MAX_DEVS) {
+        return NULL;
+    }
+    snprintf(devs[num_devs].name, sizeof(devs[num_devs].name), "%s", name);
+    return &devs[num_devs++];
+}
+
+static struct task_state *find_task(int pid) {
+    for (int i = 0; i < num_tasks; i++) {
+        if (tasks[i].pid == pid) {
+            return &tasks[i];
+        }
+    }
+    if (num_tasks == MAX_TASKS) {
+        return NULL;
+    }
+    tasks[num_tasks].pid = pid;
+    return &tasks[num_tasks++];
+}
+
+// "123.456789:" to nanoseconds, return 0 if the token is not a timestamp
+static int parse_timestamp(const char *tok, size_t len, uint64_t *ns) {
+    uint64_t sec = 0, frac = 0;
+    size_t i = 0;
+    int digits = 0;
+
+    if (len < 3 || tok[len - 1] != ':') {
+        return 0;
+    }
+    while (i < len && isdigit((unsigned char)tok[i])) {
+        sec = sec * 10 + (tok[i++] - '0');
+    }
+    if (i == 0 || tok[i++] != '.') {
+        return 0;
+    }
+    while (i < len - 1 && isdigit((unsigned char)tok[i])) {
+        if (digits < 9) {
+            frac = frac * 10 + (tok[i] - '0');
+            digits++;
+        }
+        i++;
+    }
+    if (i != len - 1 || digits == 0) {
+        return 0;
+    }
+    while (digits++ < 9) {
+        frac *= 10;
+    }
+    *ns = sec * 1000000000ULL + frac;
+    return 1;
+}
+
+// Task id from the token before "[cpu]": "comm-1234" (ftrace, trace-cmd) or "1234" / "1234/1234" (perf)
+static int parse_pid(const char *tok, size_t len) {
+    size_t i = len;
+
+    while (i > 0 && isdigit((unsigned char)tok[i - 1])) {
+        i--;
+    }
+    return i < len ? atoi(tok + i) : -1;
+}
+
+// Value of key= in the event fields, copied into buf
+static int field(const char *fields, const char *key, char *buf, size_t size) {
+    const char *p = fields;
+    size_t klen = strlen(key), n = 0;
+
+    while ((p = strstr(p, key)) != NULL) {
+        if ((p == fields || p[-1] == ' ') && p[klen] == '=') {
+            p += klen + 1;
+            while (p[n] && !isspace((unsigned char)p[n]) && n + 1 < size) {
+                buf[n] = p[n];
+                n++;
+            }
+            buf[n] = '\0';
+            return 1;
+        }
+        p += klen;
+    }
+    return 0;
+}
+
+// First stage mark of an operation started from an ioctl
+static void mark_entry(int pid, uint64_t ts) {
+    struct task_state *t = find_task(pid);
+
+    if (t && t->enter && !t->marked) {
+        add_sample(&stages[ST_ENTRY], ts - t->enter);
+        t->marked = 1;
+    }
+}
+
+static void handle_line(const char *line) {
+    const char *ev = NULL, *p, *tok, *fields;
+    const char *prev_tok = NULL;
+    size_t prev_len = 0, len;
+    struct dev_state *d;
+    struct task_state *t;
+    uint64_t ts = 0;
+    char buf[64];
+    int e, pid = -1, have_ts = 0;
+
+    for (e = 0; e < EV_NR; e++) {
+        len = strlen(event_names[e]);
+        for (p = strstr(line, event_names[e]); p; p = strstr(p + 1, event_names[e])) {
+            if ((p == line || p[-1] == ' ' || p[-1] == ':') && p[len] == ':') {
+                ev = p;
+                break;
+            }
+        }
+        if (ev) {
+            break;
+        }
+    }
+    if (!ev) {
+        return;
+    }
+
+    // Tokens before the event: task, [cpu], flags, timestamp
+    for (tok = line; tok < ev; tok += len) {
+        while (tok < ev && isspace((unsigned char)*tok)) {
+            tok++;
+        }
+        for (len = 0; tok + len < ev && !isspace((unsigned char)tok[len]); len++) {
+        }
+        if (len == 0) {
+            break;
+        }
+        if (tok[0] == '[' && prev_tok && pid < 0) {
+            pid = parse_pid(prev_tok, prev_len);
+        }
+        have_ts |= parse_timestamp(tok, len, &ts);
+        prev_tok = tok;
+        prev_len = len;
+    }
+    if (!have_ts) {
+        return;
+    }
+
+    event_count[e]++;
+    fields = ev + strlen(event_names[e]) + 1;
+    if (!field(fields, "dev", buf, sizeof(buf)) || !(d = find_dev(buf))) {
+        return;
+    }
+
+    switch (e) {
+    case EV_IOCTL_ENTER:
+        if ((t = find_task(pid)) != NULL) {
+            t->enter = ts;
+            t->marked = 0;
+        }
+        break;
+    case EV_IOCTL_EXIT:
+        t = find_task(pid);
+        if (!t || !t->enter) {
+            break;
+        }
+        if (field(fields, "cmd", buf, sizeof(buf))) {
+            unsigned int nr = (unsigned int)strtoul(buf, NULL, 0) & 0xff;
+
+            if (nr < MAX_IOCTL_NR) {
+                add_sample(&ioctls[nr], ts - t->enter);
+            }
+        }
+        if (d->copy_out && d->copy_out_pid == pid) {
+            add_sample(&stages[ST_COPY_OUT], ts - d->copy_out);
+            d->copy_out = 0;
+        }
+        t->enter = 0;
+        break;
+    case EV_KEY_LOAD:
+        mark_entry(pid, ts);
+        d->key = ts;
+        break;
+    case EV_COPY_IN:
+        mark_entry(pid, ts);
+        if (d->key) {
+            add_sample(&stages[ST_KEY_LOAD], ts - d->key);
+            d->key = 0;
+        }
+        d->copy_in = ts;
+        break;
+    case EV_OP_START:
+        if (d->copy_in) {
+            add_sample(&stages[ST_COPY_IN], ts - d->copy_in);
+            d->copy_in = 0;
+        }
+        d->start = ts;
+        break;
+    case EV_OP_COMPLETE:
+        if (d->start) {
+            add_sample(&stages[ST_HW], ts - d->start);
+            d->start = 0;
+        }
+        d->complete = ts;
+        break;
+    case EV_COPY_OUT:
+        if (d->complete) {
+            add_sample(&stages[ST_WAKEUP], ts - d->complete);
+            d->complete = 0;
+        }
+        d->copy_out = ts;
+        d->copy_out_pid = pid;
+        break;
+    default:
+        break;
+    }
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void print_row(const char *name, struct samples *s) {
+    uint64_t sum = 0;
+
+    if (s->n == 0) {
+        return;
+    }
+    qsort(s->v, s->n, sizeof(*s->v), cmp_u64);
+    for (size_t i = 0; i < s->n; i++) {
+        sum += s->v[i];
+    }
+    printf("%-16s | %9zu | %10.3f | %10.3f | %10.3f | %10.3f\n", name, s->n,
+           (double)sum / s->n / 1000.0, s->v[s->n / 2] / 1000.0,
+           s->v[(s->n * 99) / 100] / 1000.0, s->v[s->n - 1] / 1000.0);
+}
+
+int main(int argc, char *argv[]) {
+    FILE *in = stdin;
+    char line[4096], name[32];
+
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-' && argv[1][1] != '\0')) {
+        printf("Usage: %s [trace file]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 2 && strcmp(argv[1], "-") != 0) {
+        in = fopen(argv[1], "r");
+        if (!in) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    while (fgets(line, sizeof(line), in)) {
+        handle_line(line);
+    }
+    if (in != stdin) {
+        fclose(in);
+    }
+
+    printf("Stage            |     Count |   Avg (us) |   p50 (us) |   p99 (us) |   Max (us)\n");
+    printf("-----------------|-----------|------------|------------|------------|-----------\n");
+    for (int i = 0; i < ST_NR; i++) {
+        print_row(stage_names[i], &stages[i]);
+    }
+    for (int i = 0; i < MAX_IOCTL_NR; i++) {
+        if (ioctl_names[i]) {
+            snprintf(name, sizeof(name), "ioctl %s", ioctl_names[i]);
+        } else {
+            snprintf(name, sizeof(name), "ioctl nr %d", i);
+        }
+        print_row(name, &ioctls[i]);
+    }
+
+    printf("\nEvents:");
+    for (int i = 0; i < EV_NR; i++) {
+        printf(" %s=%llu", event_names[i] + 4, (unsigned long long)event_count[i]);
+    }
+    printf("\n");
+    return 0;
+}
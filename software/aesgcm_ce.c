@@ -0,0 +1,371 @@
+#include "aesgcm_ce.h"
+#include <errno.h>
+#include <string.h>
+
+/*
+ * CTR runs AESGCM_CE_WAYS independent counter blocks through the rounds together, so the
+ * pipelined AES units stay busy instead of waiting on one block's round chain. Every
+ * AESGCM_CE_CHUNK bytes of ciphertext then go through ghash_update, which multiplies
+ * GHASH_AGG blocks by the precomputed powers of H and reduces once. The key schedule uses the
+ * AES instruction itself for SubWord, so there is no table lookup on key material.
+ */
+
+#define AESGCM_CE_WAYS  8
+#define AESGCM_CE_CHUNK 1024    /* CTR then GHASH over this much, while it is still in L1 */
+
+#if !defined(AESGCM_CE_GENERIC) && defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO)
+#define AESGCM_CE_ARM   1
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#elif !defined(AESGCM_CE_GENERIC) && (defined(__x86_64__) || defined(__i386__)) && \
+      defined(__AES__) && defined(__PCLMUL__) && defined(__SSSE3__)
+#define AESGCM_CE_X86   1
+#include <immintrin.h>
+#endif
+
+#if defined(AESGCM_CE_ARM)
+
+typedef uint8x16_t aes_block_t;
+
+static inline aes_block_t aes_load(const uint8_t *p)
+{
+    return vld1q_u8(p);
+}
+
+static inline void aes_store(uint8_t *p, aes_block_t b)
+{
+    vst1q_u8(p, b);
+}
+
+static inline aes_block_t aes_xor(aes_block_t a, aes_block_t b)
+{
+    return veorq_u8(a, b);
+}
+
+// IV || counter with every word byte-reversed, so the counter is a native lane 3 that a plain add
+// steps (inc32); aes_ctr_block turns it back into the block
+static inline aes_block_t aes_ctr_base(const uint8_t iv[12], uint32_t ctr)
+{
+    uint8_t block[16];
+
+    memcpy(block, iv, 12);
+    memset(block + 12, 0, 4);
+    return vreinterpretq_u8_u32(vsetq_lane_u32(ctr, vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(block))), 3));
+}
+
+static inline aes_block_t aes_ctr_block(aes_block_t base, uint32_t i)
+{
+    uint32x4_t inc = vsetq_lane_u32(i, vdupq_n_u32(0), 3);
+
+    return vrev32q_u8(vreinterpretq_u8_u32(vaddq_u32(vreinterpretq_u32_u8(base), inc)));
+}
+
+// AESE is AddRoundKey + SubBytes + ShiftRows, so round key i goes in before round i's SubBytes
+// and the last key is a plain XOR
+static inline void aes_encrypt_ways(const struct aesgcm_ce_ctx *ctx, aes_block_t *b, int n)
+{
+#pragma GCC unroll 13
+    for (int r = 0; r < 13; r++) {
+        aes_block_t k = vld1q_u8(ctx->rk[r]);
+
+#pragma GCC unroll 8
+        for (int j = 0; j < n; j++) {
+            b[j] = vaesmcq_u8(vaeseq_u8(b[j], k));
+        }
+    }
+#pragma GCC unroll 8
+    for (int j = 0; j < n; j++) {
+        b[j] = veorq_u8(vaeseq_u8(b[j], vld1q_u8(ctx->rk[13])), vld1q_u8(ctx->rk[14]));
+    }
+}
+
+// SubBytes of a word repeated in all columns: ShiftRows moves nothing, AESE with a zero key is SubWord
+static inline uint32_t aes_sub_word(uint32_t w)
+{
+    return vgetq_lane_u32(vreinterpretq_u32_u8(vaeseq_u8(vreinterpretq_u8_u32(vdupq_n_u32(w)), vdupq_n_u8(0))), 0);
+}
+
+static int aes_cpu_ok(void)
+{
+    unsigned long hwcap = getauxval(AT_HWCAP);
+
+    return (hwcap & HWCAP_AES) && (hwcap & HWCAP_PMULL);
+}
+
+const char *aesgcm_ce_impl(void)
+{
+    return aes_cpu_ok() ? "armv8-ce" : "none";
+}
+
+#elif defined(AESGCM_CE_X86)
+
+typedef __m128i aes_block_t;
+
+static inline aes_block_t aes_load(const uint8_t *p)
+{
+    return _mm_loadu_si128((const __m128i *)p);
+}
+
+static inline void aes_store(uint8_t *p, aes_block_t b)
+{
+    _mm_storeu_si128((__m128i *)p, b);
+}
+
+static inline aes_block_t aes_xor(aes_block_t a, aes_block_t b)
+{
+    return _mm_xor_si128(a, b);
+}
+
+// IV || counter with the 16 bytes reversed, so the counter is lane 0 and a plain add steps it (inc32)
+static inline aes_block_t aes_ctr_base(const uint8_t iv[12], uint32_t ctr)
+{
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    uint8_t block[16];
+
+    memcpy(block, iv, 12);
+    memset(block + 12, 0, 4);
+    return _mm_add_epi32(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)block), bswap), _mm_cvtsi32_si128((int)ctr));
+}
+
+static inline aes_block_t aes_ctr_block(aes_block_t base, uint32_t i)
+{
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+    return _mm_shuffle_epi8(_mm_add_epi32(base, _mm_cvtsi32_si128((int)i)), bswap);
+}
+
+static inline void aes_encrypt_ways(const struct aesgcm_ce_ctx *ctx, aes_block_t *b, int n)
+{
+    aes_block_t k = aes_load(ctx->rk[0]);
+
+#pragma GCC unroll 8
+    for (int j = 0; j < n; j++) {
+        b[j] = _mm_xor_si128(b[j], k);
+    }
+#pragma GCC unroll 13
+    for (int r = 1; r < 14; r++) {
+        k = aes_load(ctx->rk[r]);
+#pragma GCC unroll 8
+        for (int j = 0; j < n; j++) {
+            b[j] = _mm_aesenc_si128(b[j], k);
+        }
+    }
+    k = aes_load(ctx->rk[14]);
+#pragma GCC unroll 8
+    for (int j = 0; j < n; j++) {
+        b[j] = _mm_aesenclast_si128(b[j], k);
+    }
+}
+
+// AESKEYGENASSIST returns SubWord of its second word in the first lane
+static inline uint32_t aes_sub_word(uint32_t w)
+{
+    return (uint32_t)_mm_cvtsi128_si32(_mm_aeskeygenassist_si128(_mm_set1_epi32((int)w), 0));
+}
+
+static int aes_cpu_ok(void)
+{
+    return __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+}
+
+const char *aesgcm_ce_impl(void)
+{
+    return aes_cpu_ok() ? "aes-ni" : "none";
+}
+
+#else
+
+const char *aesgcm_ce_impl(void)
+{
+    return "none";
+}
+
+#endif
+
+#if defined(AESGCM_CE_ARM) || defined(AESGCM_CE_X86)
+
+// FIPS-197 key expansion for Nk = 8, words little-endian in memory order
+static void aes_expand_key(struct aesgcm_ce_ctx *ctx, const uint8_t key[32])
+{
+    uint32_t w[60];
+    uint8_t rcon = 1;
+
+    memcpy(w, key, 32);
+    for (int i = 8; i < 60; i++) {
+        uint32_t t = w[i - 1];
+
+        if (i % 8 == 0) {
+            t = aes_sub_word((t >> 8) | (t << 24)) ^ rcon;
+            rcon <<= 1;
+        } else if (i % 8 == 4) {
+            t = aes_sub_word(t);
+        }
+        w[i] = w[i - 8] ^ t;
+    }
+    memcpy(ctx->rk, w, sizeof(ctx->rk));
+}
+
+static void aes_encrypt_block(const struct aesgcm_ce_ctx *ctx, const uint8_t in[16], uint8_t out[16])
+{
+    aes_block_t b = aes_load(in);
+
+    aes_encrypt_ways(ctx, &b, 1);
+    aes_store(out, b);
+}
+
+// XOR len bytes with the keystream of counters ctr, ctr + 1, ...
+static void ctr_xor(const struct aesgcm_ce_ctx *ctx, const uint8_t iv[12], uint32_t ctr,
+                    const uint8_t *in, uint8_t *out, size_t len)
+{
+    aes_block_t b[AESGCM_CE_WAYS], base = aes_ctr_base(iv, ctr);
+    uint32_t i = 0;
+
+    for (; len >= AESGCM_CE_WAYS * 16; len -= AESGCM_CE_WAYS * 16) {
+#pragma GCC unroll 8
+        for (int j = 0; j < AESGCM_CE_WAYS; j++) {
+            b[j] = aes_ctr_block(base, i + j);
+        }
+        aes_encrypt_ways(ctx, b, AESGCM_CE_WAYS);
+#pragma GCC unroll 8
+        for (int j = 0; j < AESGCM_CE_WAYS; j++) {
+            aes_store(out + 16 * j, aes_xor(b[j], aes_load(in + 16 * j)));
+        }
+        i += AESGCM_CE_WAYS;
+        in += AESGCM_CE_WAYS * 16;
+        out += AESGCM_CE_WAYS * 16;
+    }
+    for (; len >= 16; len -= 16) {
+        b[0] = aes_ctr_block(base, i++);
+        aes_encrypt_ways(ctx, b, 1);
+        aes_store(out, aes_xor(b[0], aes_load(in)));
+        in += 16;
+        out += 16;
+    }
+    if (len) {
+        uint8_t ks[16];
+
+        b[0] = aes_ctr_block(base, i);
+        aes_encrypt_ways(ctx, b, 1);
+        aes_store(ks, b[0]);
+        for (size_t i = 0; i < len; i++) {
+            out[i] = in[i] ^ ks[i];
+        }
+    }
+}
+
+int aesgcm_ce_init(struct aesgcm_ce_ctx *ctx, const uint8_t key[32])
+{
+    static const uint8_t zero[16];
+    uint8_t h[16];
+
+    if (!aes_cpu_ok()) {
+        errno = ENOTSUP;
+        return -1;
+    }
+    aes_expand_key(ctx, key);
+    aes_encrypt_block(ctx, zero, h);
+    ghash_init(&ctx->ghash, h);
+    return 0;
+}
+
+// Shared path, tag receives E(K, J0) xor S. Decryption hashes each chunk before overwriting it
+static int aesgcm_ce_run(int decrypt, struct aesgcm_ce_ctx *ctx, const uint8_t iv[12],
+                         const uint8_t *aad, size_t aad_len,
+                         const uint8_t *in, uint8_t *out, size_t len, uint8_t tag[16])
+{
+    uint8_t j0[16], s[16];
+    uint32_t ctr = 2;
+
+    if (len > ((uint64_t)1 << 36) - 32) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    ghash_reset(&ctx->ghash);
+    ghash_update_aad(&ctx->ghash, aad, aad_len);
+
+    for (size_t pos = 0; pos < len; pos += AESGCM_CE_CHUNK) {
+        size_t n = len - pos < AESGCM_CE_CHUNK ? len - pos : AESGCM_CE_CHUNK;
+
+        if (decrypt) {
+            ghash_update(&ctx->ghash, in + pos, n);
+        }
+        ctr_xor(ctx, iv, ctr, in + pos, out + pos, n);
+        if (!decrypt) {
+            ghash_update(&ctx->ghash, out + pos, n);
+        }
+        ctr += AESGCM_CE_CHUNK / 16;
+    }
+
+    ghash_final(&ctx->ghash, s);
+    memcpy(j0, iv, 12);
+    j0[12] = j0[13] = j0[14] = 0;
+    j0[15] = 1;
+    aes_encrypt_block(ctx, j0, j0);
+    for (int i = 0; i < 16; i++) {
+        tag[i] = j0[i] ^ s[i];
+    }
+    return 0;
+}
+
+int aesgcm_ce_encrypt(struct aesgcm_ce_ctx *ctx, const uint8_t iv[12],
+                      const uint8_t *aad, size_t aad_len,
+                      const uint8_t *in, uint8_t *out, size_t len,
+                      uint8_t tag[16])
+{
+    return aesgcm_ce_run(0, ctx, iv, aad, aad_len, in, out, len, tag);
+}
+
+int aesgcm_ce_decrypt(struct aesgcm_ce_ctx *ctx, const uint8_t iv[12],
+                      const uint8_t *aad, size_t aad_len,
+                      const uint8_t *in, uint8_t *out, size_t len,
+                      const uint8_t tag[16])
+{
+    uint8_t computed[16], diff = 0;
+
+    if (aesgcm_ce_run(1, ctx, iv, aad, aad_len, in, out, len, computed) < 0) {
+        return -1;
+    }
+    // Constant time, like CRYPTO_memcmp
+    for (int i = 0; i < 16; i++) {
+        diff |= computed[i] ^ tag[i];
+    }
+    if (diff) {
+        memset(out, 0, len);
+        errno = EBADMSG;
+        return -1;
+    }
+    return 0;
+}
+
+#else
+
+int aesgcm_ce_init(struct aesgcm_ce_ctx *ctx, const uint8_t key[32])
+{
+    (void)ctx;
+    (void)key;
+    errno = ENOTSUP;
+    return -1;
+}
+
+int aesgcm_ce_encrypt(struct aesgcm_ce_ctx *ctx, const uint8_t iv[12],
+                      const uint8_t *aad, size_t aad_len,
+                      const uint8_t *in, uint8_t *out, size_t len,
+                      uint8_t tag[16])
+{
+    (void)ctx; (void)iv; (void)aad; (void)aad_len; (void)in; (void)out; (void)len; (void)tag;
+    errno = ENOTSUP;
+    return -1;
+}
+
+int aesgcm_ce_decrypt(struct aesgcm_ce_ctx *ctx, const uint8_t iv[12],
+                      const uint8_t *aad, size_t aad_len,
+                      const uint8_t *in, uint8_t *out, size_t len,
+                      const uint8_t tag[16])
+{
+    (void)ctx; (void)iv; (void)aad; (void)aad_len; (void)in; (void)out; (void)len; (void)tag;
+    errno = ENOTSUP;
+    return -1;
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef AESGCM_CE_H
+#define AESGCM_CE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ghash.h"
+
+/* AES-256-GCM key state: round keys and the GHASH key with its powers */
+struct aesgcm_ce_ctx {
+    uint8_t          rk[15][16];    /* AES-256 round keys in FIPS-197 byte order */
+    struct ghash_ctx ghash;         /* H = E(K, 0^128), reset for every message */
+};
+
+// AES-256-GCM on the CPU's AES instructions, without OpenSSL: ARMv8 Crypto Extensions
+// (AESE/AESMC, PMULL/PMULL2) when built with -march=armv8-a+crypto, AES-NI and PCLMULQDQ when
+// built with -maes -mpclmul -mssse3. Every call returns -1 with errno=ENOTSUP on other builds
+// or CPUs.
+
+// Expand key. Return 0, or -1 on error
+int aesgcm_ce_init(struct aesgcm_ce_ctx *ctx, const uint8_t key[32]);
+
+// Encrypt one message with a 96-bit IV. Return 0, or -1 on error
+int aesgcm_ce_encrypt(struct aesgcm_ce_ctx *ctx, const uint8_t iv[12],
+                      const uint8_t *aad, size_t aad_len,
+                      const uint8_t *in, uint8_t *out, size_t len,
+                      uint8_t tag[16]);
+
+// Same for decryption. Return 0, or -1 with errno=EBADMSG and out zeroed when the tag does not match
+int aesgcm_ce_decrypt(struct aesgcm_ce_ctx *ctx, const uint8_t iv[12],
+                      const uint8_t *aad, size_t aad_len,
+                      const uint8_t *in, uint8_t *out, size_t len,
+                      const uint8_t tag[16]);
+
+// Instructions in use: "armv8-ce", "aes-ni", or "none"
+const char *aesgcm_ce_impl(void);
+
+#endif // AESGCM_CE_H
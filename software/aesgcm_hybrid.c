@@ -0,0 +1,546 @@
+#include "aesgcm_hybrid.h"
+#include "KR260_ioctl.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Both paths are timed at a few message sizes when the dispatcher starts, giving a piecewise
+ * linear size-to-time model per path. A batch is then assigned job by job, earliest finish first:
+ * a job goes to the IP queue or the CPU pool depending on which would complete it sooner given
+ * the work already assigned to it. The IP queues run on their own threads (one per core the
+ * driver exposes) while the caller runs the CPU share through aesgcm_pool, so both paths are busy
+ * at the same time. The CPU model is measured through the pool itself, so one CPU job costs its
+ * time divided by the parallelism the pool actually achieved.
+ *
+ * The models assume the IP adds capacity, which is not true when submitting to it costs the CPU
+ * as much as the software path (the simulator, or a host short of cores). A mixed batch is
+ * therefore also run CPU-only and split, and the IP only takes jobs when the split was faster.
+ */
+
+#define HYBRID_HW_THREADS   8
+#define HYBRID_MODEL_POINTS 8
+#define HYBRID_CAL_NS       20000000    /* Time spent measuring each size */
+#define HYBRID_CAL_AAD      16
+#define HYBRID_CAL_BYTES    (4 << 20)   /* Output buffer of a CPU calibration batch */
+#define HYBRID_SPLIT_JOBS   4096        /* Mixed batch deciding whether the IP takes jobs */
+#define HYBRID_SPLIT_ROUNDS 3
+#define HYBRID_SPLIT_GAIN   1.02        /* Speedup over CPU-only the split must show */
+
+static const size_t hw_cal_sizes[] = { 64, 512, 1024, AESGCM_HYBRID_HW_MAX };
+static const size_t cpu_cal_sizes[] = { 64, 512, 2048, 16384, 131072 };
+
+/* Nanoseconds per message at total (AAD + payload) sizes x, interpolated in between */
+struct hybrid_model {
+    int    n;
+    double x[HYBRID_MODEL_POINTS];
+    double ns[HYBRID_MODEL_POINTS];
+};
+
+struct hybrid_item {
+    size_t job;
+    int    handle;      /* Registered key of the job */
+};
+
+struct hybrid_hw {
+    struct aesgcm_hybrid *h;
+    pthread_t             thread;
+    struct hybrid_item   *items;
+    size_t                count;
+    size_t                capacity;
+};
+
+struct hybrid_key {
+    uint8_t       key[32];
+    int           handle;
+    uint64_t      used;         /* Last use, for least recently used eviction */
+    unsigned long batch;        /* Last batch queuing a job with the key on the IP */
+};
+
+struct aesgcm_hybrid {
+    struct aesgcm_pool *pool;
+    struct hybrid_model model[AESGCM_HYBRID_PATHS];
+    uint64_t            counts[AESGCM_HYBRID_PATHS];
+
+    int                 hw_threads;     /* 0 when the IP cannot be used */
+    int                 hw_route;       /* IP takes jobs without AESGCM_HYBRID_HW_ONLY */
+    struct hybrid_hw    hw[HYBRID_HW_THREADS];
+    struct hybrid_key   keys[AESGCM_HYBRID_KEYS];
+    int                 nkeys;
+    uint64_t            key_uses;
+    unsigned long       batch;          /* Batches assigned so far */
+
+    pthread_mutex_t     lock;
+    pthread_cond_t      start;
+    pthread_cond_t      done;
+    unsigned long       gen;
+    int                 stop;
+    int                 busy;           /* IP threads still running the batch */
+
+    struct aesgcm_job  *jobs;
+    struct aesgcm_job  *cpu_jobs;       /* CPU share of the batch, copied back afterwards */
+    size_t             *cpu_map;
+    size_t              cpu_capacity;
+};
+
+static uint64_t hybrid_ns(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+static double model_eval(const struct hybrid_model *m, double x)
+{
+    int i = 1;
+
+    if (m->n == 1) {
+        return m->ns[0] * x / m->x[0];
+    }
+    // Segment containing x, the first or last one extrapolated
+    while (i < m->n - 1 && x > m->x[i]) {
+        i++;
+    }
+    return m->ns[i - 1] + (m->ns[i] - m->ns[i - 1]) * (x - m->x[i - 1]) / (m->x[i] - m->x[i - 1]);
+}
+
+// Whether jobs of a batch run with flags may go to the IP at all
+static int hw_allowed(const struct aesgcm_hybrid *h, int flags)
+{
+    return h->hw_threads && !(flags & AESGCM_HYBRID_CPU_ONLY) && (h->hw_route || (flags & AESGCM_HYBRID_HW_ONLY));
+}
+
+static int hw_fits(size_t aad_len, size_t len)
+{
+    return len > 0 && ((aad_len + 15) & ~(size_t)15) + len <= AESGCM_HYBRID_HW_MAX;
+}
+
+double aesgcm_hybrid_cost(const struct aesgcm_hybrid *h, enum aesgcm_hybrid_path path,
+                          size_t aad_len, size_t len)
+{
+    double ns;
+
+    if (path == AESGCM_HYBRID_HW && (!h->hw_threads || !hw_fits(aad_len, len))) {
+        return 0.0;
+    }
+    ns = model_eval(&h->model[path], (double)(aad_len + len));
+    return ns > 1.0 ? ns : 1.0;
+}
+
+// Handle of key, registered with the driver on first use. A full cache evicts the least recently
+// used key no IP queue of the current batch refers to. -1 when every key is in use or it fails
+static int hybrid_handle(struct aesgcm_hybrid *h, const uint8_t *key)
+{
+    struct hybrid_key *slot = NULL;
+    int handle;
+
+    for (int k = 0; k < h->nkeys; k++) {
+        if (memcmp(h->keys[k].key, key, 32) == 0) {
+            slot = &h->keys[k];
+            goto hit;
+        }
+    }
+
+    if (h->nkeys < AESGCM_HYBRID_KEYS) {
+        slot = &h->keys[h->nkeys];
+    } else {
+        for (int k = 0; k < h->nkeys; k++) {
+            if (h->keys[k].batch != h->batch && (!slot || h->keys[k].used < slot->used)) {
+                slot = &h->keys[k];
+            }
+        }
+        if (!slot) {
+            return -1;
+        }
+        // The IP threads are idle while a batch is assigned, nothing runs with the old handle
+        aes_key_unregister((uint32_t)slot->handle);
+        *slot = h->keys[--h->nkeys];
+        slot = &h->keys[h->nkeys];
+    }
+    if ((handle = aes_key_register(key)) < 0) {
+        return -1;
+    }
+    memcpy(slot->key, key, 32);
+    slot->handle = handle;
+    h->nkeys++;
+
+hit:
+    slot->used = ++h->key_uses;
+    slot->batch = h->batch;
+    return slot->handle;
+}
+
+static int hw_exec(struct aesgcm_job *job, int handle)
+{
+    errno = 0;
+    if (aes_gcm_run_key((uint32_t)handle, job->decrypt ? AES_MODE_DECRYPT : AES_MODE_ENCRYPT, job->iv,
+                        job->aad, (uint32_t)job->aad_len, job->in, job->out, (uint32_t)job->len, job->tag) < 0) {
+        return errno ? errno : EIO;
+    }
+    return 0;
+}
+
+static void *hw_thread(void *arg)
+{
+    struct hybrid_hw *hw = arg;
+    struct aesgcm_hybrid *h = hw->h;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&h->lock);
+    for (;;) {
+        while (h->gen == seen && !h->stop) {
+            pthread_cond_wait(&h->start, &h->lock);
+        }
+        if (h->stop) {
+            break;
+        }
+        seen = h->gen;
+        pthread_mutex_unlock(&h->lock);
+
+        for (size_t i = 0; i < hw->count; i++) {
+            struct aesgcm_job *job = &h->jobs[hw->items[i].job];
+
+            job->status = hw_exec(job, hw->items[i].handle);
+        }
+
+        pthread_mutex_lock(&h->lock);
+        if (--h->busy == 0) {
+            pthread_cond_signal(&h->done);
+        }
+    }
+    pthread_mutex_unlock(&h->lock);
+    return NULL;
+}
+
+// Single-core IP time per message of each calibration size
+static int calibrate_hw(struct aesgcm_hybrid *h)
+{
+    uint8_t key[32], iv[12] = { 0 }, aad[HYBRID_CAL_AAD] = { 0 }, tag[16];
+    uint8_t in[AESGCM_HYBRID_HW_MAX] = { 0 }, out[AESGCM_HYBRID_HW_MAX];
+    int handle;
+
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(0x5A ^ i);
+    handle = aes_key_register(key);
+    if (handle < 0) {
+        return -1;
+    }
+
+    for (size_t s = 0; s < sizeof(hw_cal_sizes) / sizeof(hw_cal_sizes[0]); s++) {
+        size_t len = hw_cal_sizes[s] - HYBRID_CAL_AAD;
+        uint64_t start = hybrid_ns(), ops = 0;
+
+        do {
+            if (aes_gcm_run_key((uint32_t)handle, AES_MODE_ENCRYPT, iv, aad, HYBRID_CAL_AAD, in, out,
+                                (uint32_t)len, tag) < 0) {
+                aes_key_unregister((uint32_t)handle);
+                return -1;
+            }
+            ops++;
+        } while (hybrid_ns() - start < HYBRID_CAL_NS);
+
+        h->model[AESGCM_HYBRID_HW].x[s] = (double)hw_cal_sizes[s];
+        h->model[AESGCM_HYBRID_HW].ns[s] = (double)(hybrid_ns() - start) / ops;
+        h->model[AESGCM_HYBRID_HW].n = (int)s + 1;
+    }
+    aes_key_unregister((uint32_t)handle);
+    return 0;
+}
+
+// Pool batch time per message: the CPU path's cost with all of its workers busy
+static int calibrate_cpu(struct aesgcm_hybrid *h)
+{
+    uint8_t key[32], iv[12] = { 0 }, aad[HYBRID_CAL_AAD] = { 0 };
+    size_t max = cpu_cal_sizes[sizeof(cpu_cal_sizes) / sizeof(cpu_cal_sizes[0]) - 1];
+    size_t max_jobs = HYBRID_CAL_BYTES / cpu_cal_sizes[0];
+    struct aesgcm_job *jobs = calloc(max_jobs, sizeof(*jobs));
+    uint8_t *in = calloc(1, max), *out = malloc(HYBRID_CAL_BYTES);
+    int ret = -1;
+
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(0x5A ^ i);
+    if (!jobs || !in || !out) {
+        goto out;
+    }
+
+    for (size_t s = 0; s < sizeof(cpu_cal_sizes) / sizeof(cpu_cal_sizes[0]); s++) {
+        size_t len = cpu_cal_sizes[s] - HYBRID_CAL_AAD;
+        size_t n = HYBRID_CAL_BYTES / cpu_cal_sizes[s];
+        uint64_t start, elapsed, ops = 0;
+
+        for (size_t i = 0; i < n; i++) {
+            jobs[i] = (struct aesgcm_job){
+                .key = key, .iv = iv, .aad = aad, .aad_len = HYBRID_CAL_AAD,
+                .in = in, .out = out + i * len, .len = len,
+            };
+        }
+        start = hybrid_ns();
+        do {
+            if (aesgcm_pool_run(h->pool, jobs, n, 0, NULL, NULL) != 0) {
+                goto out;
+            }
+            ops += n;
+            elapsed = hybrid_ns() - start;
+        } while (elapsed < HYBRID_CAL_NS);
+
+        h->model[AESGCM_HYBRID_CPU].x[s] = (double)cpu_cal_sizes[s];
+        h->model[AESGCM_HYBRID_CPU].ns[s] = (double)elapsed / ops;
+        h->model[AESGCM_HYBRID_CPU].n = (int)s + 1;
+    }
+    ret = 0;
+
+out:
+    free(out);
+    free(in);
+    free(jobs);
+    return ret;
+}
+
+// Best time of a batch over HYBRID_SPLIT_ROUNDS runs, 0 on failure
+static uint64_t split_time(struct aesgcm_hybrid *h, struct aesgcm_job *jobs, size_t n, int flags)
+{
+    uint64_t best = 0, start, elapsed;
+
+    for (int r = 0; r < HYBRID_SPLIT_ROUNDS; r++) {
+        start = hybrid_ns();
+        if (aesgcm_hybrid_run(h, jobs, n, flags) != 0) {
+            return 0;
+        }
+        elapsed = hybrid_ns() - start;
+        if (best == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+// Route jobs to the IP only when a mixed batch split over both paths beats the CPU pool alone
+static int calibrate_split(struct aesgcm_hybrid *h)
+{
+    uint8_t key[32], iv[12] = { 0 }, aad[HYBRID_CAL_AAD] = { 0 };
+    size_t nsizes = sizeof(hw_cal_sizes) / sizeof(hw_cal_sizes[0]);
+    struct aesgcm_job *jobs = calloc(HYBRID_SPLIT_JOBS, sizeof(*jobs));
+    uint8_t *in = calloc(1, AESGCM_HYBRID_HW_MAX);
+    uint8_t *out = malloc((size_t)HYBRID_SPLIT_JOBS * AESGCM_HYBRID_HW_MAX);
+    uint64_t cpu_ns, split_ns;
+    int ret = -1;
+
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(0x5A ^ i);
+    if (!jobs || !in || !out) {
+        goto out;
+    }
+    for (size_t i = 0; i < HYBRID_SPLIT_JOBS; i++) {
+        jobs[i] = (struct aesgcm_job){
+            .key = key, .iv = iv, .aad = aad, .aad_len = HYBRID_CAL_AAD, .in = in,
+            .out = out + i * AESGCM_HYBRID_HW_MAX, .len = hw_cal_sizes[i % nsizes] - HYBRID_CAL_AAD,
+        };
+    }
+
+    h->hw_route = 1;
+    cpu_ns = split_time(h, jobs, HYBRID_SPLIT_JOBS, AESGCM_HYBRID_CPU_ONLY);
+    split_ns = split_time(h, jobs, HYBRID_SPLIT_JOBS, 0);
+    if (cpu_ns && split_ns) {
+        h->hw_route = split_ns * HYBRID_SPLIT_GAIN < cpu_ns;
+        ret = 0;
+    }
+
+out:
+    // Calibration jobs are not counted and their key is not kept
+    for (int k = 0; k < h->nkeys; k++) {
+        aes_key_unregister((uint32_t)h->keys[k].handle);
+    }
+    h->nkeys = 0;
+    memset(h->counts, 0, sizeof(h->counts));
+    free(out);
+    free(in);
+    free(jobs);
+    return ret;
+}
+
+struct aesgcm_hybrid *aesgcm_hybrid_create(int cpu_threads)
+{
+    struct aesgcm_hybrid *h = calloc(1, sizeof(*h));
+    int cores;
+
+    if (!h) {
+        return NULL;
+    }
+    pthread_mutex_init(&h->lock, NULL);
+    pthread_cond_init(&h->start, NULL);
+    pthread_cond_init(&h->done, NULL);
+
+    h->pool = aesgcm_pool_create(cpu_threads);
+    if (!h->pool || calibrate_cpu(h) < 0) {
+        aesgcm_hybrid_destroy(h);
+        return NULL;
+    }
+
+    // One submitting thread per IP core, the driver spreads concurrent operations over them
+    if (calibrate_hw(h) == 0) {
+        cores = aes_device_count();
+        cores = cores < 1 ? 1 : (cores > HYBRID_HW_THREADS ? HYBRID_HW_THREADS : cores);
+        for (int t = 0; t < cores; t++) {
+            h->hw[t].h = h;
+            if (pthread_create(&h->hw[t].thread, NULL, hw_thread, &h->hw[t]) != 0) {
+                break;
+            }
+            h->hw_threads = t + 1;
+        }
+    }
+    if (h->hw_threads && calibrate_split(h) < 0) {
+        h->hw_route = 0;
+    }
+    return h;
+}
+
+// Earliest finish assignment of every job, filling the IP queues and the CPU share
+static int hybrid_assign(struct aesgcm_hybrid *h, struct aesgcm_job *jobs, size_t n, int flags, size_t *ncpu)
+{
+    double hw_backlog[HYBRID_HW_THREADS] = { 0 }, cpu_backlog = 0.0;
+
+    *ncpu = 0;
+    h->batch++;
+    for (int t = 0; t < h->hw_threads; t++) {
+        h->hw[t].count = 0;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        struct aesgcm_job *job = &jobs[i];
+        double cpu = cpu_backlog + aesgcm_hybrid_cost(h, AESGCM_HYBRID_CPU, job->aad_len, job->len);
+        double hw_cost = aesgcm_hybrid_cost(h, AESGCM_HYBRID_HW, job->aad_len, job->len);
+        int best = -1, handle;
+
+        if (hw_cost > 0.0) {
+            for (int t = 0; t < h->hw_threads; t++) {
+                if ((flags & AESGCM_HYBRID_HW_ONLY) || hw_backlog[t] + hw_cost < cpu) {
+                    if (best < 0 || hw_backlog[t] < hw_backlog[best]) {
+                        best = t;
+                    }
+                }
+            }
+        }
+        if (best >= 0 && (handle = hybrid_handle(h, job->key)) >= 0) {
+            struct hybrid_hw *hw = &h->hw[best];
+
+            if (hw->count == hw->capacity) {
+                size_t capacity = hw->capacity ? 2 * hw->capacity : 256;
+                struct hybrid_item *items = realloc(hw->items, capacity * sizeof(*items));
+
+                if (!items) {
+                    return -1;
+                }
+                hw->items = items;
+                hw->capacity = capacity;
+            }
+            hw->items[hw->count++] = (struct hybrid_item){ .job = i, .handle = handle };
+            hw_backlog[best] += hw_cost;
+            h->counts[AESGCM_HYBRID_HW]++;
+        } else {
+            h->cpu_jobs[*ncpu] = *job;
+            h->cpu_map[(*ncpu)++] = i;
+            cpu_backlog = cpu;
+            h->counts[AESGCM_HYBRID_CPU]++;
+        }
+    }
+    return 0;
+}
+
+int aesgcm_hybrid_run(struct aesgcm_hybrid *h, struct aesgcm_job *jobs, size_t n, int flags)
+{
+    int failed = 0, hw_busy = 0;
+    size_t ncpu;
+
+    // Nothing can go to the IP: the whole batch runs on the pool in place, as aesgcm_pool_run
+    if (!hw_allowed(h, flags)) {
+        h->counts[AESGCM_HYBRID_CPU] += n;
+        return aesgcm_pool_run(h->pool, jobs, n, 0, NULL, NULL);
+    }
+
+    if (n > h->cpu_capacity) {
+        struct aesgcm_job *cpu_jobs = realloc(h->cpu_jobs, n * sizeof(*cpu_jobs));
+        size_t *cpu_map;
+
+        if (!cpu_jobs) {
+            return -1;
+        }
+        h->cpu_jobs = cpu_jobs;
+        cpu_map = realloc(h->cpu_map, n * sizeof(*cpu_map));
+        if (!cpu_map) {
+            return -1;
+        }
+        h->cpu_map = cpu_map;
+        h->cpu_capacity = n;
+    }
+    if (hybrid_assign(h, jobs, n, flags, &ncpu) < 0) {
+        return -1;
+    }
+
+    // Start the IP queues, then run the CPU share on the pool meanwhile
+    for (int t = 0; t < h->hw_threads; t++) {
+        hw_busy |= h->hw[t].count != 0;
+    }
+    if (hw_busy) {
+        pthread_mutex_lock(&h->lock);
+        h->jobs = jobs;
+        h->busy = h->hw_threads;
+        h->gen++;
+        pthread_cond_broadcast(&h->start);
+        pthread_mutex_unlock(&h->lock);
+    }
+    if (ncpu && aesgcm_pool_run(h->pool, h->cpu_jobs, ncpu, 0, NULL, NULL) < 0) {
+        for (size_t k = 0; k < ncpu; k++) {
+            h->cpu_jobs[k].status = EIO;
+        }
+    }
+    if (hw_busy) {
+        pthread_mutex_lock(&h->lock);
+        while (h->busy) {
+            pthread_cond_wait(&h->done, &h->lock);
+        }
+        pthread_mutex_unlock(&h->lock);
+    }
+
+    for (size_t k = 0; k < ncpu; k++) {
+        jobs[h->cpu_map[k]] = h->cpu_jobs[k];
+    }
+    for (size_t i = 0; i < n; i++) {
+        failed += jobs[i].status != 0;
+    }
+    return failed;
+}
+
+int aesgcm_hybrid_hw_routed(const struct aesgcm_hybrid *h)
+{
+    return h->hw_route;
+}
+
+void aesgcm_hybrid_counts(const struct aesgcm_hybrid *h, uint64_t counts[AESGCM_HYBRID_PATHS])
+{
+    memcpy(counts, h->counts, sizeof(h->counts));
+}
+
+void aesgcm_hybrid_destroy(struct aesgcm_hybrid *h)
+{
+    pthread_mutex_lock(&h->lock);
+    h->stop = 1;
+    pthread_cond_broadcast(&h->start);
+    pthread_mutex_unlock(&h->lock);
+    for (int t = 0; t < h->hw_threads; t++) {
+        pthread_join(h->hw[t].thread, NULL);
+        free(h->hw[t].items);
+    }
+    for (int k = 0; k < h->nkeys; k++) {
+        aes_key_unregister((uint32_t)h->keys[k].handle);
+    }
+
+    if (h->pool) {
+        aesgcm_pool_destroy(h->pool);
+    }
+    pthread_cond_destroy(&h->done);
+    pthread_cond_destroy(&h->start);
+    pthread_mutex_destroy(&h->lock);
+    free(h->cpu_map);
+    free(h->cpu_jobs);
+    free(h);
+}
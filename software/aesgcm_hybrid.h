@@ -0,0 +1,50 @@
+#ifndef AESGCM_HYBRID_H
+#define AESGCM_HYBRID_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "aesgcm_pool.h"
+
+#define AESGCM_HYBRID_HW_MAX    2048        /* AAD padded to 16 plus payload, one IP operation */
+#define AESGCM_HYBRID_KEYS      16          /* Keys registered with the driver at a time */
+
+#define AESGCM_HYBRID_CPU_ONLY  (1 << 0)    /* Route every job to the CPU pool */
+#define AESGCM_HYBRID_HW_ONLY   (1 << 1)    /* Route every job the IP can take to the IP */
+
+enum aesgcm_hybrid_path {
+    AESGCM_HYBRID_HW,
+    AESGCM_HYBRID_CPU,
+    AESGCM_HYBRID_PATHS
+};
+
+struct aesgcm_hybrid;
+
+// Open the IP through the KR260 access layer and start cpu_threads CPU workers (online CPUs when
+// <= 0), then time both paths at several sizes and a mixed batch CPU-only and split. Without a
+// usable IP, or when the split is not faster than the CPU alone, every job goes to the CPU.
+// Return NULL on error
+struct aesgcm_hybrid *aesgcm_hybrid_create(int cpu_threads);
+
+// Estimated nanoseconds for the path to finish one message of aad_len + len bytes, as seen by a
+// job queued behind others (the CPU estimate accounts for its workers running in parallel).
+// 0 when the path cannot take the message
+double aesgcm_hybrid_cost(const struct aesgcm_hybrid *h, enum aesgcm_hybrid_path path,
+                          size_t aad_len, size_t len);
+
+// Run a batch and wait for it. Each job goes to the path that would finish it first given the work
+// already queued on both, and the two paths run at the same time. Jobs are those of aesgcm_pool.
+// Up to AESGCM_HYBRID_KEYS keys stay registered with the driver, the least recently used one is
+// replaced by a new key; jobs with more distinct keys than that in one batch run on the CPU, even
+// with AESGCM_HYBRID_HW_ONLY. Return the number of jobs with a non-zero status, or -1 on error
+int aesgcm_hybrid_run(struct aesgcm_hybrid *h, struct aesgcm_job *jobs, size_t n, int flags);
+
+// Nonzero when jobs are routed to the IP without AESGCM_HYBRID_HW_ONLY
+int aesgcm_hybrid_hw_routed(const struct aesgcm_hybrid *h);
+
+// Jobs run on each path since aesgcm_hybrid_create
+void aesgcm_hybrid_counts(const struct aesgcm_hybrid *h, uint64_t counts[AESGCM_HYBRID_PATHS]);
+
+// Stop the workers, drop the registered keys and free the dispatcher
+void aesgcm_hybrid_destroy(struct aesgcm_hybrid *h);
+
+#endif // AESGCM_HYBRID_H
@@ -0,0 +1,227 @@
+#include "aesgcm_large.h"
+#include "ghash.h"
+#include "KR260_ioctl.h"
+#include <pthread.h>
+#include <openssl/evp.h>
+#include <openssl/crypto.h>
+
+/*
+ * GCM splits into CTR encryption and GHASH over the ciphertext. The IP exposes only the 96-bit IV,
+ * its block counter always starts at 2, so it can produce the keystream of counters 2..129 (the
+ * first 2 KB) and nothing beyond. That window comes from one AES_IOC_GCM_RUN with no AAD, the rest
+ * from CTR on the CPU starting at counter 130. The hardware tag is discarded and GHASH runs on a
+ * second thread that trails the ciphertext as it is produced (or, for decryption, the input).
+ */
+
+struct ghash_job {
+    struct ghash_ctx ctx;
+    const uint8_t   *aad;
+    size_t           aad_len;
+    const uint8_t   *ct;
+    size_t           len;
+    size_t           ready;     /* Ciphertext bytes available for hashing */
+    int              failed;    /* Producer gave up, stop hashing */
+    pthread_mutex_t  lock;
+    pthread_cond_t   cond;
+};
+
+static void *ghash_thread(void *arg)
+{
+    struct ghash_job *job = arg;
+    size_t done = 0;
+
+    ghash_update_aad(&job->ctx, job->aad, job->aad_len);
+    while (done < job->len) {
+        size_t ready;
+
+        pthread_mutex_lock(&job->lock);
+        while (job->ready == done && !job->failed) {
+            pthread_cond_wait(&job->cond, &job->lock);
+        }
+        ready = job->ready;
+        pthread_mutex_unlock(&job->lock);
+        if (job->failed) {
+            break;
+        }
+
+        // Only the final update may end in a partial block
+        if (ready < job->len) {
+            ready &= ~(size_t)(GHASH_BLOCK_SIZE - 1);
+        }
+        ghash_update(&job->ctx, job->ct + done, ready - done);
+        done = ready;
+    }
+    return NULL;
+}
+
+static void ghash_publish(struct ghash_job *job, size_t ready, int failed)
+{
+    pthread_mutex_lock(&job->lock);
+    job->ready = ready;
+    job->failed = failed;
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+}
+
+// One AES-256 block encryption, for H = E(K, 0) and E(K, J0)
+static int aes_block(const uint8_t key[32], const uint8_t in[16], uint8_t out[16])
+{
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    int len, ok;
+
+    if (!ctx) {
+        return -1;
+    }
+    ok = EVP_EncryptInit_ex(ctx, EVP_aes_256_ecb(), NULL, key, NULL) == 1 &&
+         EVP_CIPHER_CTX_set_padding(ctx, 0) == 1 &&
+         EVP_EncryptUpdate(ctx, out, &len, in, 16) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok ? 0 : -1;
+}
+
+/*
+ * XOR in with the keystream of IV || counter, counter starting at first_ctr and incremented per block.
+ * With a 96-bit IV the low 32 bits start at 2 and reach at most 2^32 - 1 below the GCM length limit,
+ * so the 128-bit increment of EVP CTR matches GCM's inc32. Progress goes to job every chunk.
+ */
+static int ctr_xor(const uint8_t key[32], const uint8_t iv[12], uint32_t first_ctr,
+                   const uint8_t *in, uint8_t *out, size_t len, size_t base, struct ghash_job *job)
+{
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    uint8_t block[16];
+    size_t pos = 0;
+    int outl;
+
+    if (!ctx) {
+        return -1;
+    }
+    memcpy(block, iv, 12);
+    block[12] = (uint8_t)(first_ctr >> 24);
+    block[13] = (uint8_t)(first_ctr >> 16);
+    block[14] = (uint8_t)(first_ctr >> 8);
+    block[15] = (uint8_t)first_ctr;
+    if (EVP_EncryptInit_ex(ctx, EVP_aes_256_ctr(), NULL, key, block) != 1) {
+        EVP_CIPHER_CTX_free(ctx);
+        return -1;
+    }
+
+    while (pos < len) {
+        size_t n = len - pos < AESGCM_LARGE_CHUNK ? len - pos : AESGCM_LARGE_CHUNK;
+
+        if (EVP_EncryptUpdate(ctx, out + pos, &outl, in + pos, (int)n) != 1) {
+            EVP_CIPHER_CTX_free(ctx);
+            return -1;
+        }
+        pos += n;
+        if (job) {
+            ghash_publish(job, base + pos, 0);
+        }
+    }
+    EVP_CIPHER_CTX_free(ctx);
+    return 0;
+}
+
+// Shared encrypt/decrypt path, tag receives E(K, J0) xor S
+static int aesgcm_large_run(int decrypt, const uint8_t key[32], const uint8_t iv[12],
+                            const uint8_t *aad, size_t aad_len,
+                            const uint8_t *in, uint8_t *out, size_t len,
+                            uint8_t tag[16], int use_hw)
+{
+    static const uint8_t zero[16];
+    struct ghash_job job;
+    pthread_t thread;
+    int threaded = len >= AESGCM_LARGE_THREAD_MIN;
+    uint8_t h[16], j0[16], s[16], hw_tag[16];
+    size_t head = 0;
+    int ret = -1;
+
+    if (len > ((uint64_t)1 << 36) - 32) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    if (aes_block(key, zero, h) < 0) {
+        return -1;
+    }
+    memcpy(j0, iv, 12);
+    j0[12] = j0[13] = j0[14] = 0;
+    j0[15] = 1;
+    if (aes_block(key, j0, j0) < 0) {
+        return -1;
+    }
+
+    memset(&job, 0, sizeof(job));
+    ghash_init(&job.ctx, h);
+    job.aad = aad;
+    job.aad_len = aad_len;
+    job.ct = decrypt ? in : out;
+    job.len = len;
+    // Decryption hashes the input, all of it is ready from the start
+    job.ready = decrypt ? len : 0;
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.cond, NULL);
+    if (threaded && pthread_create(&thread, NULL, ghash_thread, &job) != 0) {
+        threaded = 0;
+    }
+
+    // First window on the IP: with no AAD the payload starts at counter 2, CTR is the same both ways
+    if (use_hw && len) {
+        head = len < AESGCM_LARGE_WINDOW ? len : AESGCM_LARGE_WINDOW;
+        if (aes_gcm_run(AES_MODE_ENCRYPT, key, iv, NULL, 0, in, out, (uint32_t)head, hw_tag) < 0) {
+            goto out;
+        }
+        if (threaded && !decrypt) {
+            ghash_publish(&job, head, 0);
+        }
+    }
+    if (ctr_xor(key, iv, 2 + (uint32_t)(head / 16), in + head, out + head, len - head, head,
+                threaded && !decrypt ? &job : NULL) < 0) {
+        goto out;
+    }
+    ret = 0;
+
+out:
+    if (threaded) {
+        if (ret < 0) {
+            ghash_publish(&job, job.ready, 1);
+        }
+        pthread_join(thread, NULL);
+    } else if (ret == 0) {
+        job.ready = len;
+        ghash_thread(&job);
+    }
+    if (ret == 0) {
+        ghash_final(&job.ctx, s);
+        for (int i = 0; i < 16; i++) {
+            tag[i] = j0[i] ^ s[i];
+        }
+    }
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.lock);
+    return ret;
+}
+
+int aesgcm_large_encrypt(const uint8_t key[32], const uint8_t iv[12],
+                         const uint8_t *aad, size_t aad_len,
+                         const uint8_t *in, uint8_t *out, size_t len,
+                         uint8_t tag[16], int use_hw)
+{
+    return aesgcm_large_run(0, key, iv, aad, aad_len, in, out, len, tag, use_hw);
+}
+
+int aesgcm_large_decrypt(const uint8_t key[32], const uint8_t iv[12],
+                         const uint8_t *aad, size_t aad_len,
+                         const uint8_t *in, uint8_t *out, size_t len,
+                         const uint8_t tag[16], int use_hw)
+{
+    uint8_t computed[16];
+
+    if (aesgcm_large_run(1, key, iv, aad, aad_len, in, out, len, computed, use_hw) < 0) {
+        return -1;
+    }
+    if (CRYPTO_memcmp(computed, tag, 16) != 0) {
+        memset(out, 0, len);
+        errno = EBADMSG;
+        return -1;
+    }
+    return 0;
+}
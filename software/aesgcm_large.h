@@ -0,0 +1,26 @@
+#ifndef AESGCM_LARGE_H
+#define AESGCM_LARGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define AESGCM_LARGE_WINDOW     2048        /* Payload bytes the IP can run in one operation without AAD */
+#define AESGCM_LARGE_CHUNK      65536       /* CTR bytes produced before the GHASH thread is signalled */
+#define AESGCM_LARGE_THREAD_MIN 262144      /* Messages from this size hash on a second thread */
+
+// AES-256-GCM with a 96-bit IV for messages of any length (up to 2^36 - 32 bytes).
+// With use_hw=1 the IP produces the keystream of the first window, the rest comes from the CPU;
+// GHASH is always computed on the CPU, in parallel with the keystream for large messages.
+// Return 0, or -1 on error
+int aesgcm_large_encrypt(const uint8_t key[32], const uint8_t iv[12],
+                         const uint8_t *aad, size_t aad_len,
+                         const uint8_t *in, uint8_t *out, size_t len,
+                         uint8_t tag[16], int use_hw);
+
+// Same for decryption. Return 0, or -1 with errno=EBADMSG and out zeroed when the tag does not match
+int aesgcm_large_decrypt(const uint8_t key[32], const uint8_t iv[12],
+                         const uint8_t *aad, size_t aad_len,
+                         const uint8_t *in, uint8_t *out, size_t len,
+                         const uint8_t tag[16], int use_hw);
+
+#endif // AESGCM_LARGE_H
@@ -0,0 +1,315 @@
+#include "aesgcm_pool.h"
+#include "aesgcm_session.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * A batch is split into one contiguous slice of job indices per worker. The owner takes jobs from
+ * the front of its slice, so neighbouring jobs finish close together for ordered delivery, and an
+ * idle worker steals from the back of another slice, away from the owner. Each worker keeps an
+ * aesgcm_session and only reloads the key schedule when a job's key differs from the previous one.
+ */
+
+struct pool_queue {
+    pthread_mutex_t lock;
+    size_t         *idx;        /* Slice of pool->slots */
+    size_t          head;       /* Next job of the owner */
+    size_t          tail;       /* One past the next job to steal */
+};
+
+struct pool_worker {
+    struct aesgcm_pool   *pool;
+    pthread_t             thread;
+    int                   id;
+    struct pool_queue     q;
+    struct aesgcm_session sess;
+    uint8_t               key[32];  /* Key loaded in sess */
+    int                   keyed;
+};
+
+struct aesgcm_pool {
+    int                 nthreads;
+    struct pool_worker *workers;
+    size_t             *slots;      /* Job indices of the batch */
+    uint8_t            *finished;   /* Ordered delivery: job done, callback pending */
+    size_t              capacity;   /* Entries of slots and finished */
+
+    pthread_mutex_t     lock;
+    pthread_cond_t      start;      /* A batch is ready, or stop */
+    pthread_cond_t      done;       /* Batch finished and no worker is still in it */
+    unsigned long       gen;        /* Batch number */
+    int                 stop;
+    int                 active;     /* Workers inside the current batch */
+
+    struct aesgcm_job  *jobs;
+    int                 flags;
+    aesgcm_pool_cb      cb;
+    void               *arg;
+    atomic_size_t       remaining;
+    atomic_int          failed;
+
+    pthread_mutex_t     deliver_lock;
+    size_t              next;       /* Next job to deliver in order */
+    size_t              n;
+};
+
+static int take_own(struct pool_queue *q, size_t *i)
+{
+    int ok;
+
+    pthread_mutex_lock(&q->lock);
+    ok = q->head < q->tail;
+    if (ok) {
+        *i = q->idx[q->head++];
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+static int steal(struct pool_queue *q, size_t *i)
+{
+    int ok;
+
+    pthread_mutex_lock(&q->lock);
+    ok = q->head < q->tail;
+    if (ok) {
+        *i = q->idx[--q->tail];
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+// Next job for w, from its own slice or stolen from the others, 0 when the batch is drained
+static int next_job(struct pool_worker *w, size_t *i)
+{
+    struct aesgcm_pool *pool = w->pool;
+
+    if (take_own(&w->q, i)) {
+        return 1;
+    }
+    for (int k = 1; k < pool->nthreads; k++) {
+        if (steal(&pool->workers[(w->id + k) % pool->nthreads].q, i)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int run_job(struct pool_worker *w, struct aesgcm_job *job)
+{
+    int ret;
+
+    if (!w->keyed || memcmp(w->key, job->key, 32) != 0) {
+        ret = w->keyed ? aesgcm_session_rekey(&w->sess, job->key) : aesgcm_session_init(&w->sess, job->key);
+        if (ret < 0) {
+            w->keyed = 0;
+            return EIO;
+        }
+        memcpy(w->key, job->key, 32);
+        w->keyed = 1;
+    }
+
+    errno = 0;
+    if (job->decrypt) {
+        ret = aesgcm_session_decrypt(&w->sess, job->iv, job->aad, job->aad_len, job->in, job->out, job->len,
+                                     job->tag);
+    } else {
+        ret = aesgcm_session_encrypt(&w->sess, job->iv, job->aad, job->aad_len, job->in, job->out, job->len,
+                                     job->tag);
+    }
+    return ret < 0 ? (errno ? errno : EIO) : 0;
+}
+
+static void deliver(struct aesgcm_pool *pool, size_t i)
+{
+    if (!pool->cb) {
+        return;
+    }
+    if (!(pool->flags & AESGCM_POOL_ORDERED)) {
+        pool->cb(&pool->jobs[i], i, pool->arg);
+        return;
+    }
+
+    // Whoever completes the next job in order delivers it and every finished job after it
+    pthread_mutex_lock(&pool->deliver_lock);
+    pool->finished[i] = 1;
+    while (pool->next < pool->n && pool->finished[pool->next]) {
+        pool->cb(&pool->jobs[pool->next], pool->next, pool->arg);
+        pool->next++;
+    }
+    pthread_mutex_unlock(&pool->deliver_lock);
+}
+
+static void *worker_thread(void *arg)
+{
+    struct pool_worker *w = arg;
+    struct aesgcm_pool *pool = w->pool;
+    unsigned long seen = 0;
+    size_t i;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->gen == seen && !pool->stop) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->stop) {
+            break;
+        }
+        seen = pool->gen;
+        pool->active++;
+        pthread_mutex_unlock(&pool->lock);
+
+        while (next_job(w, &i)) {
+            struct aesgcm_job *job = &pool->jobs[i];
+
+            job->status = run_job(w, job);
+            if (job->status) {
+                atomic_fetch_add(&pool->failed, 1);
+            }
+            deliver(pool, i);
+            atomic_fetch_sub(&pool->remaining, 1);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0 && atomic_load(&pool->remaining) == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (w->keyed) {
+        aesgcm_session_free(&w->sess);
+    }
+    return NULL;
+}
+
+struct aesgcm_pool *aesgcm_pool_create(int threads)
+{
+    struct aesgcm_pool *pool;
+
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if (threads > AESGCM_POOL_MAX_THREADS) {
+        threads = AESGCM_POOL_MAX_THREADS;
+    }
+
+    pool = calloc(1, sizeof(*pool));
+    if (!pool) {
+        return NULL;
+    }
+    pool->workers = calloc(threads, sizeof(*pool->workers));
+    if (!pool->workers) {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_mutex_init(&pool->deliver_lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (int t = 0; t < threads; t++) {
+        struct pool_worker *w = &pool->workers[t];
+
+        w->pool = pool;
+        w->id = t;
+        pthread_mutex_init(&w->q.lock, NULL);
+        if (pthread_create(&w->thread, NULL, worker_thread, w) != 0) {
+            pthread_mutex_destroy(&w->q.lock);
+            pool->nthreads = t;
+            aesgcm_pool_destroy(pool);
+            return NULL;
+        }
+        pool->nthreads = t + 1;
+    }
+    return pool;
+}
+
+int aesgcm_pool_threads(const struct aesgcm_pool *pool)
+{
+    return pool->nthreads;
+}
+
+int aesgcm_pool_run(struct aesgcm_pool *pool, struct aesgcm_job *jobs, size_t n, int flags,
+                    aesgcm_pool_cb cb, void *arg)
+{
+    if (!n) {
+        return 0;
+    }
+    if (n > pool->capacity) {
+        size_t *slots = realloc(pool->slots, n * sizeof(*slots));
+        uint8_t *finished;
+
+        if (!slots) {
+            return -1;
+        }
+        pool->slots = slots;
+        finished = realloc(pool->finished, n);
+        if (!finished) {
+            return -1;
+        }
+        pool->finished = finished;
+        pool->capacity = n;
+    }
+
+    pool->jobs = jobs;
+    pool->flags = flags;
+    pool->cb = cb;
+    pool->arg = arg;
+    pool->n = n;
+    pool->next = 0;
+    memset(pool->finished, 0, n);
+    atomic_store(&pool->remaining, n);
+    atomic_store(&pool->failed, 0);
+
+    for (size_t i = 0; i < n; i++) {
+        pool->slots[i] = i;
+    }
+    for (int t = 0; t < pool->nthreads; t++) {
+        struct pool_queue *q = &pool->workers[t].q;
+        size_t first = n * t / pool->nthreads, last = n * (t + 1) / pool->nthreads;
+
+        pthread_mutex_lock(&q->lock);
+        q->idx = pool->slots + first;
+        q->head = 0;
+        q->tail = last - first;
+        pthread_mutex_unlock(&q->lock);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->gen++;
+    pthread_cond_broadcast(&pool->start);
+    while (atomic_load(&pool->remaining) != 0 || pool->active != 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return atomic_load(&pool->failed);
+}
+
+void aesgcm_pool_destroy(struct aesgcm_pool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int t = 0; t < pool->nthreads; t++) {
+        pthread_join(pool->workers[t].thread, NULL);
+        pthread_mutex_destroy(&pool->workers[t].q.lock);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->deliver_lock);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->finished);
+    free(pool->slots);
+    free(pool->workers);
+    free(pool);
+}
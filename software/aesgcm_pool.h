@@ -0,0 +1,46 @@
+#ifndef AESGCM_POOL_H
+#define AESGCM_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define AESGCM_POOL_MAX_THREADS 64
+#define AESGCM_POOL_ORDERED     (1 << 0)    /* Deliver results in job order */
+
+/* One independent AES-256-GCM message of a batch */
+struct aesgcm_job {
+    const uint8_t *key;     /* 32 bytes */
+    const uint8_t *iv;      /* 12 bytes */
+    const uint8_t *aad;
+    size_t         aad_len;
+    const uint8_t *in;
+    uint8_t       *out;     /* len bytes, may equal in */
+    size_t         len;
+    uint8_t        tag[16]; /* Written by encryption, expected tag for decryption */
+    int            decrypt;
+    int            status;  /* 0, or an errno value (EBADMSG for a tag mismatch) */
+};
+
+// Called once per finished job, from a worker thread. With AESGCM_POOL_ORDERED calls come in job
+// order and never overlap; otherwise in completion order and possibly concurrently
+typedef void (*aesgcm_pool_cb)(struct aesgcm_job *job, size_t index, void *arg);
+
+struct aesgcm_pool;
+
+// Start threads workers (online CPUs when threads <= 0), each with its own cipher contexts.
+// Return NULL on error
+struct aesgcm_pool *aesgcm_pool_create(int threads);
+
+// Number of worker threads
+int aesgcm_pool_threads(const struct aesgcm_pool *pool);
+
+// Run a batch and wait for it. Jobs are split evenly over the workers, a worker that runs out
+// steals from the others. cb may be NULL. One batch at a time per pool.
+// Return the number of jobs with a non-zero status, or -1 on error
+int aesgcm_pool_run(struct aesgcm_pool *pool, struct aesgcm_job *jobs, size_t n, int flags,
+                    aesgcm_pool_cb cb, void *arg);
+
+// Stop the workers and free the pool
+void aesgcm_pool_destroy(struct aesgcm_pool *pool);
+
+#endif // AESGCM_POOL_H
@@ -0,0 +1,96 @@
+#include "aesgcm_session.h"
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <openssl/evp.h>
+
+/*
+ * encrypt() in aesgcm_sw_encrypt.c and decrypt_data() in aesgcm_sw_decrypt.c allocate a context,
+ * look up the cipher and expand the key for every message, which costs more than the GCM work on
+ * short records. A session does that once per direction. Each message then only installs its IV:
+ * EVP_*Init_ex with no cipher and no key keeps the key schedule and the hash key H, and restarts
+ * the counter, the GHASH state and the lengths.
+ */
+
+int aesgcm_session_init(struct aesgcm_session *s, const uint8_t key[32])
+{
+    EVP_CIPHER_CTX *enc = EVP_CIPHER_CTX_new();
+    EVP_CIPHER_CTX *dec = EVP_CIPHER_CTX_new();
+
+    s->enc = s->dec = NULL;
+    if (!enc || !dec ||
+        EVP_EncryptInit_ex(enc, EVP_aes_256_gcm(), NULL, key, NULL) != 1 ||
+        EVP_DecryptInit_ex(dec, EVP_aes_256_gcm(), NULL, key, NULL) != 1) {
+        EVP_CIPHER_CTX_free(enc);
+        EVP_CIPHER_CTX_free(dec);
+        return -1;
+    }
+    s->enc = enc;
+    s->dec = dec;
+    return 0;
+}
+
+int aesgcm_session_rekey(struct aesgcm_session *s, const uint8_t key[32])
+{
+    if (EVP_EncryptInit_ex(s->enc, NULL, NULL, key, NULL) != 1 ||
+        EVP_DecryptInit_ex(s->dec, NULL, NULL, key, NULL) != 1) {
+        return -1;
+    }
+    return 0;
+}
+
+int aesgcm_session_encrypt(struct aesgcm_session *s, const uint8_t iv[12],
+                           const uint8_t *aad, size_t aad_len,
+                           const uint8_t *in, uint8_t *out, size_t len,
+                           uint8_t tag[16])
+{
+    EVP_CIPHER_CTX *ctx = s->enc;
+    int outl;
+
+    // EVP lengths are int, records larger than that belong to aesgcm_large
+    if (aad_len > INT_MAX || len > INT_MAX) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    if (EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, iv) != 1 ||
+        (aad_len && EVP_EncryptUpdate(ctx, NULL, &outl, aad, (int)aad_len) != 1) ||
+        EVP_EncryptUpdate(ctx, out, &outl, in, (int)len) != 1 ||
+        EVP_EncryptFinal_ex(ctx, out + outl, &outl) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16, tag) != 1) {
+        return -1;
+    }
+    return 0;
+}
+
+int aesgcm_session_decrypt(struct aesgcm_session *s, const uint8_t iv[12],
+                           const uint8_t *aad, size_t aad_len,
+                           const uint8_t *in, uint8_t *out, size_t len,
+                           const uint8_t tag[16])
+{
+    EVP_CIPHER_CTX *ctx = s->dec;
+    int outl;
+
+    if (aad_len > INT_MAX || len > INT_MAX) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    if (EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, iv) != 1 ||
+        (aad_len && EVP_DecryptUpdate(ctx, NULL, &outl, aad, (int)aad_len) != 1) ||
+        EVP_DecryptUpdate(ctx, out, &outl, in, (int)len) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, 16, (void *)tag) != 1) {
+        return -1;
+    }
+    if (EVP_DecryptFinal_ex(ctx, out + outl, &outl) != 1) {
+        memset(out, 0, len);
+        errno = EBADMSG;
+        return -1;
+    }
+    return 0;
+}
+
+void aesgcm_session_free(struct aesgcm_session *s)
+{
+    EVP_CIPHER_CTX_free(s->enc);
+    EVP_CIPHER_CTX_free(s->dec);
+    s->enc = s->dec = NULL;
+}
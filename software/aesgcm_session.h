@@ -0,0 +1,34 @@
+#ifndef AESGCM_SESSION_H
+#define AESGCM_SESSION_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* AES-256-GCM contexts of one key, expanded once and reused for every message */
+struct aesgcm_session {
+    void *enc;      /* EVP_CIPHER_CTX with the key schedule, encryption */
+    void *dec;      /* Same for decryption */
+};
+
+// Expand key for both directions. Return 0, or -1 on error
+int aesgcm_session_init(struct aesgcm_session *s, const uint8_t key[32]);
+
+// Replace the key of both contexts without reallocating them. Return 0, or -1 on error
+int aesgcm_session_rekey(struct aesgcm_session *s, const uint8_t key[32]);
+
+// Encrypt one message with a 96-bit IV, only the IV is reset per call. Return 0, or -1 on error
+int aesgcm_session_encrypt(struct aesgcm_session *s, const uint8_t iv[12],
+                           const uint8_t *aad, size_t aad_len,
+                           const uint8_t *in, uint8_t *out, size_t len,
+                           uint8_t tag[16]);
+
+// Same for decryption. Return 0, or -1 with errno=EBADMSG and out zeroed when the tag does not match
+int aesgcm_session_decrypt(struct aesgcm_session *s, const uint8_t iv[12],
+                           const uint8_t *aad, size_t aad_len,
+                           const uint8_t *in, uint8_t *out, size_t len,
+                           const uint8_t tag[16]);
+
+// Free both contexts, the key schedule is cleansed by OpenSSL
+void aesgcm_session_free(struct aesgcm_session *s);
+
+#endif // AESGCM_SESSION_H
@@ -73,7 +73,6 @@
 #define AESKEY_SIZE_INT				8
 #define AESIV_SIZE_HEX				24
 #define AESIV_SIZE_INT				3
-#define DEFAULT_TIMEOUT				2000000
 
 //******************************************************************
 // General function
@@ -208,6 +207,8 @@ void show_data(unsigned int base_addr, unsigned int len)
 {
 
 	unsigned int 			length128;
+	unsigned char			data_in[MEM_SIZE8];
+	unsigned char			data_out[MEM_SIZE8];
 	
 	if ( (len&15)==0 )
 	{
@@ -219,18 +220,22 @@ void show_data(unsigned int base_addr, unsigned int len)
 	
 	if (length128 > MEM_SIZE128) length128 = MEM_SIZE128;
 
+	// read both windows with one block transfer each
+	if (read_block(base_addr, data_in, length128<<4) < 0) return;
+	if (read_block(base_addr+(0x2000), data_out, length128<<4) < 0) return;
+
 	for (unsigned int i=0; i<length128; i++)
 	{
 		gen_printf("%04x:  ", i);
 		for (unsigned int k=0; k<16; k++)
 		{
-			gen_printf("%02x", (unsigned int)(user_read(base_addr+(i<<4)+k , 8))); // cast / update read
+			gen_printf("%02x", (unsigned int)data_in[(i<<4)+k]);
 			if ((k&3)==3) gen_printf(" ");
 		}
 		gen_printf(" ");
 		for (int k=0; k<16; k++)
 		{
-			gen_printf("%02x", (unsigned int)(user_read(base_addr+(0x2000)+(i<<4)+k , 8))); // cast / update read
+			gen_printf("%02x", (unsigned int)data_out[(i<<4)+k]);
 			if ((k&3)==3) gen_printf(" ");
 		}
 		gen_printf("\n");
@@ -243,9 +248,9 @@ char fill_data(unsigned int zero_padding, unsigned int base_addr, unsigned int l
 {
 	char			pattern;
 	
-	unsigned int	char_ptr;
 	unsigned int	int_tmp=0;
 	unsigned int	length128=0;
+	unsigned char	buffer[MEM_SIZE8];
 	
 	if ( (length&0xF)==0 )
 	{
@@ -254,6 +259,7 @@ char fill_data(unsigned int zero_padding, unsigned int base_addr, unsigned int l
 	{
 		length128 = (length>>4)+1;
 	}
+	if (length > MEM_SIZE8) length = MEM_SIZE8;
 	
 	gen_printf("a. zero pattern\n");
 	gen_printf("b. 8-bit counter\n");
@@ -270,72 +276,44 @@ char fill_data(unsigned int zero_padding, unsigned int base_addr, unsigned int l
 		}
 	} while ( ('a' > pattern) || (pattern > 'd') );
 	
+	// build the pattern in host memory, then load it with one block transfer
 	switch (pattern)
 	{		
 		case 'd':
 			// 32-bit pattern
-			for (unsigned int i=0; i<length128; i++)
+			for (unsigned int i=0; i<length; i++)
 			{
-				for(int k=0; k<16; k++)
-				{
-					if ( ((i<<4)+k)<length )
-					{
-						user_write( (base_addr+(i<<4)+k) ,8, int_tmp>>8*(3-(k&3)));
-						if ( (k&3)== 3 ) int_tmp = int_tmp+1;
-					}else
-					{
-						if(zero_padding==0x01) user_write( (base_addr+(i<<4)+k) ,8, 0);
-					}
-				}
+				buffer[i] = (unsigned char)(int_tmp>>8*(3-(i&3)));
+				if ( (i&3)== 3 ) int_tmp = int_tmp+1;
 			}
+			write_block(base_addr, buffer, length, zero_padding);
 			break;
 
 		case 'c':
 			// 16-bit pattern
-			for (unsigned int i=0; i<length128; i++)
+			for (unsigned int i=0; i<length; i++)
 			{
-				for(unsigned int k=0; k<16; k++)
-				{
-					if ( ((i<<4)+k)<length )
-					{
-						int_tmp	  = (int_tmp<<16) | (int_tmp>>16);
-						user_write( (base_addr+(i<<4)+k) ,8, int_tmp);
-						if ( (k&1)== 1 ) int_tmp = int_tmp+1;
-					}else
-					{
-						if(zero_padding==0x01) user_write( (base_addr+(i<<4)+k) ,8, 0);
-					}
-				}
+				int_tmp	  = (int_tmp<<16) | (int_tmp>>16);
+				buffer[i] = (unsigned char)int_tmp;
+				if ( (i&1)== 1 ) int_tmp = int_tmp+1;
 			}
+			write_block(base_addr, buffer, length, zero_padding);
 			break;
 		
 		case 'b':
 			// 8-bit pattern
-			for (unsigned int i=0; i<length128; i++)
+			for (unsigned int i=0; i<length; i++)
 			{
-				for(unsigned int k=0; k<16; k++)
-				{
-					if ( ((i<<4)+k)<length )
-					{
-						user_write( (base_addr+(i<<4)+k) ,8, int_tmp);
-						int_tmp   = int_tmp + 1;
-					}else
-					{
-						if(zero_padding==0x01) user_write( (base_addr+(i<<4)+k) ,8, 0); 
-					}
-				}
+				buffer[i] = (unsigned char)int_tmp;
+				int_tmp   = int_tmp + 1;
 			}
+			write_block(base_addr, buffer, length, zero_padding);
 			break;
 			
 		case 'a':
 			// zero pattern
-			for (int i=0; i<length128; i++)
-			{
-				for(int k=0; k<16; k++)
-				{
-					user_write( (base_addr+(i<<4)+k) ,8, 0);
-				}
-			}
+			memset(buffer, 0, sizeof(buffer));
+			write_block(base_addr, buffer, length128<<4, 0);
 			break;
 
 		default :
@@ -346,28 +324,6 @@ char fill_data(unsigned int zero_padding, unsigned int base_addr, unsigned int l
 	return pattern;
 }
 
-int wait_ready(unsigned int CMD_REG)
-{
-	unsigned int			int_tmp;
-	unsigned int i=0;
-
-	do {
-		int_tmp	= (unsigned int)user_read(CMD_REG,32);
-		i = i+1;
-		if (i %DEFAULT_TIMEOUT == DEFAULT_TIMEOUT-1)
-		{
-			gen_printf("."); 
-			if (i>5*DEFAULT_TIMEOUT)
-			{
-				gen_printf(" TIMEOUT, something went wrong.\n");
-				return -1;
-			}
-		}
-	} while ( int_tmp != 0 );
-
-	return 0;
-}
-
 // Set Resgister
 void set_key_or_iv(unsigned int start_addr, unsigned int length_hex, char *label)
 {	
@@ -377,6 +333,8 @@ void set_key_or_iv(unsigned int start_addr, unsigned int length_hex, char *label
 	unsigned int			data_length_hex = length_hex;
 	unsigned int			data_length_int = length_hex>>3;
 	unsigned int			reg_set[data_length_int];
+	struct aes_batch_op		ops[2*AESKEY_SIZE_INT+2];
+	unsigned int			count = 0;
 	
 	char					*str_label=label;
 	
@@ -397,17 +355,27 @@ void set_key_or_iv(unsigned int start_addr, unsigned int length_hex, char *label
 		hex_string_to_key_set(reg_set, data_length_int, hex_str, length);
 	}
 	
-	if (wait_ready(DATAINCNT_REG) < 0)return;
+	// wait ready, write registers, wait ready and read back in one batch
+	batch_poll(&ops[count++], DATAINCNT_REG, 0);
 	for (int i=data_length_int-1; i>=0; i--) 
 	{
-		user_write(start_addr+4*i , 32 , reg_set[i]);
+		batch_write(&ops[count++], start_addr+4*i , 32 , reg_set[i]);
+	}
+	batch_poll(&ops[count++], DATAINCNT_REG, 0);
+	for (int i=data_length_int-1; i>=0; i--) 
+	{
+		batch_read(&ops[count++], start_addr+4*i, 32);
+	}
+	if (user_batch(ops, count) < (int)count)
+	{
+		gen_printf(" TIMEOUT, something went wrong.\n");
+		return;
 	}
-	if (wait_ready(DATAINCNT_REG) < 0)return;
 	
 	gen_printf("           new %s= 0x", str_label);
 	for (int i=data_length_int-1; i>=0; i--) 
 	{ 
-		reg_set[i] = user_read(start_addr+4*i, 32);
+		reg_set[i] = (unsigned int)ops[count-1-i].value;
 		gen_printf("%08x",reg_set[i]);
 	}
 	gen_printf("\n");
@@ -416,31 +384,36 @@ void set_key_or_iv(unsigned int start_addr, unsigned int length_hex, char *label
 // send AES command : set AadInCount and DataInCount
 void aes_command(unsigned int mode, unsigned int AADCNT_REG, unsigned int aad_cnt, unsigned int DATACNT_REG, unsigned int data_cnt)
 {
-	volatile unsigned int 	*int_ptr;
+	struct aes_batch_op		ops[7];
+	unsigned int			count = 0;
 	
 	// set Encrypt/Decrypt Mode
 	if(mode==0x02)
 	{
-		user_write(BYPASS_REG , 32 , 0x01);
+		batch_write(&ops[count++], BYPASS_REG , 32 , 0x01);
 	}
 	else
 	{
-		user_write(DECEN_REG , 32 , mode);
-		user_write(BYPASS_REG , 32 , 0x00);
+		batch_write(&ops[count++], DECEN_REG , 32 , mode);
+		batch_write(&ops[count++], BYPASS_REG , 32 , 0x00);
 	}
 	
 	// set Start Address
-	user_write(ADDR_A1_REG , 32 , 0x00);
-	user_write(ADDR_A2_REG , 32 , 0x00);
+	batch_write(&ops[count++], ADDR_A1_REG , 32 , 0x00);
+	batch_write(&ops[count++], ADDR_A2_REG , 32 , 0x00);
 	
 	// set AADCNT_REG with length
-	user_write(AADCNT_REG , 32 , aad_cnt);
+	batch_write(&ops[count++], AADCNT_REG , 32 , aad_cnt);
 	
 	// set DATACNT_REG with length to start encrypt/decrypt operation
-	user_write(DATACNT_REG , 32 , data_cnt);
+	batch_write(&ops[count++], DATACNT_REG , 32 , data_cnt);
 
-	if (wait_ready(DATACNT_REG) < 0)
+	// wait until DATACNT_REG returns to zero
+	batch_poll(&ops[count++], DATACNT_REG, 0);
+
+	if (user_batch(ops, count) < (int)count)
 	{
+		gen_printf(" TIMEOUT, something went wrong.\n");
 		return;
 	}
 }
@@ -464,6 +437,7 @@ int loop_verify(unsigned int aad_cnt, unsigned int data_cnt)
 	unsigned int			aad128;
 	unsigned int			int_tmp;
 	unsigned int 			plain_text[MEM_SIZE32];
+	unsigned int 			data_out[MEM_SIZE32];
 	unsigned int 			enc_tag[4], dec_tag[4];
 	
 	//print current parameters
@@ -489,16 +463,11 @@ int loop_verify(unsigned int aad_cnt, unsigned int data_cnt)
 		aad128	= (aad_cnt>>4);
 	
 	// store original DataIn from Memory
-	for (int i=0; i<MEM_SIZE32; i++)
-	{
-		plain_text[i] = (unsigned int)user_read(DATAIN_ADDR+(i<<2),32);
-	}
+	read_block(DATAIN_ADDR, plain_text, MEM_SIZE8);
 	
 	// clear data memory for DataOut
-	for (int i=0; i<MEM_SIZE32; i++)
-	{
-		user_write(DATAOUT_ADDR+(i<<2) , 32 , 0);
-	}
+	memset(data_out, 0, sizeof(data_out));
+	write_block(DATAOUT_ADDR, data_out, MEM_SIZE8, 0);
 	
 	// start encryption with current parameters
 	aes_command(0x00, AADINCNT_REG, aad_cnt, DATAINCNT_REG, data_cnt);
@@ -522,11 +491,8 @@ int loop_verify(unsigned int aad_cnt, unsigned int data_cnt)
 	gen_printf("\n");
 	
 	// Copy memory from dataout to datain
-	for (int i=0; i<MEM_SIZE32; i++)
-	{
-		int_tmp		= (unsigned int)user_read(DATAOUT_ADDR+(i<<2),32);
-		user_write(DATAIN_ADDR+(i<<2) , 32 ,int_tmp );
-	}
+	read_block(DATAOUT_ADDR, data_out, MEM_SIZE8);
+	write_block(DATAIN_ADDR, data_out, MEM_SIZE8, 0);
 	
 	// start decryption with current parameters
 	aes_command(0x01, AADINCNT_REG, aad_cnt, DATAINCNT_REG, data_cnt);
@@ -550,16 +516,14 @@ int loop_verify(unsigned int aad_cnt, unsigned int data_cnt)
 	gen_printf("\n");
 	
 	// write DataIn Memory with plaintext
-	for (int i=0; i<MEM_SIZE32; i++)
-	{
-		user_write(DATAIN_ADDR+(i<<2) , 32 ,plain_text[i] );
-	}
+	write_block(DATAIN_ADDR, plain_text, MEM_SIZE8, 0);
 	
 	length8		=	data_cnt + (aad128<<4);
 	// check decrypted data
+	read_block(DATAOUT_ADDR, data_out, MEM_SIZE8);
 	for (int i=0; i<MEM_SIZE32; i++)
 	{
-		int_tmp = (unsigned int)user_read(DATAOUT_ADDR+(i<<2),32);
+		int_tmp = data_out[i];
 		//set DataMask
 		if ( length8 > 0x04 )
 		{
@@ -621,6 +585,7 @@ int main(void)
 	
 	unsigned int			aad128	= 0;
 	unsigned int			data128	= 0;
+	unsigned char			clone_buf[MEM_SIZE8];
 	
 	int_tmp		= (unsigned int)user_read(VER_REG , 32);
 	gen_printf("\n");
@@ -768,11 +733,8 @@ int main(void)
 
 			case '8' :
 				gen_printf("\n+++ Clone Memory +++\n");
-				for (int i=0; i<MEM_SIZE32; i++)
-				{
-					int_tmp		=   (unsigned int)user_read(DATAOUT_ADDR+(i<<2),32);
-					user_write(DATAIN_ADDR+(i<<2) , 32 ,int_tmp );
-				}
+				read_block(DATAOUT_ADDR, clone_buf, MEM_SIZE8);
+				write_block(DATAIN_ADDR, clone_buf, MEM_SIZE8, 0);
 				if((aad128<<4)+data_cnt>0)
 				{
 					gen_printf("\n");
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "KR260_ioctl.h"
+
+#define AAD_SIZE        16
+#define DATA_MAX        (2048 - AAD_SIZE)
+#define SLOTS           64      /* Messages in the registered buffer */
+#define NUM_OPERATIONS  20000
+
+static const uint32_t sizes[] = { 64, 256, 1024, DATA_MAX };
+
+/* One message of the registered buffer */
+struct slot {
+    uint8_t aad[AAD_SIZE];
+    uint8_t in[DATA_MAX];
+    uint8_t out[DATA_MAX];
+};
+
+static uint8_t key[32];
+static uint8_t iv[12];
+static struct slot *slots;
+static int key_handle;
+
+// Function to calculate time difference in nanoseconds
+uint64_t time_diff_ns(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1000000000ULL + (end.tv_nsec - start.tv_nsec);
+}
+
+// Fixed buffer results must match the copying path, decrypted data only appears with a good tag
+static int verify(uint32_t len) {
+    uint8_t expected[DATA_MAX], tag[16], fixed_tag[16];
+    struct slot *s = &slots[1];
+
+    if (aes_gcm_run_key(key_handle, AES_MODE_ENCRYPT, iv, s->aad, AAD_SIZE, s->in, expected, len, tag) < 0 ||
+        aes_gcm_run_fixed(key_handle, AES_MODE_ENCRYPT, iv, s->aad, AAD_SIZE, s->in, s->out, len, fixed_tag) < 0 ||
+        memcmp(expected, s->out, len) || memcmp(tag, fixed_tag, 16)) {
+        return -1;
+    }
+
+    memcpy(s->in, expected, len);
+    memset(s->out, 0, len);
+    fixed_tag[0] ^= 1;
+    if (aes_gcm_run_fixed(key_handle, AES_MODE_DECRYPT, iv, s->aad, AAD_SIZE, s->in, s->out, len, fixed_tag) == 0 ||
+        s->out[0] != 0) {
+        return -1;
+    }
+    fixed_tag[0] ^= 1;
+    if (aes_gcm_run_fixed(key_handle, AES_MODE_DECRYPT, iv, s->aad, AAD_SIZE, s->in, s->out, len, fixed_tag) < 0) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        if (s->out[i] != (uint8_t)(i + 1)) {
+            return -1;
+        }
+    }
+    for (uint32_t i = 0; i < len; i++) s->in[i] = (uint8_t)(i + 1);
+    return 0;
+}
+
+// Encrypt NUM_OPERATIONS messages, return ops/s and the CPU time and copied bytes per operation
+static double run(int fixed, uint32_t len, double *cpu_us, double *copied) {
+    struct aes_stats_snapshot before, after;
+    struct timespec start, end, cpu_start, cpu_end;
+    int have_stats = aes_read_stats(&before) == 0;
+    uint8_t tag[16];
+    int ret;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+    for (int n = 0; n < NUM_OPERATIONS; n++) {
+        struct slot *s = &slots[n % SLOTS];
+
+        if (fixed) {
+            ret = aes_gcm_run_fixed(key_handle, AES_MODE_ENCRYPT, iv, s->aad, AAD_SIZE, s->in, s->out, len, tag);
+        } else {
+            ret = aes_gcm_run_key(key_handle, AES_MODE_ENCRYPT, iv, s->aad, AAD_SIZE, s->in, s->out, len, tag);
+        }
+        if (ret < 0) {
+            return 0.0;
+        }
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    *cpu_us = time_diff_ns(cpu_start, cpu_end) / 1000.0 / NUM_OPERATIONS;
+    *copied = -1.0;
+    if (have_stats && aes_read_stats(&after) == 0) {
+        *copied = (double)(after.stat[AES_STAT_COPY_BYTES] - before.stat[AES_STAT_COPY_BYTES]) / NUM_OPERATIONS;
+    }
+    return NUM_OPERATIONS * 1e9 / time_diff_ns(start, end);
+}
+
+int main() {
+    int index;
+
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(0x12 + i);
+    for (int i = 0; i < 12; i++) iv[i] = (uint8_t)(0x34 + i);
+
+    // Page aligned so the registration pins exactly the buffer
+    if (posix_memalign((void **)&slots, 4096, SLOTS * sizeof(*slots)) != 0) {
+        printf("Failed to allocate the buffer\n");
+        return 1;
+    }
+    for (int n = 0; n < SLOTS; n++) {
+        for (int i = 0; i < AAD_SIZE; i++) slots[n].aad[i] = (uint8_t)i;
+        for (int i = 0; i < DATA_MAX; i++) slots[n].in[i] = (uint8_t)(i + 1);
+    }
+
+    printf("AES-GCM Registered Buffer Benchmark\n");
+    printf("===================================\n");
+    printf("AAD: %d bytes, buffer: %zu KB, operations per test: %d\n\n",
+           AAD_SIZE, SLOTS * sizeof(*slots) / 1024, NUM_OPERATIONS);
+
+    key_handle = aes_key_register(key);
+    index = aes_buf_register(slots, SLOTS * sizeof(*slots));
+    if (key_handle < 0 || index < 0) {
+        printf("Failed to register the key or the buffer\n");
+        close_device();
+        return 1;
+    }
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        if (verify(sizes[s]) < 0) {
+            printf("Registered buffer results do not match the copying path (%u bytes)\n", sizes[s]);
+            close_device();
+            return 1;
+        }
+    }
+
+    // Copied bytes come from the device statistics, n/a when they cannot be read
+    printf("Payload (B) | Path   |     ops/s | CPU (us/op) | Copied (B/op)\n");
+    printf("------------|--------|-----------|-------------|--------------\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int fixed = 0; fixed <= 1; fixed++) {
+            double cpu_us, copied, rate = run(fixed, sizes[s], &cpu_us, &copied);
+            char copied_str[16];
+
+            if (rate == 0.0) {
+                printf("Encryption failed\n");
+                close_device();
+                return 1;
+            }
+            if (copied < 0.0) {
+                snprintf(copied_str, sizeof(copied_str), "n/a");
+            } else {
+                snprintf(copied_str, sizeof(copied_str), "%.0f", copied);
+            }
+            printf("%11u | %-6s | %9.0f | %11.3f | %13s\n", sizes[s], fixed ? "fixed" : "copy", rate, cpu_us,
+                   copied_str);
+        }
+    }
+
+    aes_buf_unregister(index);
+    aes_key_unregister(key_handle);
+    close_device();
+    free(slots);
+    return 0;
+}
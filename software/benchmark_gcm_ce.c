@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <openssl/evp.h>
+#include "aesgcm_ce.h"
+#include "aesgcm_session.h"
+#include "ghash.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define AAD_SIZE        16
+#define SWEEP_MAX       1100
+#define BENCH_BYTES     (64u << 20)     /* Payload per measurement */
+
+static const size_t sizes[] = { 16, 64, 256, 1024, 8192, 65536, 1048576 };
+
+/* AES-256 test cases 13-16 of the GCM specification (McGrew & Viega), the ones with a 96-bit IV */
+struct gcm_vector {
+    const char *key, *iv, *pt, *aad, *ct, *tag;
+};
+
+static const struct gcm_vector vectors[] = {
+    { "0000000000000000000000000000000000000000000000000000000000000000", "000000000000000000000000",
+      "", "", "", "530f8afbc74536b9a963b4f1c4cb738b" },
+    { "0000000000000000000000000000000000000000000000000000000000000000", "000000000000000000000000",
+      "00000000000000000000000000000000", "", "cea7403d4d606b6e074ec5d3baf39d18",
+      "d0d1c8a799996bf0265b98b5d48ab919" },
+    { "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+      "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525"
+      "b16aedf5aa0de657ba637b391aafd255", "",
+      "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa8cb08e48590dbb3da7b08b1056828838"
+      "c5f61e6393ba7a0abcc9f662898015ad", "b094dac5d93471bdec1a502270e3cc6c" },
+    { "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+      "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525"
+      "b16aedf5aa0de657ba637b39", "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+      "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa8cb08e48590dbb3da7b08b1056828838"
+      "c5f61e6393ba7a0abcc9f662", "76fc6ece0f4e1768cddf8853bb2d551b" },
+};
+
+// Function to calculate time difference in nanoseconds
+uint64_t time_diff_ns(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1000000000ULL + (end.tv_nsec - start.tv_nsec);
+}
+
+static size_t unhex(const char *hex, uint8_t *out) {
+    size_t n = strlen(hex) / 2;
+
+    for (size_t i = 0; i < n; i++) {
+        sscanf(hex + 2 * i, "%2hhx", &out[i]);
+    }
+    return n;
+}
+
+// Reference encryption, the EVP sequence of encrypt() in aesgcm_sw_encrypt.c
+static int reference_encrypt(const uint8_t *key, const uint8_t *iv, const uint8_t *aad, int aad_len,
+                             const uint8_t *in, uint8_t *out, int len, uint8_t *tag) {
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    int outl, ok;
+
+    ok = ctx && EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) == 1 &&
+         EVP_EncryptInit_ex(ctx, NULL, NULL, key, iv) == 1 &&
+         (aad_len == 0 || EVP_EncryptUpdate(ctx, NULL, &outl, aad, aad_len) == 1) &&
+         EVP_EncryptUpdate(ctx, out, &outl, in, len) == 1 &&
+         EVP_EncryptFinal_ex(ctx, out + outl, &outl) == 1 &&
+         EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16, tag) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok ? 0 : -1;
+}
+
+// Reference decryption, the EVP sequence of decrypt_data() in aesgcm_sw_decrypt.c
+static int reference_decrypt(const uint8_t *key, const uint8_t *iv, const uint8_t *aad, int aad_len,
+                             const uint8_t *in, uint8_t *out, int len, const uint8_t *tag) {
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    int outl, ok;
+
+    ok = ctx && EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) == 1 &&
+         EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv) == 1 &&
+         (aad_len == 0 || EVP_DecryptUpdate(ctx, NULL, &outl, aad, aad_len) == 1) &&
+         EVP_DecryptUpdate(ctx, out, &outl, in, len) == 1 &&
+         EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, 16, (void *)tag) == 1 &&
+         EVP_DecryptFinal_ex(ctx, out + outl, &outl) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok ? 0 : -1;
+}
+
+// Known answers through both implementations, in both directions
+static int check_vectors(void) {
+    for (size_t v = 0; v < sizeof(vectors) / sizeof(vectors[0]); v++) {
+        uint8_t key[32], iv[12], pt[64], aad[32], ct[64], tag[16];
+        uint8_t out[64], out_tag[16], ref[64], ref_tag[16];
+        struct aesgcm_ce_ctx ctx;
+        size_t len, aad_len;
+
+        unhex(vectors[v].key, key);
+        unhex(vectors[v].iv, iv);
+        len = unhex(vectors[v].pt, pt);
+        aad_len = unhex(vectors[v].aad, aad);
+        unhex(vectors[v].ct, ct);
+        unhex(vectors[v].tag, tag);
+
+        if (aesgcm_ce_init(&ctx, key) < 0 ||
+            aesgcm_ce_encrypt(&ctx, iv, aad, aad_len, pt, out, len, out_tag) < 0 ||
+            reference_encrypt(key, iv, aad, (int)aad_len, pt, ref, (int)len, ref_tag) < 0 ||
+            memcmp(out, ct, len) || memcmp(out_tag, tag, 16) || memcmp(ref, ct, len) || memcmp(ref_tag, tag, 16) ||
+            aesgcm_ce_decrypt(&ctx, iv, aad, aad_len, ct, out, len, tag) < 0 || memcmp(out, pt, len) ||
+            reference_decrypt(key, iv, aad, (int)aad_len, ct, ref, (int)len, tag) < 0 || memcmp(ref, pt, len)) {
+            printf("Test case %zu failed\n", 13 + v);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Every length up to SWEEP_MAX with varying AAD against OpenSSL, and a rejected modified tag
+static int check_sweep(void) {
+    uint8_t key[32], iv[12], aad[48], in[SWEEP_MAX], out[SWEEP_MAX], ref[SWEEP_MAX], tag[16], ref_tag[16];
+    struct aesgcm_ce_ctx ctx;
+
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(0x12 + 3 * i);
+    for (int i = 0; i < 48; i++) aad[i] = (uint8_t)(0xA0 ^ i);
+    for (int i = 0; i < SWEEP_MAX; i++) in[i] = (uint8_t)(i * 7 + (i >> 5));
+    if (aesgcm_ce_init(&ctx, key) < 0) {
+        return -1;
+    }
+
+    for (size_t len = 0; len < SWEEP_MAX; len++) {
+        size_t aad_len = len % 49;
+
+        for (int i = 0; i < 12; i++) iv[i] = (uint8_t)(len + i);
+        if (aesgcm_ce_encrypt(&ctx, iv, aad, aad_len, in, out, len, tag) < 0 ||
+            reference_encrypt(key, iv, aad, (int)aad_len, in, ref, (int)len, ref_tag) < 0 ||
+            memcmp(out, ref, len) || memcmp(tag, ref_tag, 16)) {
+            printf("Mismatch with OpenSSL at %zu bytes, AAD %zu\n", len, aad_len);
+            return -1;
+        }
+        // In place, as the decryption of a received record would run
+        if (aesgcm_ce_decrypt(&ctx, iv, aad, aad_len, out, out, len, tag) < 0 || memcmp(out, in, len)) {
+            printf("Decryption failed at %zu bytes\n", len);
+            return -1;
+        }
+        tag[len % 16] ^= 0x80;
+        memcpy(out, ref, len);
+        if (aesgcm_ce_decrypt(&ctx, iv, aad, aad_len, out, out, len, tag) == 0) {
+            printf("Modified tag accepted at %zu bytes\n", len);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// CPU clock in GHz: argument, cpufreq, or the TSC on x86. 0 when unknown
+static double cpu_ghz(int argc, char *argv[]) {
+    FILE *f;
+    long khz;
+
+    if (argc > 1) {
+        return atof(argv[1]);
+    }
+    f = fopen("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq", "r");
+    if (f) {
+        int ok = fscanf(f, "%ld", &khz) == 1;
+
+        fclose(f);
+        if (ok && khz > 0) {
+            return khz / 1e6;
+        }
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    {
+        struct timespec start, end;
+        uint64_t t0, t1;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        t0 = __rdtsc();
+        do {
+            clock_gettime(CLOCK_MONOTONIC, &end);
+        } while (time_diff_ns(start, end) < 50000000);
+        t1 = __rdtsc();
+        return (double)(t1 - t0) / time_diff_ns(start, end);
+    }
+#else
+    return 0.0;
+#endif
+}
+
+// Nanoseconds per byte encrypting len-byte messages, keys set up once for both
+static double ns_per_byte(int use_ce, struct aesgcm_ce_ctx *ctx, struct aesgcm_session *sess,
+                          const uint8_t *aad, const uint8_t *in, uint8_t *out, size_t len) {
+    size_t count = BENCH_BYTES / len;
+    struct timespec start, end;
+    uint8_t iv[12] = { 0 }, tag[16];
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t n = 0; n < count; n++) {
+        memcpy(iv, &n, sizeof(n));
+        if ((use_ce ? aesgcm_ce_encrypt(ctx, iv, aad, AAD_SIZE, in, out, len, tag)
+                    : aesgcm_session_encrypt(sess, iv, aad, AAD_SIZE, in, out, len, tag)) < 0) {
+            return 0.0;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)time_diff_ns(start, end) / ((double)count * len);
+}
+
+int main(int argc, char *argv[]) {
+    uint8_t key[32], aad[AAD_SIZE], *in, *out;
+    struct aesgcm_ce_ctx ctx;
+    struct aesgcm_session sess;
+    double ghz;
+
+    printf("AES-256-GCM CPU Instructions vs OpenSSL Benchmark\n");
+    printf("=================================================\n");
+    printf("AES: %s, GHASH: %s\n", aesgcm_ce_impl(), ghash_impl());
+    if (strcmp(aesgcm_ce_impl(), "none") == 0) {
+        printf("Build with -march=armv8-a+crypto (ARMv8) or -maes -mpclmul -mssse3 (x86)\n");
+        return 1;
+    }
+
+    if (check_vectors() < 0 || check_sweep() < 0) {
+        return 1;
+    }
+    printf("GCM specification test cases 13-16 and %d lengths against OpenSSL: match\n", SWEEP_MAX);
+
+    ghz = cpu_ghz(argc, argv);
+    in = malloc(sizes[sizeof(sizes) / sizeof(sizes[0]) - 1]);
+    out = malloc(sizes[sizeof(sizes) / sizeof(sizes[0]) - 1]);
+    if (!in || !out) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(0x12 + i);
+    for (int i = 0; i < AAD_SIZE; i++) aad[i] = (uint8_t)i;
+    for (size_t i = 0; i < sizes[sizeof(sizes) / sizeof(sizes[0]) - 1]; i++) in[i] = (uint8_t)i;
+    if (aesgcm_ce_init(&ctx, key) < 0 || aesgcm_session_init(&sess, key) < 0) {
+        printf("Key setup failed\n");
+        return 1;
+    }
+
+    // Cycles from the clock rate, pass it in GHz as the first argument when it is not detected
+    if (ghz > 0.0) {
+        printf("Clock: %.2f GHz, AAD: %d bytes\n\n", ghz, AAD_SIZE);
+    } else {
+        printf("Clock: unknown (pass it in GHz), AAD: %d bytes\n\n", AAD_SIZE);
+    }
+    printf("Payload (B) | OpenSSL (cpb) | Native (cpb) | OpenSSL (MB/s) | Native (MB/s)\n");
+    printf("------------|---------------|--------------|----------------|--------------\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        double ref = ns_per_byte(0, &ctx, &sess, aad, in, out, sizes[s]);
+        double ce = ns_per_byte(1, &ctx, &sess, aad, in, out, sizes[s]);
+        char ref_cpb[16] = "n/a", ce_cpb[16] = "n/a";
+
+        if (ref == 0.0 || ce == 0.0) {
+            printf("Encryption failed\n");
+            return 1;
+        }
+        if (ghz > 0.0) {
+            snprintf(ref_cpb, sizeof(ref_cpb), "%.2f", ref * ghz);
+            snprintf(ce_cpb, sizeof(ce_cpb), "%.2f", ce * ghz);
+        }
+        printf("%11zu | %13s | %12s | %14.1f | %13.1f\n", sizes[s], ref_cpb, ce_cpb, 1e3 / ref, 1e3 / ce);
+    }
+
+    aesgcm_session_free(&sess);
+    free(out);
+    free(in);
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "KR260_ioctl.h"
+
+#define BASE_ADDR       0xA0000000
+#define DATAIN_ADDR     (BASE_ADDR + 0x2000)
+#define DATAOUT_ADDR    (BASE_ADDR + 0x4000)
+#define AAD_SIZE        16
+#define DATA_SIZE       (2048 - AAD_SIZE)
+#define NUM_OPERATIONS  1000
+#define NUM_KEYS        1024
+#define KEY_RUN         8       /* Operations per key before switching, models per-flow locality */
+
+static uint8_t key[32];
+static uint8_t iv[12];
+static uint8_t aad[AAD_SIZE];
+static uint8_t plaintext[DATA_SIZE];
+static uint8_t ciphertext[DATA_SIZE];
+static uint8_t tag[16];
+static uint8_t keys[NUM_KEYS][32];
+static int key_handles[NUM_KEYS];
+static unsigned int op_count;
+
+// Function to calculate time difference in nanoseconds
+uint64_t time_diff_ns(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1000000000ULL + (end.tv_nsec - start.tv_nsec);
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// One encryption with one ioctl per register and per 32-bit data word, as aesgcmipdemo.c did
+static int per_register_op(void) {
+    uint32_t word;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        memcpy(&word, key + 4 * (7 - i), 4);
+        user_write(BASE_ADDR + 0x20 + 4 * i, 32, __builtin_bswap32(word));
+    }
+    for (i = 0; i < 3; i++) {
+        memcpy(&word, iv + 4 * (2 - i), 4);
+        user_write(BASE_ADDR + 0x40 + 4 * i, 32, __builtin_bswap32(word));
+    }
+    for (i = 0; i < AAD_SIZE; i += 4) {
+        memcpy(&word, aad + i, 4);
+        user_write(DATAIN_ADDR + i, 32, word);
+    }
+    for (i = 0; i < DATA_SIZE; i += 4) {
+        memcpy(&word, plaintext + i, 4);
+        user_write(DATAIN_ADDR + AAD_SIZE + i, 32, word);
+    }
+
+    user_write(BASE_ADDR + 0x14, 32, 0);
+    user_write(BASE_ADDR + 0x18, 32, 0);
+    user_write(BASE_ADDR + 0x00, 32, 0);
+    user_write(BASE_ADDR + 0x04, 32, 0);
+    user_write(BASE_ADDR + 0x08, 32, AAD_SIZE);
+    user_write(BASE_ADDR + 0x0C, 32, DATA_SIZE);
+    for (i = 0; user_read(BASE_ADDR + 0x0C, 32) != 0; i++) {
+        if (i > 10000000) {
+            return -1;
+        }
+    }
+
+    for (i = 0; i < DATA_SIZE; i += 4) {
+        word = (uint32_t)user_read(DATAOUT_ADDR + AAD_SIZE + i, 32);
+        memcpy(ciphertext + i, &word, 4);
+    }
+    for (i = 0; i < 4; i++) {
+        word = __builtin_bswap32((uint32_t)user_read(BASE_ADDR + 0x50 + 4 * i, 32));
+        memcpy(tag + 4 * (3 - i), &word, 4);
+    }
+    return 0;
+}
+
+// One encryption with AES_IOC_GCM_RUN
+static int gcm_run_op(void) {
+    return aes_gcm_run(AES_MODE_ENCRYPT, key, iv, aad, AAD_SIZE, plaintext, ciphertext, DATA_SIZE, tag);
+}
+
+// Key of the next operation: a random key held for KEY_RUN operations
+static unsigned int next_key(void) {
+    static unsigned int current;
+
+    if (op_count++ % KEY_RUN == 0) {
+        current = (unsigned int)rand() % NUM_KEYS;
+    }
+    return current;
+}
+
+// One encryption passing the key bytes every time
+static int explicit_key_op(void) {
+    return aes_gcm_run(AES_MODE_ENCRYPT, keys[next_key()], iv, aad, AAD_SIZE, plaintext, ciphertext, DATA_SIZE, tag);
+}
+
+// One encryption with a registered key, KEYIN is skipped while the key stays the same
+static int key_handle_op(void) {
+    return aes_gcm_run_key((uint32_t)key_handles[next_key()], AES_MODE_ENCRYPT, iv, aad, AAD_SIZE,
+                           plaintext, ciphertext, DATA_SIZE, tag);
+}
+
+// Time NUM_OPERATIONS calls of op and print average, minimum and p99 latency (no newline)
+static double benchmark(const char *name, int (*op)(void)) {
+    static uint64_t samples[NUM_OPERATIONS];
+    struct timespec start, end;
+    uint64_t total_ns = 0;
+
+    for (int i = 0; i < NUM_OPERATIONS; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (op() < 0) {
+            printf("%-14s | operation %d failed", name, i);
+            return 0.0;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        samples[i] = time_diff_ns(start, end);
+        total_ns += samples[i];
+    }
+
+    qsort(samples, NUM_OPERATIONS, sizeof(samples[0]), compare_u64);
+    printf("%-14s | %10.2f | %10.2f | %10.2f", name,
+           total_ns / 1000.0 / NUM_OPERATIONS, samples[0] / 1000.0,
+           samples[NUM_OPERATIONS * 99 / 100] / 1000.0);
+    return total_ns / 1000.0 / NUM_OPERATIONS;
+}
+
+int main() {
+    uint8_t reference[DATA_SIZE], reference_tag[16];
+    double legacy_us, run_us;
+
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(0x12 + i);
+    for (int i = 0; i < 12; i++) iv[i] = (uint8_t)(0x34 + i);
+    for (int i = 0; i < AAD_SIZE; i++) aad[i] = (uint8_t)i;
+    for (int i = 0; i < DATA_SIZE; i++) plaintext[i] = (uint8_t)i;
+
+    printf("AES-GCM 2 KB Operation Latency Benchmark\n");
+    printf("========================================\n");
+    printf("AAD: %d bytes, payload: %d bytes, operations per test: %d\n\n", AAD_SIZE, DATA_SIZE, NUM_OPERATIONS);
+
+    // Both paths must produce the same ciphertext and tag
+    if (per_register_op() < 0) {
+        printf("Per-register operation failed\n");
+        return 1;
+    }
+    memcpy(reference, ciphertext, DATA_SIZE);
+    memcpy(reference_tag, tag, 16);
+    if (gcm_run_op() < 0) {
+        printf("AES_IOC_GCM_RUN failed\n");
+        return 1;
+    }
+    if (memcmp(reference, ciphertext, DATA_SIZE) || memcmp(reference_tag, tag, 16)) {
+        printf("AES_IOC_GCM_RUN output does not match the per-register path\n");
+        return 1;
+    }
+
+    printf("Path           |  Avg (μs)  |  Min (μs)  |  p99 (μs)\n");
+    printf("---------------|------------|------------|-----------\n");
+    legacy_us = benchmark("per-register", per_register_op);
+    printf("\n");
+    run_us = benchmark("GCM_RUN ioctl", gcm_run_op);
+    printf("\n");
+    if (run_us > 0.0) {
+        printf("\nSpeedup: %.1fx\n", legacy_us / run_us);
+    }
+
+    // Completion wait modes: latency and spin iterations spent or saved
+    printf("\nWait mode      |  Avg (μs)  |  Min (μs)  |  p99 (μs)  | spins/op | saved/op\n");
+    printf("---------------|------------|------------|------------|----------|---------\n");
+    for (uint32_t mode = AES_WAIT_IRQ; mode <= AES_WAIT_HYBRID; mode++) {
+        static const char *names[] = { "irq", "spin", "hybrid" };
+        struct aes_wait_stats before, after;
+
+        if (aes_set_wait_mode(mode) < 0 || aes_get_wait_stats(&before) < 0) {
+            printf("%-14s | not supported\n", names[mode]);
+            continue;
+        }
+        benchmark(names[mode], gcm_run_op);
+        aes_get_wait_stats(&after);
+        printf(" | %8.1f | %8.1f\n",
+               (double)(after.spin_iters - before.spin_iters) / NUM_OPERATIONS,
+               (double)(after.spins_saved - before.spins_saved) / NUM_OPERATIONS);
+    }
+
+    // Many long-lived keys with locality: explicit keys against registered handles
+    for (int k = 0; k < NUM_KEYS; k++) {
+        for (int i = 0; i < 32; i++) keys[k][i] = (uint8_t)rand();
+        key_handles[k] = aes_key_register(keys[k]);
+        if (key_handles[k] < 0) {
+            printf("\nKey registration failed\n");
+            close_device();
+            return 1;
+        }
+    }
+    aes_set_wait_mode(AES_WAIT_IRQ);
+    printf("\n%d keys, %d operations per key run\n", NUM_KEYS, KEY_RUN);
+    printf("Key path       |  Avg (μs)  |  Min (μs)  |  p99 (μs)  | hit rate\n");
+    printf("---------------|------------|------------|------------|---------\n");
+    srand(1);
+    op_count = 0;
+    benchmark("explicit key", explicit_key_op);
+    printf(" |        -\n");
+    {
+        struct aes_key_stats before, after;
+
+        srand(1);
+        op_count = 0;
+        aes_get_key_stats(&before);
+        benchmark("key handle", key_handle_op);
+        aes_get_key_stats(&after);
+        printf(" | %7.1f%%\n", 100.0 * (after.hits - before.hits) /
+               (double)((after.hits - before.hits) + (after.misses - before.misses)));
+    }
+    for (int k = 0; k < NUM_KEYS; k++) {
+        aes_key_unregister((uint32_t)key_handles[k]);
+    }
+
+    close_device();
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "KR260_ioctl.h"
+#include "aesgcm_hybrid.h"
+
+#define AAD_SIZE        16
+#define NUM_KEYS        4
+#define NUM_JOBS        20000
+#define MAX_PAYLOAD     (2048 - AAD_SIZE)
+#define ROUNDS          6
+
+static const size_t cost_sizes[] = { 64, 256, 512, 1024, 2048, 16384 };
+
+static uint8_t keys[NUM_KEYS][32];
+static uint8_t aad[AAD_SIZE];
+
+// Function to calculate time difference in nanoseconds
+uint64_t time_diff_ns(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1000000000ULL + (end.tv_nsec - start.tv_nsec);
+}
+
+// Mixed traffic: half 64 B messages, 30% 512 B and 20% near the IP limit, keys interleaved
+static size_t mixed_len(size_t i) {
+    unsigned int r = (unsigned int)((i * 2654435761u) >> 7) % 10;
+
+    return r < 5 ? 64 : (r < 8 ? 512 : MAX_PAYLOAD - (i % 4) * 16);
+}
+
+static void setup_jobs(struct aesgcm_job *jobs, uint8_t (*ivs)[12], const uint8_t *in, uint8_t *out) {
+    for (size_t i = 0; i < NUM_JOBS; i++) {
+        memset(ivs[i], 0x56, 12);
+        memcpy(ivs[i], &i, sizeof(i));
+        jobs[i] = (struct aesgcm_job){
+            .key = keys[i % NUM_KEYS], .iv = ivs[i], .aad = aad, .aad_len = AAD_SIZE,
+            .in = in + i * MAX_PAYLOAD, .out = out + i * MAX_PAYLOAD, .len = mixed_len(i),
+        };
+    }
+}
+
+// Time of one batch in ns, 0 on failure
+static uint64_t run(struct aesgcm_hybrid *h, struct aesgcm_job *jobs, int flags) {
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (aesgcm_hybrid_run(h, jobs, NUM_JOBS, flags) != 0) {
+        return 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return time_diff_ns(start, end);
+}
+
+int main(int argc, char *argv[]) {
+    int threads = argc > 1 ? atoi(argv[1]) : 0;
+    struct aesgcm_job *jobs = calloc(NUM_JOBS, sizeof(*jobs));
+    uint8_t (*ivs)[12] = calloc(NUM_JOBS, 12);
+    uint8_t *in = malloc((size_t)NUM_JOBS * MAX_PAYLOAD);
+    uint8_t *out = calloc(NUM_JOBS, MAX_PAYLOAD), *ref = calloc(NUM_JOBS, MAX_PAYLOAD);
+    uint8_t (*ref_tags)[16] = calloc(NUM_JOBS, 16);
+    static const char *names[] = { "CPU only", "IP only", "Hybrid" };
+    static const int flags[] = { AESGCM_HYBRID_CPU_ONLY, AESGCM_HYBRID_HW_ONLY, 0 };
+    struct aesgcm_hybrid *h;
+    uint64_t bytes = 0;
+
+    if (!jobs || !ivs || !in || !out || !ref || !ref_tags) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    for (int k = 0; k < NUM_KEYS; k++) {
+        for (int i = 0; i < 32; i++) keys[k][i] = (uint8_t)(0x21 + i + 0x30 * k);
+    }
+    for (int i = 0; i < AAD_SIZE; i++) aad[i] = (uint8_t)i;
+    for (size_t i = 0; i < (size_t)NUM_JOBS * MAX_PAYLOAD; i++) in[i] = (uint8_t)(i * 13 + (i >> 9));
+
+    h = aesgcm_hybrid_create(threads);
+    if (!h) {
+        printf("Failed to create the dispatcher\n");
+        return 1;
+    }
+
+    printf("Hybrid IP/CPU AES-256-GCM Dispatcher Benchmark\n");
+    printf("==============================================\n");
+    printf("IP cores: %d, AAD: %d bytes, %d keys, %d jobs per batch\n\n",
+           aes_device_count(), AAD_SIZE, NUM_KEYS, NUM_JOBS);
+
+    printf("Calibrated cost per message\n");
+    printf("AAD + payload (B) |   IP (ns) |  CPU (ns)\n");
+    printf("------------------|-----------|----------\n");
+    for (size_t s = 0; s < sizeof(cost_sizes) / sizeof(cost_sizes[0]); s++) {
+        double hw = aesgcm_hybrid_cost(h, AESGCM_HYBRID_HW, AAD_SIZE, cost_sizes[s] - AAD_SIZE);
+        double cpu = aesgcm_hybrid_cost(h, AESGCM_HYBRID_CPU, AAD_SIZE, cost_sizes[s] - AAD_SIZE);
+
+        if (hw > 0.0) {
+            printf("%17zu | %9.0f | %9.0f\n", cost_sizes[s], hw, cpu);
+        } else {
+            printf("%17zu | %9s | %9.0f\n", cost_sizes[s], "-", cpu);
+        }
+    }
+
+    printf("\nIP routing: %s\n", aesgcm_hybrid_hw_routed(h) ? "on, the split beat the CPU alone at calibration" :
+           "off, the split did not beat the CPU alone at calibration");
+
+    setup_jobs(jobs, ivs, in, out);
+    for (size_t i = 0; i < NUM_JOBS; i++) bytes += jobs[i].len;
+    printf("\nMixed workload: 50%% 64 B, 30%% 512 B, 20%% ~%d B, %.2f MB per batch\n",
+           MAX_PAYLOAD, bytes / 1e6);
+    printf("Route    |    MB/s |    Ops/s | IP jobs | CPU jobs | Speedup\n");
+    printf("---------|---------|----------|---------|----------|--------\n");
+
+    // The route order rotates so that no route always follows IP work (the simulator spins after it)
+    uint64_t best[3] = { 0 }, count[3][AESGCM_HYBRID_PATHS] = { { 0 } };
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int k = 0; k < 3; k++) {
+            int m = (r + k) % 3;
+            uint64_t before[AESGCM_HYBRID_PATHS], after[AESGCM_HYBRID_PATHS], ns;
+
+            aesgcm_hybrid_counts(h, before);
+            ns = run(h, jobs, flags[m]);
+            aesgcm_hybrid_counts(h, after);
+            if (ns == 0) {
+                printf("%-8s | batch failed\n", names[m]);
+                return 1;
+            }
+
+            // Every route must produce what the first CPU-only batch produced
+            if (r == 0 && k == 0) {
+                memcpy(ref, out, (size_t)NUM_JOBS * MAX_PAYLOAD);
+                for (size_t i = 0; i < NUM_JOBS; i++) memcpy(ref_tags[i], jobs[i].tag, 16);
+            } else {
+                for (size_t i = 0; i < NUM_JOBS; i++) {
+                    if (memcmp(jobs[i].out, ref + i * MAX_PAYLOAD, jobs[i].len) ||
+                        memcmp(jobs[i].tag, ref_tags[i], 16)) {
+                        printf("%-8s | job %zu does not match the CPU result\n", names[m], i);
+                        return 1;
+                    }
+                }
+            }
+
+            if (best[m] == 0 || ns < best[m]) {
+                best[m] = ns;
+            }
+            for (int p = 0; p < AESGCM_HYBRID_PATHS; p++) {
+                count[m][p] = after[p] - before[p];
+            }
+            memset(out, 0, (size_t)NUM_JOBS * MAX_PAYLOAD);
+        }
+    }
+
+    for (int m = 0; m < 3; m++) {
+        double mbps = bytes * 1e3 / best[m];
+
+        printf("%-8s | %7.2f | %8.0f | %7llu | %8llu | %6.2fx\n", names[m], mbps, NUM_JOBS * 1e9 / best[m],
+               (unsigned long long)count[m][AESGCM_HYBRID_HW], (unsigned long long)count[m][AESGCM_HYBRID_CPU],
+               (double)best[0] / best[m]);
+    }
+
+    aesgcm_hybrid_destroy(h);
+    close_device();
+    free(ref_tags);
+    free(ref);
+    free(out);
+    free(in);
+    free(ivs);
+    free(jobs);
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <openssl/evp.h>
+#include "aesgcm_large.h"
+#include "ghash.h"
+#include "KR260_ioctl.h"
+
+#define AAD_SIZE        20
+#define MIN_SIZE        2048
+#define DEFAULT_MAX_MB  64
+
+// Function to calculate time difference in nanoseconds
+uint64_t time_diff_ns(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1000000000ULL + (end.tv_nsec - start.tv_nsec);
+}
+
+// Reference AES-256-GCM through OpenSSL, as in aesgcm_sw_encrypt.c
+static int reference_encrypt(const uint8_t *key, const uint8_t *iv, const uint8_t *aad, int aad_len,
+                             const uint8_t *in, uint8_t *out, size_t len, uint8_t *tag) {
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    size_t pos = 0;
+    int outl, ok;
+
+    ok = ctx && EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, key, iv) == 1 &&
+         EVP_EncryptUpdate(ctx, NULL, &outl, aad, aad_len) == 1;
+    // EVP lengths are int, feed large messages in pieces
+    while (ok && pos < len) {
+        int n = len - pos < (1 << 30) ? (int)(len - pos) : (1 << 30);
+        ok = EVP_EncryptUpdate(ctx, out + pos, &outl, in + pos, n) == 1;
+        pos += n;
+    }
+    ok = ok && EVP_EncryptFinal_ex(ctx, out + pos, &outl) == 1 &&
+         EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16, tag) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    uint8_t key[32], iv[12], aad[AAD_SIZE], tag[16], ref_tag[16];
+    size_t max_size = (size_t)DEFAULT_MAX_MB << 20;
+    uint8_t *plaintext, *ciphertext, *reference, *decrypted;
+    int use_hw = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--hw") == 0) {
+            use_hw = 1;
+        } else {
+            max_size = (size_t)strtoul(argv[i], NULL, 0) << 20;
+        }
+    }
+    if (max_size < MIN_SIZE || max_size > ((size_t)1 << 30)) {
+        printf("Usage: %s [--hw] [max size in MB, 1..1024]\n", argv[0]);
+        return 1;
+    }
+
+    plaintext = malloc(max_size);
+    ciphertext = malloc(max_size);
+    reference = malloc(max_size);
+    decrypted = malloc(max_size);
+    if (!plaintext || !ciphertext || !reference || !decrypted) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(0x12 + i);
+    for (int i = 0; i < 12; i++) iv[i] = (uint8_t)(0x34 + i);
+    for (int i = 0; i < AAD_SIZE; i++) aad[i] = (uint8_t)i;
+    for (size_t i = 0; i < max_size; i++) plaintext[i] = (uint8_t)(i * 7 + (i >> 11));
+
+    printf("Large-message AES-256-GCM Benchmark\n");
+    printf("===================================\n");
+    printf("Keystream: %s, GHASH: %s, AAD: %d bytes\n\n",
+           use_hw ? "IP first window + CPU CTR" : "CPU CTR", ghash_impl(), AAD_SIZE);
+    printf("Size (bytes)  |  OpenSSL (MB/s)  |  Large (MB/s)  |  Decrypt (MB/s)  | Match\n");
+    printf("--------------|------------------|----------------|------------------|------\n");
+
+    // Sizes from 2 KB doubling up to max_size, each with an odd tail to cover partial blocks
+    for (size_t size = MIN_SIZE; size <= max_size; size *= 2) {
+        size_t len = size == MIN_SIZE ? size : size - 13;
+        struct timespec start, end;
+        double ref_ns, enc_ns, dec_ns;
+        int match;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (reference_encrypt(key, iv, aad, AAD_SIZE, plaintext, reference, len, ref_tag) < 0) {
+            printf("OpenSSL reference failed\n");
+            return 1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        ref_ns = time_diff_ns(start, end);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (aesgcm_large_encrypt(key, iv, aad, AAD_SIZE, plaintext, ciphertext, len, tag, use_hw) < 0) {
+            printf("%-13zu | encrypt failed\n", len);
+            return 1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        enc_ns = time_diff_ns(start, end);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        match = aesgcm_large_decrypt(key, iv, aad, AAD_SIZE, ciphertext, decrypted, len, tag, use_hw) == 0;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        dec_ns = time_diff_ns(start, end);
+
+        match = match && memcmp(ciphertext, reference, len) == 0 && memcmp(tag, ref_tag, 16) == 0 &&
+                memcmp(decrypted, plaintext, len) == 0;
+        printf("%-13zu | %16.1f | %14.1f | %16.1f | %s\n", len,
+               len * 1000.0 / ref_ns, len * 1000.0 / enc_ns, len * 1000.0 / dec_ns, match ? "yes" : "NO");
+        if (!match) {
+            return 1;
+        }
+    }
+
+    // A flipped ciphertext bit must be rejected
+    if (aesgcm_large_encrypt(key, iv, aad, AAD_SIZE, plaintext, ciphertext, MIN_SIZE, tag, use_hw) < 0) {
+        printf("Encrypt failed\n");
+        return 1;
+    }
+    ciphertext[MIN_SIZE / 2] ^= 1;
+    if (aesgcm_large_decrypt(key, iv, aad, AAD_SIZE, ciphertext, decrypted, MIN_SIZE, tag, use_hw) == 0 ||
+        errno != EBADMSG) {
+        printf("\nTampered ciphertext was accepted\n");
+        return 1;
+    }
+    printf("\nTampered ciphertext rejected\n");
+
+    if (use_hw) {
+        close_device();
+    }
+    free(plaintext);
+    free(ciphertext);
+    free(reference);
+    free(decrypted);
+    return 0;
+}
@@ -7,8 +7,9 @@
 #include <sys/mman.h>
 #include <errno.h>
 #include <string.h>
+#include "KR260.h"
 
-#define BASE_ADDR   0xA0000000
+#define BASE_ADDR   AES_BASE_ADDR
 #define START_OFFSET 0x2000
 #define END_OFFSET   0xF000
 #define MAP_SIZE    (END_OFFSET - START_OFFSET)
@@ -66,7 +67,7 @@ uint32_t generate_aligned_offset(int wordsize) {
 }
 
 // Benchmark read operations
-void benchmark_read(void *mapped_base, int wordsize) {
+void benchmark_read(struct kr260_session *s, int wordsize) {
     struct timespec start, end;
     uint64_t elapsed_us, total_us = 0;
     uint64_t value = 0;
@@ -91,16 +92,16 @@ void benchmark_read(void *mapped_base, int wordsize) {
         // Direct memory access based on wordsize
         switch (wordsize) {
             case 8:
-                value = *((volatile uint8_t *)((char *)mapped_base + offset - START_OFFSET));
+                value = kr260_read8(s, offset);
                 break;
             case 16:
-                value = *((volatile uint16_t *)((char *)mapped_base + offset - START_OFFSET));
+                value = kr260_read16(s, offset);
                 break;
             case 32:
-                value = *((volatile uint32_t *)((char *)mapped_base + offset - START_OFFSET));
+                value = kr260_read32(s, offset);
                 break;
             case 64:
-                value = *((volatile uint64_t *)((char *)mapped_base + offset - START_OFFSET));
+                value = kr260_read64(s, offset);
                 break;
         }
         
@@ -125,7 +126,7 @@ void benchmark_read(void *mapped_base, int wordsize) {
 }
 
 // Benchmark write operations
-void benchmark_write(void *mapped_base, int wordsize) {
+void benchmark_write(struct kr260_session *s, int wordsize) {
     struct timespec start, end;
     uint64_t elapsed_us, total_us = 0;
     uint32_t offset;
@@ -169,16 +170,16 @@ void benchmark_write(void *mapped_base, int wordsize) {
         // Direct memory access based on wordsize
         switch (wordsize) {
             case 8:
-                *((volatile uint8_t *)((char *)mapped_base + offset - START_OFFSET)) = (uint8_t)written_value;
+                kr260_write8(s, offset, (uint8_t)written_value);
                 break;
             case 16:
-                *((volatile uint16_t *)((char *)mapped_base + offset - START_OFFSET)) = (uint16_t)written_value;
+                kr260_write16(s, offset, (uint16_t)written_value);
                 break;
             case 32:
-                *((volatile uint32_t *)((char *)mapped_base + offset - START_OFFSET)) = (uint32_t)written_value;
+                kr260_write32(s, offset, (uint32_t)written_value);
                 break;
             case 64:
-                *((volatile uint64_t *)((char *)mapped_base + offset - START_OFFSET)) = written_value;
+                kr260_write64(s, offset, written_value);
                 break;
         }
         
@@ -203,8 +204,7 @@ void benchmark_write(void *mapped_base, int wordsize) {
 }
 
 int main() {
-    int fd;
-    void *map_base;
+    struct kr260_session session;
     int wordsizes[] = {8, 16, 32, 64};
     int num_sizes = sizeof(wordsizes) / sizeof(wordsizes[0]);
     
@@ -216,33 +216,23 @@ int main() {
     printf("Address range: 0x%08X - 0x%08X\n", BASE_ADDR + START_OFFSET, BASE_ADDR + END_OFFSET);
     printf("Operations per test: %d\n\n", NUM_OPERATIONS);
     
-    // Open /dev/mem for physical memory access
-    fd = open("/dev/mem", O_RDWR | O_SYNC);
-    if (fd == -1) {
-        printf("Error opening /dev/mem: %s\n", strerror(errno));
+    // Open the register window once for the whole benchmark
+    if (kr260_open(&session) < 0) {
         return 1;
     }
     
-    // Map the AES register region
-    map_base = mmap(0, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, BASE_ADDR + START_OFFSET);
-    if (map_base == MAP_FAILED) {
-        printf("Error mapping memory: %s\n", strerror(errno));
-        close(fd);
-        return 1;
-    }
-    
-    printf("Memory mapped successfully at virtual address %p\n\n", map_base);
+    printf("Memory mapped successfully at virtual address %p\n\n", (void *)session.base);
     
     // Benchmark read operations for each wordsize
     printf("\n===== READ BENCHMARKS =====\n\n");
     for (int i = 0; i < num_sizes; i++) {
-        benchmark_read(map_base, wordsizes[i]);
+        benchmark_read(&session, wordsizes[i]);
     }
     
     // Benchmark write operations for each wordsize
     printf("\n===== WRITE BENCHMARKS =====\n\n");
     for (int i = 0; i < num_sizes; i++) {
-        benchmark_write(map_base, wordsizes[i]);
+        benchmark_write(&session, wordsizes[i]);
     }
     
     // Print a summary table
@@ -260,10 +250,6 @@ int main() {
            wordsize_64_read_avg, wordsize_64_write_avg);
     
     // Unmap and close
-    if (munmap(map_base, MAP_SIZE) == -1) {
-        printf("Error unmapping memory: %s\n", strerror(errno));
-    }
-    
-    close(fd);
+    kr260_close(&session);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "KR260_ioctl.h"
+
+#define AAD_SIZE        16
+#define NUM_OPERATIONS  20000
+
+#define MOVER_PARAM     "/sys/module/aes256gcm10g25g/parameters/dma_mover"
+#define MOVER_ATTR      "/sys/class/aes256gcm10g25g/aes256gcm0/mover"
+
+static const uint32_t sizes[] = { 64, 256, 1024, 2048 - AAD_SIZE };
+
+static uint8_t key[32];
+static uint8_t iv[12];
+static uint8_t aad[AAD_SIZE];
+static uint8_t plaintext[2048];
+static uint8_t expected[2048];
+static uint8_t expected_tag[16];
+static int key_handle;
+
+// Function to calculate time difference in nanoseconds
+uint64_t time_diff_ns(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1000000000ULL + (end.tv_nsec - start.tv_nsec);
+}
+
+// Select the driver's data mover, -1 when the module parameter cannot be written
+static int set_dma(int on) {
+    FILE *f = fopen(MOVER_PARAM, "w");
+    int ret;
+
+    if (!f) {
+        return -1;
+    }
+    ret = fprintf(f, "%c\n", on ? 'Y' : 'N') < 0 ? -1 : 0;
+    if (fclose(f) != 0) {
+        ret = -1;
+    }
+    return ret;
+}
+
+// Name of the DMA channel moving the window data, 0 when the CPU copies
+static int dma_channel(char *name, size_t size) {
+    FILE *f = fopen(MOVER_ATTR, "r");
+
+    if (!f) {
+        return 0;
+    }
+    if (!fgets(name, (int)size, f)) {
+        name[0] = '\0';
+    }
+    fclose(f);
+    name[strcspn(name, "\n")] = '\0';
+    return name[0] && strcmp(name, "cpu") != 0;
+}
+
+// Encrypt NUM_OPERATIONS messages, return MB/s and the bytes moved by DMA per operation
+static double run(uint32_t len, double *dma_bytes) {
+    struct aes_stats_snapshot before, after;
+    struct timespec start, end;
+    int have_stats = aes_read_stats(&before) == 0;
+    uint8_t out[2048], tag[16];
+
+    if (aes_gcm_run_key(key_handle, AES_MODE_ENCRYPT, iv, aad, AAD_SIZE, plaintext, expected, len,
+                        expected_tag) < 0) {
+        return 0.0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int n = 0; n < NUM_OPERATIONS; n++) {
+        if (aes_gcm_run_key(key_handle, AES_MODE_ENCRYPT, iv, aad, AAD_SIZE, plaintext, out, len, tag) < 0) {
+            return 0.0;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (memcmp(out, expected, len) || memcmp(tag, expected_tag, 16)) {
+        return 0.0;
+    }
+    *dma_bytes = -1.0;
+    if (have_stats && aes_read_stats(&after) == 0) {
+        *dma_bytes = (double)(after.stat[AES_STAT_DMA_BYTES] - before.stat[AES_STAT_DMA_BYTES]) / NUM_OPERATIONS;
+    }
+    return (double)NUM_OPERATIONS * len * 1e3 / time_diff_ns(start, end);
+}
+
+int main() {
+    char channel[64] = "";
+    int has_dma;
+
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(0x12 + i);
+    for (int i = 0; i < 12; i++) iv[i] = (uint8_t)(0x34 + i);
+    for (int i = 0; i < AAD_SIZE; i++) aad[i] = (uint8_t)i;
+    for (int i = 0; i < 2048; i++) plaintext[i] = (uint8_t)i;
+
+    printf("AES-GCM Data Mover Benchmark\n");
+    printf("============================\n");
+
+    key_handle = aes_key_register(key);
+    if (key_handle < 0) {
+        printf("Failed to register the key\n");
+        close_device();
+        return 1;
+    }
+
+    // The CPU path is always measured, the DMA path only when the driver has a channel
+    has_dma = set_dma(1) == 0 && dma_channel(channel, sizeof(channel));
+    printf("AAD: %d bytes, operations per test: %d, DMA channel: %s\n\n", AAD_SIZE, NUM_OPERATIONS,
+           has_dma ? channel : "none");
+
+    printf("Payload (B) | CPU (MB/s) | DMA (MB/s) | DMA (B/op) | Speedup\n");
+    printf("------------|------------|------------|------------|--------\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        double cpu_rate, dma_rate = 0.0, dma_bytes = -1.0, unused;
+        char dma_str[16] = "n/a", bytes_str[16] = "n/a", speedup_str[16] = "n/a";
+
+        if (has_dma && set_dma(0) < 0) {
+            printf("Failed to select the CPU mover\n");
+            break;
+        }
+        cpu_rate = run(sizes[s], &unused);
+        if (has_dma) {
+            set_dma(1);
+            dma_rate = run(sizes[s], &dma_bytes);
+        }
+        if (cpu_rate == 0.0 || (has_dma && dma_rate == 0.0)) {
+            printf("Encryption failed or did not match (%u bytes)\n", sizes[s]);
+            aes_key_unregister(key_handle);
+            close_device();
+            return 1;
+        }
+        if (has_dma) {
+            snprintf(dma_str, sizeof(dma_str), "%.2f", dma_rate);
+            snprintf(speedup_str, sizeof(speedup_str), "%.2fx", dma_rate / cpu_rate);
+            if (dma_bytes >= 0.0) {
+                snprintf(bytes_str, sizeof(bytes_str), "%.0f", dma_bytes);
+            }
+        }
+        printf("%11u | %10.2f | %10s | %10s | %7s\n", sizes[s], cpu_rate, dma_str, bytes_str, speedup_str);
+    }
+
+    aes_key_unregister(key_handle);
+    close_device();
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "KR260_ioctl.h"
+
+#define AAD_SIZE        16
+#define OPS_PER_THREAD  5000
+#define MAX_THREADS     16
+
+static const uint32_t sizes[] = { 256, 2048 - AAD_SIZE };
+
+static uint8_t key[32];
+static uint8_t aad[AAD_SIZE];
+static uint8_t plaintext[2048];
+static uint8_t expected[2048];
+static uint8_t expected_tag[16];
+static int key_handle;
+
+struct worker {
+    pthread_t thread;
+    uint32_t len;
+    int failed;
+};
+
+// Function to calculate time difference in nanoseconds
+uint64_t time_diff_ns(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1000000000ULL + (end.tv_nsec - start.tv_nsec);
+}
+
+// Encrypt through the shared file, the driver picks the core of every operation
+static void *worker_run(void *arg) {
+    struct worker *w = arg;
+    uint8_t iv[12], out[2048], tag[16];
+
+    for (int i = 0; i < 12; i++) iv[i] = (uint8_t)(0x34 + i);
+    for (int n = 0; n < OPS_PER_THREAD; n++) {
+        if (aes_gcm_run_key(key_handle, AES_MODE_ENCRYPT, iv, aad, AAD_SIZE, plaintext, out, w->len, tag) < 0 ||
+            (n == 0 && (memcmp(out, expected, w->len) || memcmp(tag, expected_tag, 16)))) {
+            w->failed = 1;
+            break;
+        }
+    }
+    return NULL;
+}
+
+// Operations per second with threads submitting concurrently
+static double rate(int threads, uint32_t len) {
+    struct worker workers[MAX_THREADS];
+    struct timespec start, end;
+    uint8_t iv[12];
+
+    for (int i = 0; i < 12; i++) iv[i] = (uint8_t)(0x34 + i);
+    if (aes_gcm_run_key(key_handle, AES_MODE_ENCRYPT, iv, aad, AAD_SIZE, plaintext, expected, len,
+                        expected_tag) < 0) {
+        return 0.0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int t = 0; t < threads; t++) {
+        workers[t].len = len;
+        workers[t].failed = 0;
+        if (pthread_create(&workers[t].thread, NULL, worker_run, &workers[t]) != 0) {
+            perror("pthread_create failed");
+            exit(1);
+        }
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(workers[t].thread, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (int t = 0; t < threads; t++) {
+        if (workers[t].failed) {
+            return 0.0;
+        }
+    }
+    return (double)threads * OPS_PER_THREAD * 1e9 / time_diff_ns(start, end);
+}
+
+int main(int argc, char *argv[]) {
+    int cores = aes_device_count();
+    int max_threads = argc > 1 ? atoi(argv[1]) : (cores > 0 ? cores : 1);
+
+    if (max_threads < 1 || max_threads > MAX_THREADS) {
+        printf("Usage: %s [threads, 1..%d]\n", argv[0], MAX_THREADS);
+        return 1;
+    }
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(0x12 + i);
+    for (int i = 0; i < AAD_SIZE; i++) aad[i] = (uint8_t)i;
+    for (int i = 0; i < 2048; i++) plaintext[i] = (uint8_t)i;
+
+    printf("AES-GCM Multi-Core Benchmark\n");
+    printf("============================\n");
+    printf("Cores: %d, threads: 1..%d, operations per thread: %d\n\n", cores, max_threads, OPS_PER_THREAD);
+
+    // A registered handle is valid on every core, only KEYIN is reloaded when a core changes
+    key_handle = aes_key_register(key);
+    if (key_handle < 0) {
+        printf("Failed to register the key\n");
+        close_device();
+        return 1;
+    }
+
+    printf("Threads | Payload (B) |     ops/s |      MB/s | Scaling\n");
+    printf("--------|-------------|-----------|-----------|--------\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        double base = 0.0;
+
+        for (int threads = 1; threads <= max_threads; threads++) {
+            double r = rate(threads, sizes[s]);
+
+            if (r == 0.0) {
+                printf("Encryption with %d thread(s) failed or did not match\n", threads);
+                aes_key_unregister(key_handle);
+                close_device();
+                return 1;
+            }
+            if (threads == 1) {
+                base = r;
+            }
+            printf("%7d | %11u | %9.0f | %9.2f | %6.2fx\n", threads, sizes[s], r, r * sizes[s] / 1e6, r / base);
+        }
+    }
+
+    aes_key_unregister(key_handle);
+    close_device();
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "KR260.h"
+
+#define AAD_SIZE        16
+#define JOBS_PER_RUN    64      /* Jobs handed to one aes_pipe_run */
+#define NUM_OPERATIONS  20000
+
+// Largest payloads that fit 4, 2 and 1 slot(s) of the BRAM with the AAD
+static const uint32_t sizes[] = { 64, 256, AES_DATA_SIZE / 4 - AAD_SIZE, AES_DATA_SIZE / 2 - AAD_SIZE,
+                                  AES_DATA_SIZE - AAD_SIZE };
+
+static uint8_t key[32];
+static uint8_t aad[AAD_SIZE];
+static uint8_t plaintext[JOBS_PER_RUN][AES_DATA_SIZE];
+static uint8_t ciphertext[JOBS_PER_RUN][AES_DATA_SIZE];
+static uint8_t decrypted[JOBS_PER_RUN][AES_DATA_SIZE];
+static struct aes_pipe_job jobs[JOBS_PER_RUN];
+
+// Function to calculate time difference in nanoseconds
+uint64_t time_diff_ns(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1000000000ULL + (end.tv_nsec - start.tv_nsec);
+}
+
+// Fill the job list, every job with its own IV and buffers
+static void fill_jobs(unsigned int mode, uint32_t len) {
+    for (int i = 0; i < JOBS_PER_RUN; i++) {
+        jobs[i].mode = mode;
+        for (int j = 0; j < 12; j++) jobs[i].iv[j] = (uint8_t)(0x34 + j);
+        jobs[i].iv[11] = (uint8_t)i;
+        jobs[i].aad = aad;
+        jobs[i].aad_len = AAD_SIZE;
+        jobs[i].in = mode == AES_MODE_DECRYPT ? ciphertext[i] : plaintext[i];
+        jobs[i].out = mode == AES_MODE_DECRYPT ? decrypted[i] : ciphertext[i];
+        jobs[i].data_len = len;
+    }
+}
+
+// Encrypt and decrypt one run with the given slot count, check against aes_gcm_run
+static int verify(unsigned int slots, uint32_t len) {
+    struct aes_pipe pipe;
+    uint8_t expected[AES_DATA_SIZE], tag[16];
+
+    if (aes_pipe_init(&pipe, NULL, slots) < 0) {
+        return -1;
+    }
+    fill_jobs(AES_MODE_ENCRYPT, len);
+    if (aes_pipe_run(&pipe, key, jobs, JOBS_PER_RUN) != JOBS_PER_RUN) {
+        return -1;
+    }
+    for (int i = 0; i < JOBS_PER_RUN; i++) {
+        if (aes_gcm_run(AES_MODE_ENCRYPT, key, jobs[i].iv, aad, AAD_SIZE, plaintext[i], expected, len, tag) < 0 ||
+            memcmp(expected, ciphertext[i], len) || memcmp(tag, jobs[i].tag, 16)) {
+            return -1;
+        }
+    }
+
+    // A wrong tag fails only its own job and leaves its output untouched
+    fill_jobs(AES_MODE_DECRYPT, len);
+    memset(decrypted, 0, sizeof(decrypted));
+    jobs[1].tag[0] ^= 1;
+    if (aes_pipe_run(&pipe, NULL, jobs, JOBS_PER_RUN) != JOBS_PER_RUN - 1 || jobs[1].status != EBADMSG) {
+        return -1;
+    }
+    for (int i = 0; i < JOBS_PER_RUN; i++) {
+        if (i == 1 ? decrypted[i][0] != 0 : memcmp(decrypted[i], plaintext[i], len) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Largest payload a job of the benchmark can have with the given slot count
+static uint32_t slot_payload(unsigned int slots) {
+    struct aes_pipe pipe;
+
+    return aes_pipe_init(&pipe, NULL, slots) < 0 ? 0 : pipe.slot_size - AAD_SIZE;
+}
+
+// Operations per second for encrypting len-byte messages with the given slot count, 0 when they do not fit
+static double pipe_rate(unsigned int slots, uint32_t len) {
+    struct aes_pipe pipe;
+    struct timespec start, end;
+
+    if (aes_pipe_init(&pipe, NULL, slots) < 0 || len > slot_payload(slots)) {
+        return 0.0;
+    }
+    fill_jobs(AES_MODE_ENCRYPT, len);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int done = 0; done < NUM_OPERATIONS; done += JOBS_PER_RUN) {
+        if (aes_pipe_run(&pipe, done ? NULL : key, jobs, JOBS_PER_RUN) != JOBS_PER_RUN) {
+            return 0.0;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)((NUM_OPERATIONS + JOBS_PER_RUN - 1) / JOBS_PER_RUN * JOBS_PER_RUN) * 1e9 /
+           time_diff_ns(start, end);
+}
+
+int main() {
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(0x12 + i);
+    for (int i = 0; i < AAD_SIZE; i++) aad[i] = (uint8_t)i;
+    for (int i = 0; i < JOBS_PER_RUN; i++) {
+        for (int j = 0; j < AES_DATA_SIZE; j++) plaintext[i][j] = (uint8_t)(i + j);
+    }
+
+    printf("AES-GCM Pipelined Slot Benchmark\n");
+    printf("================================\n");
+    printf("Jobs per run: %d, AAD: %d bytes, operations per test: %d\n\n",
+           JOBS_PER_RUN, AAD_SIZE, NUM_OPERATIONS);
+
+    if (!kr260_default_session()) {
+        printf("Failed to map the AES window\n");
+        return 1;
+    }
+
+    // Every slot count must match aes_gcm_run, including full slots up to the end of the BRAM
+    for (unsigned int slots = 1; slots <= AES_PIPE_MAX_SLOTS; slots++) {
+        if (verify(slots, slot_payload(slots)) < 0 || verify(slots, 64) < 0) {
+            printf("Pipelined output with %u slot(s) does not match aes_gcm_run\n", slots);
+            close_device();
+            return 1;
+        }
+    }
+
+    // Completion is awaited by spinning, so the overlap is not hidden behind sleeps
+    aes_set_wait_mode(AES_WAIT_SPIN);
+
+    printf("Payload (B) | Serial (ops/s) | 2 slots (ops/s) | 3 slots (ops/s) | 4 slots (ops/s) | Best gain\n");
+    printf("------------|----------------|-----------------|-----------------|-----------------|----------\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        double rate[AES_PIPE_MAX_SLOTS + 1], best = 0.0;
+
+        for (unsigned int slots = 1; slots <= AES_PIPE_MAX_SLOTS; slots++) {
+            rate[slots] = pipe_rate(slots, sizes[s]);
+            if (slots > 1 && rate[slots] > best) {
+                best = rate[slots];
+            }
+        }
+        printf("%11u |", sizes[s]);
+        for (unsigned int slots = 1; slots <= AES_PIPE_MAX_SLOTS; slots++) {
+            // Messages larger than a slot cannot be pipelined with that many slots
+            if (rate[slots] > 0.0) {
+                printf(slots == 1 ? " %14.0f |" : " %15.0f |", rate[slots]);
+            } else {
+                printf(slots == 1 ? " %14s |" : " %15s |", "-");
+            }
+        }
+        if (best > 0.0 && rate[1] > 0.0) {
+            printf(" %8.2fx\n", best / rate[1]);
+        } else {
+            printf(" %9s\n", "-");
+        }
+    }
+
+    close_device();
+    return 0;
+}
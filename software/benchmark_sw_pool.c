@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "aesgcm_pool.h"
+#include "aesgcm_session.h"
+
+#define AAD_SIZE        16
+#define NUM_KEYS        4
+#define BATCH_BYTES     (32u << 20)     /* Payload per batch */
+#define MAX_JOBS        65536
+#define MIN_JOBS        32
+
+static const size_t sizes[] = { 64, 1024, 16384, 262144, 1048576 };
+
+static uint8_t keys[NUM_KEYS][32];
+static uint8_t aad[AAD_SIZE];
+
+struct order_check {
+    size_t next;
+    int    out_of_order;
+};
+
+// Function to calculate time difference in nanoseconds
+uint64_t time_diff_ns(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1000000000ULL + (end.tv_nsec - start.tv_nsec);
+}
+
+// Ordered delivery must see every index once, ascending
+static void check_order(struct aesgcm_job *job, size_t index, void *arg) {
+    struct order_check *c = arg;
+
+    (void)job;
+    if (index != c->next++) {
+        c->out_of_order = 1;
+    }
+}
+
+// n messages of len bytes, each with its own IV, keys shared by contiguous runs of jobs
+static void setup_jobs(struct aesgcm_job *jobs, uint8_t (*ivs)[12], const uint8_t *in, uint8_t *out,
+                       size_t n, size_t len) {
+    for (size_t i = 0; i < n; i++) {
+        memset(ivs[i], 0x34, 12);
+        memcpy(ivs[i], &i, sizeof(i));
+        jobs[i] = (struct aesgcm_job){
+            .key = keys[i * NUM_KEYS / n], .iv = ivs[i], .aad = aad, .aad_len = AAD_SIZE,
+            .in = in + i * len, .out = out + i * len, .len = len,
+        };
+    }
+}
+
+// Compare the batch with one session per key on the calling thread
+static int verify(struct aesgcm_job *jobs, size_t n) {
+    struct aesgcm_session sess[NUM_KEYS];
+    uint8_t tag[16], *ct = malloc(jobs[0].len);
+    int ok = ct != NULL;
+
+    for (int k = 0; k < NUM_KEYS; k++) {
+        if (aesgcm_session_init(&sess[k], keys[k]) < 0) {
+            ok = 0;
+        }
+    }
+    for (size_t i = 0; ok && i < n; i++) {
+        int k = (int)(i * NUM_KEYS / n);
+
+        ok = jobs[i].status == 0 &&
+             aesgcm_session_encrypt(&sess[k], jobs[i].iv, aad, AAD_SIZE, jobs[i].in, ct, jobs[i].len, tag) == 0 &&
+             memcmp(ct, jobs[i].out, jobs[i].len) == 0 && memcmp(tag, jobs[i].tag, 16) == 0;
+    }
+    for (int k = 0; k < NUM_KEYS; k++) {
+        aesgcm_session_free(&sess[k]);
+    }
+    free(ct);
+    return ok ? 0 : -1;
+}
+
+// MB/s of one batch on threads workers, 0 on failure
+static double run(int threads, struct aesgcm_job *jobs, size_t n, int flags, int check) {
+    struct aesgcm_pool *pool = aesgcm_pool_create(threads);
+    struct order_check order = { 0, 0 };
+    struct timespec start, end;
+    int failed;
+
+    if (!pool) {
+        return 0.0;
+    }
+    // First batch warms up the worker contexts
+    aesgcm_pool_run(pool, jobs, n < MIN_JOBS ? n : MIN_JOBS, 0, NULL, NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    failed = aesgcm_pool_run(pool, jobs, n, flags, (flags & AESGCM_POOL_ORDERED) ? check_order : NULL, &order);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    aesgcm_pool_destroy(pool);
+
+    if (failed != 0 || order.out_of_order || ((flags & AESGCM_POOL_ORDERED) && order.next != n) ||
+        (check && verify(jobs, n) < 0)) {
+        return 0.0;
+    }
+    return (double)n * jobs[0].len * 1e3 / time_diff_ns(start, end);
+}
+
+int main(int argc, char *argv[]) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = argc > 1 ? atoi(argv[1]) : (cpus > 4 ? (int)cpus : 4);
+    size_t max_jobs = BATCH_BYTES / sizes[0] < MAX_JOBS ? BATCH_BYTES / sizes[0] : MAX_JOBS;
+    struct aesgcm_job *jobs = calloc(max_jobs, sizeof(*jobs));
+    uint8_t (*ivs)[12] = calloc(max_jobs, 12);
+    uint8_t *in = malloc(BATCH_BYTES), *out = malloc(BATCH_BYTES);
+
+    if (max_threads < 1 || max_threads > AESGCM_POOL_MAX_THREADS) {
+        printf("Usage: %s [threads, 1..%d]\n", argv[0], AESGCM_POOL_MAX_THREADS);
+        return 1;
+    }
+    if (!jobs || !ivs || !in || !out) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    for (int k = 0; k < NUM_KEYS; k++) {
+        for (int i = 0; i < 32; i++) keys[k][i] = (uint8_t)(0x12 + i + 0x40 * k);
+    }
+    for (int i = 0; i < AAD_SIZE; i++) aad[i] = (uint8_t)i;
+    for (size_t i = 0; i < BATCH_BYTES; i++) in[i] = (uint8_t)(i * 7 + (i >> 11));
+    memset(out, 0, BATCH_BYTES);
+
+    printf("Software AES-256-GCM Worker Pool Benchmark\n");
+    printf("==========================================\n");
+    printf("CPUs: %ld, threads: 1..%d, AAD: %d bytes, %d keys, up to %u MB per batch\n\n",
+           cpus, max_threads, AAD_SIZE, NUM_KEYS, BATCH_BYTES >> 20);
+
+    printf("Threads | Payload (B) |    Jobs | Unordered (MB/s) | Ordered (MB/s) | Scaling\n");
+    printf("--------|-------------|---------|------------------|----------------|--------\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = BATCH_BYTES / sizes[s];
+        double base = 0.0;
+
+        if (n > MAX_JOBS) {
+            n = MAX_JOBS;
+        }
+        setup_jobs(jobs, ivs, in, out, n, sizes[s]);
+        for (int threads = 1; threads <= max_threads; threads++) {
+            double unordered = run(threads, jobs, n, 0, threads == max_threads);
+            double ordered = run(threads, jobs, n, AESGCM_POOL_ORDERED, threads == max_threads);
+
+            if (unordered == 0.0 || ordered == 0.0) {
+                printf("Batch with %d thread(s) failed, did not match or was delivered out of order\n", threads);
+                return 1;
+            }
+            if (threads == 1) {
+                base = unordered;
+            }
+            printf("%7d | %11zu | %7zu | %16.2f | %14.2f | %6.2fx\n", threads, sizes[s], n, unordered, ordered,
+                   unordered / base);
+        }
+    }
+
+    free(out);
+    free(in);
+    free(ivs);
+    free(jobs);
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <openssl/evp.h>
+#include "aesgcm_session.h"
+
+#define AAD_SIZE        16
+#define NUM_OPERATIONS  200000
+
+static const uint32_t sizes[] = { 64, 512, 2048 };
+
+static uint8_t key[32];
+static uint8_t iv[12];
+static uint8_t aad[AAD_SIZE];
+static uint8_t plaintext[2048];
+static uint8_t ciphertext[2048];
+static uint8_t decrypted[2048];
+static uint8_t tag[16];
+static struct aesgcm_session session;
+
+// Function to calculate time difference in nanoseconds
+uint64_t time_diff_ns(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1000000000ULL + (end.tv_nsec - start.tv_nsec);
+}
+
+// Per-message setup as in encrypt() of aesgcm_sw_encrypt.c, without its stage timings
+static int oneshot_encrypt(const uint8_t *in, uint8_t *out, int len, uint8_t *tag_out) {
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    int outl, ok;
+
+    ok = ctx && EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) == 1 &&
+         EVP_EncryptInit_ex(ctx, NULL, NULL, key, iv) == 1 &&
+         EVP_EncryptUpdate(ctx, NULL, &outl, aad, AAD_SIZE) == 1 &&
+         EVP_EncryptUpdate(ctx, out, &outl, in, len) == 1 &&
+         EVP_EncryptFinal_ex(ctx, out + outl, &outl) == 1 &&
+         EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16, tag_out) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok ? 0 : -1;
+}
+
+// Per-message setup as in decrypt_data() of aesgcm_sw_decrypt.c
+static int oneshot_decrypt(const uint8_t *in, uint8_t *out, int len, const uint8_t *tag_in) {
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    int outl, ok;
+
+    ok = ctx && EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) == 1 &&
+         EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv) == 1 &&
+         EVP_DecryptUpdate(ctx, NULL, &outl, aad, AAD_SIZE) == 1 &&
+         EVP_DecryptUpdate(ctx, out, &outl, in, len) == 1 &&
+         EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, 16, (void *)tag_in) == 1 &&
+         EVP_DecryptFinal_ex(ctx, out + outl, &outl) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok ? 0 : -1;
+}
+
+// Both paths must produce the same ciphertext and tag, and reject a modified tag
+static int verify(uint32_t len) {
+    uint8_t expected[2048], expected_tag[16];
+
+    if (oneshot_encrypt(plaintext, expected, len, expected_tag) < 0 ||
+        aesgcm_session_encrypt(&session, iv, aad, AAD_SIZE, plaintext, ciphertext, len, tag) < 0 ||
+        memcmp(expected, ciphertext, len) || memcmp(expected_tag, tag, 16) ||
+        aesgcm_session_decrypt(&session, iv, aad, AAD_SIZE, ciphertext, decrypted, len, tag) < 0 ||
+        memcmp(decrypted, plaintext, len)) {
+        return -1;
+    }
+    tag[0] ^= 1;
+    if (aesgcm_session_decrypt(&session, iv, aad, AAD_SIZE, ciphertext, decrypted, len, tag) == 0 ||
+        oneshot_decrypt(ciphertext, decrypted, len, tag) == 0) {
+        return -1;
+    }
+    tag[0] ^= 1;
+    return 0;
+}
+
+// Nanoseconds per message, 0 on failure
+static double run(int use_session, int decrypt, uint32_t len) {
+    struct timespec start, end;
+    int ret = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int n = 0; n < NUM_OPERATIONS && ret == 0; n++) {
+        if (use_session) {
+            ret = decrypt ? aesgcm_session_decrypt(&session, iv, aad, AAD_SIZE, ciphertext, decrypted, len, tag)
+                          : aesgcm_session_encrypt(&session, iv, aad, AAD_SIZE, plaintext, ciphertext, len, tag);
+        } else {
+            ret = decrypt ? oneshot_decrypt(ciphertext, decrypted, len, tag)
+                          : oneshot_encrypt(plaintext, ciphertext, len, tag);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ret < 0 ? 0.0 : (double)time_diff_ns(start, end) / NUM_OPERATIONS;
+}
+
+int main() {
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(0x12 + i);
+    for (int i = 0; i < 12; i++) iv[i] = (uint8_t)(0x34 + i);
+    for (int i = 0; i < AAD_SIZE; i++) aad[i] = (uint8_t)i;
+    for (int i = 0; i < 2048; i++) plaintext[i] = (uint8_t)i;
+
+    printf("Software AES-256-GCM Session Benchmark\n");
+    printf("======================================\n");
+    printf("AAD: %d bytes, messages per test: %d\n\n", AAD_SIZE, NUM_OPERATIONS);
+
+    if (aesgcm_session_init(&session, key) < 0) {
+        printf("Failed to create the session\n");
+        return 1;
+    }
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        if (verify(sizes[s]) < 0) {
+            printf("Session results do not match the per-message functions (%u bytes)\n", sizes[s]);
+            aesgcm_session_free(&session);
+            return 1;
+        }
+    }
+
+    printf("Payload (B) | Direction | Per-message (ns) | Session (ns) | Speedup\n");
+    printf("------------|-----------|------------------|--------------|--------\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int decrypt = 0; decrypt <= 1; decrypt++) {
+            double oneshot = run(0, decrypt, sizes[s]);
+            double reuse = run(1, decrypt, sizes[s]);
+
+            if (oneshot == 0.0 || reuse == 0.0) {
+                printf("%s failed\n", decrypt ? "Decryption" : "Encryption");
+                aesgcm_session_free(&session);
+                return 1;
+            }
+            printf("%11u | %-9s | %16.1f | %12.1f | %6.2fx\n", sizes[s], decrypt ? "decrypt" : "encrypt",
+                   oneshot, reuse, oneshot / reuse);
+        }
+    }
+
+    aesgcm_session_free(&session);
+    return 0;
+}
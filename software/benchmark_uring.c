@@ -0,0 +1,403 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "KR260_ioctl.h"
+
+#define PAYLOAD         1024
+#define NUM_OPERATIONS  20000
+#define MAX_DEPTH       64
+#define URING_ENTRIES   256     /* Room for MAX_DEPTH chains of three SQEs */
+#define CHAIN_CHUNKS    2048    /* Chunks of the read -> encrypt -> write test file */
+
+static const int depths[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+static uint8_t key[32];
+static uint8_t iv[12];
+static uint32_t key_handle;
+
+/* Minimal io_uring instance on raw system calls */
+struct uring {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned sq_entries;
+    unsigned tail;          /* Local SQ tail, published by uring_submit */
+    unsigned submitted;     /* Tail the kernel has been told about */
+};
+
+/* One operation slot: the aes_gcm_run must stay valid until its CQE */
+struct slot {
+    struct aes_gcm_run run;
+    struct aes_uring_gcm cmd;
+    uint8_t in[PAYLOAD];
+    uint8_t out[PAYLOAD];
+    uint8_t tag[16];
+};
+
+static struct uring ring;
+static struct slot slots[MAX_DEPTH];
+
+// Function to calculate time difference in nanoseconds
+uint64_t time_diff_ns(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1000000000ULL + (end.tv_nsec - start.tv_nsec);
+}
+
+static int uring_init(struct uring *r, unsigned entries) {
+    struct io_uring_params p;
+    size_t sq_size, cq_size;
+    uint8_t *sq, *cq;
+
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+    r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) {
+        return -1;
+    }
+
+    sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        sq_size = cq_size = sq_size > cq_size ? sq_size : cq_size;
+    }
+    sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+        return -1;
+    }
+    cq = sq;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            return -1;
+        }
+    }
+    r->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        return -1;
+    }
+
+    r->sq_head = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    r->sq_entries = p.sq_entries;
+    r->tail = r->submitted = *r->sq_tail;
+    return 0;
+}
+
+static struct io_uring_sqe *uring_get_sqe(struct uring *r) {
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    unsigned idx;
+
+    if (r->tail - head >= r->sq_entries) {
+        return NULL;
+    }
+    idx = r->tail++ & *r->sq_mask;
+    r->sq_array[idx] = idx;
+    memset(&r->sqes[idx], 0, sizeof(r->sqes[idx]));
+    return &r->sqes[idx];
+}
+
+// Publish new SQEs and wait for wait_nr completions in one system call
+static int uring_submit(struct uring *r, unsigned wait_nr) {
+    unsigned to_submit = r->tail - r->submitted;
+    int ret;
+
+    __atomic_store_n(r->sq_tail, r->tail, __ATOMIC_RELEASE);
+    ret = (int)syscall(__NR_io_uring_enter, r->fd, to_submit, wait_nr,
+                       wait_nr ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    if (ret < 0) {
+        return -1;
+    }
+    r->submitted += (unsigned)ret;
+    return 0;
+}
+
+static struct io_uring_cqe *uring_peek_cqe(struct uring *r) {
+    unsigned head = *r->cq_head;
+
+    if (__atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE) == head) {
+        return NULL;
+    }
+    return &r->cqes[head & *r->cq_mask];
+}
+
+static void uring_cqe_seen(struct uring *r) {
+    __atomic_store_n(r->cq_head, *r->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+// Queue an AES_IOC_GCM_RUN passthrough command for slot s
+static struct io_uring_sqe *prep_gcm(struct slot *s, uint64_t user_data) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+
+    if (!sqe) {
+        return NULL;
+    }
+    aes_gcm_prep(&s->run, key_handle, NULL, AES_MODE_ENCRYPT, iv, NULL, 0, s->in, s->out, PAYLOAD, NULL);
+    s->cmd.run = (uint64_t)(uintptr_t)&s->run;
+    s->cmd.reserved = 0;
+    sqe->opcode = IORING_OP_URING_CMD;
+    sqe->fd = aes_device_fd();
+    sqe->cmd_op = AES_IOC_GCM_RUN;
+    memcpy(sqe->cmd, &s->cmd, sizeof(s->cmd));
+    sqe->user_data = user_data;
+    return sqe;
+}
+
+/* Synchronous ioctls from depth threads */
+static void *sync_thread(void *arg) {
+    uint8_t in[PAYLOAD], out[PAYLOAD], tag[16];
+    int count = *(int *)arg;
+
+    memset(in, 0xA5, sizeof(in));
+    for (int i = 0; i < count; i++) {
+        if (aes_gcm_run_key(key_handle, AES_MODE_ENCRYPT, iv, NULL, 0, in, out, PAYLOAD, tag) < 0) {
+            return (void *)1;
+        }
+    }
+    return NULL;
+}
+
+static double sync_rate(int depth) {
+    pthread_t threads[MAX_DEPTH];
+    struct timespec start, end;
+    int count = NUM_OPERATIONS / depth;
+    void *failed;
+    int ok = 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int t = 0; t < depth; t++) {
+        pthread_create(&threads[t], NULL, sync_thread, &count);
+    }
+    for (int t = 0; t < depth; t++) {
+        pthread_join(threads[t], &failed);
+        ok &= failed == NULL;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ok ? (double)count * depth * 1e9 / time_diff_ns(start, end) : 0.0;
+}
+
+// One thread keeping depth URING_CMD operations in flight
+static double uring_rate(int depth) {
+    struct timespec start, end;
+    struct io_uring_cqe *cqe;
+    int submitted = 0, completed = 0;
+    int free_slots[MAX_DEPTH], nfree = depth;
+
+    for (int i = 0; i < depth; i++) {
+        free_slots[i] = i;
+        memset(slots[i].in, 0xA5, PAYLOAD);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (completed < NUM_OPERATIONS) {
+        while (nfree && submitted < NUM_OPERATIONS) {
+            int s = free_slots[--nfree];
+
+            if (!prep_gcm(&slots[s], (uint64_t)s)) {
+                nfree++;
+                break;
+            }
+            submitted++;
+        }
+        if (uring_submit(&ring, 1) < 0) {
+            return 0.0;
+        }
+        while ((cqe = uring_peek_cqe(&ring)) != NULL) {
+            if (cqe->res != PAYLOAD) {
+                printf("uring_cmd failed: %d\n", cqe->res);
+                return 0.0;
+            }
+            free_slots[nfree++] = (int)cqe->user_data;
+            uring_cqe_seen(&ring);
+            completed++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return NUM_OPERATIONS * 1e9 / time_diff_ns(start, end);
+}
+
+// Check that this device accepts IORING_OP_URING_CMD, and that it matches the ioctl path
+static int uring_probe(void) {
+    uint8_t ref[PAYLOAD], ref_tag[16];
+    struct io_uring_cqe *cqe;
+    int res;
+
+    memset(slots[0].in, 0x5A, PAYLOAD);
+    if (aes_gcm_run_key(key_handle, AES_MODE_ENCRYPT, iv, NULL, 0, slots[0].in, ref, PAYLOAD, ref_tag) < 0 ||
+        !prep_gcm(&slots[0], 0) || uring_submit(&ring, 1) < 0 || !(cqe = uring_peek_cqe(&ring))) {
+        return -1;
+    }
+    res = cqe->res;
+    uring_cqe_seen(&ring);
+    if (res != PAYLOAD) {
+        printf("IORING_OP_URING_CMD not supported by this device (res %d%s%s)\n", res,
+               res < 0 ? ", " : "", res < 0 ? strerror(-res) : "");
+        return -1;
+    }
+    if (memcmp(slots[0].out, ref, PAYLOAD) || memcmp(slots[0].run.tag, ref_tag, 16)) {
+        printf("uring_cmd output does not match AES_IOC_GCM_RUN\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Encrypt a file chunk by chunk as read -> uring_cmd -> write linked chains, check the result
+static int chain_test(void) {
+    char in_path[] = "/tmp/aes_uring_inXXXXXX", out_path[] = "/tmp/aes_uring_outXXXXXX";
+    int in_fd = mkstemp(in_path), out_fd = mkstemp(out_path);
+    uint8_t chunk[PAYLOAD], expected[PAYLOAD], got[PAYLOAD], tag[16];
+    struct timespec start, end;
+    struct io_uring_cqe *cqe;
+    struct io_uring_sqe *sqe;
+    int free_slots[MAX_DEPTH], nfree = MAX_DEPTH;
+    int next = 0, done = 0, ret = -1;
+    uint64_t ns;
+
+    for (int i = 0; i < MAX_DEPTH; i++) {
+        free_slots[i] = i;
+    }
+
+    if (in_fd < 0 || out_fd < 0) {
+        perror("mkstemp failed");
+        goto out;
+    }
+    for (int c = 0; c < CHAIN_CHUNKS; c++) {
+        memset(chunk, (uint8_t)c, sizeof(chunk));
+        if (pwrite(in_fd, chunk, PAYLOAD, (off_t)c * PAYLOAD) != PAYLOAD) {
+            goto out;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (done < CHAIN_CHUNKS) {
+        while (next < CHAIN_CHUNKS && nfree) {
+            int slot = free_slots[--nfree];
+            struct slot *s = &slots[slot];
+            off_t off = (off_t)next * PAYLOAD;
+
+            // The output of each link is the input of the next, nothing returns to user space
+            sqe = uring_get_sqe(&ring);
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = in_fd;
+            sqe->addr = (uint64_t)(uintptr_t)s->in;
+            sqe->len = PAYLOAD;
+            sqe->off = (uint64_t)off;
+            sqe->flags = IOSQE_IO_LINK;
+            sqe->user_data = UINT64_MAX;
+
+            sqe = prep_gcm(s, UINT64_MAX);
+            sqe->flags = IOSQE_IO_LINK;
+
+            sqe = uring_get_sqe(&ring);
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = out_fd;
+            sqe->addr = (uint64_t)(uintptr_t)s->out;
+            sqe->len = PAYLOAD;
+            sqe->off = (uint64_t)off;
+            sqe->user_data = (uint64_t)slot;
+            next++;
+        }
+        if (uring_submit(&ring, 1) < 0) {
+            goto out;
+        }
+        while ((cqe = uring_peek_cqe(&ring)) != NULL) {
+            if (cqe->res < 0) {
+                printf("chain failed: %s\n", strerror(-cqe->res));
+                goto out;
+            }
+            if (cqe->user_data != UINT64_MAX) {
+                free_slots[nfree++] = (int)cqe->user_data;
+                done++;
+            }
+            uring_cqe_seen(&ring);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ns = time_diff_ns(start, end);
+
+    for (int c = 0; c < CHAIN_CHUNKS; c++) {
+        memset(chunk, (uint8_t)c, sizeof(chunk));
+        if (aes_gcm_run_key(key_handle, AES_MODE_ENCRYPT, iv, NULL, 0, chunk, expected, PAYLOAD, tag) < 0 ||
+            pread(out_fd, got, PAYLOAD, (off_t)c * PAYLOAD) != PAYLOAD || memcmp(got, expected, PAYLOAD)) {
+            printf("chain output of chunk %d does not match\n", c);
+            goto out;
+        }
+    }
+    printf("\nLinked read -> encrypt -> write: %d chunks of %d bytes, %.0f chains/s, %.1f MB/s, output verified\n",
+           CHAIN_CHUNKS, PAYLOAD, CHAIN_CHUNKS * 1e9 / ns, (double)CHAIN_CHUNKS * PAYLOAD * 1000.0 / ns);
+    ret = 0;
+
+out:
+    if (in_fd >= 0) {
+        close(in_fd);
+        unlink(in_path);
+    }
+    if (out_fd >= 0) {
+        close(out_fd);
+        unlink(out_path);
+    }
+    return ret;
+}
+
+int main() {
+    double sync[sizeof(depths) / sizeof(depths[0])];
+    int handle, uring_ok;
+
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(0x12 + i);
+    for (int i = 0; i < 12; i++) iv[i] = (uint8_t)(0x34 + i);
+
+    printf("AES-GCM io_uring Passthrough Benchmark\n");
+    printf("======================================\n");
+    printf("Payload: %d bytes, operations per test: %d\n\n", PAYLOAD, NUM_OPERATIONS);
+
+    handle = aes_key_register(key);
+    if (handle < 0) {
+        printf("Key registration failed\n");
+        close_device();
+        return 1;
+    }
+    key_handle = (uint32_t)handle;
+
+    // The synchronous path needs one thread per operation in flight
+    for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+        sync[d] = sync_rate(depths[d]);
+    }
+
+    uring_ok = uring_init(&ring, URING_ENTRIES) == 0 && uring_probe() == 0;
+    if (!uring_ok && ring.fd < 0) {
+        perror("io_uring_setup failed");
+    }
+
+    printf("\nQueue depth | ioctl, N threads (ops/s) | uring_cmd, 1 thread (ops/s) | Speedup\n");
+    printf("------------|--------------------------|------------------------------|--------\n");
+    for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+        if (uring_ok) {
+            double u = uring_rate(depths[d]);
+
+            printf("%11d | %24.0f | %28.0f | %6.2fx\n", depths[d], sync[d], u, sync[d] > 0.0 ? u / sync[d] : 0.0);
+        } else {
+            printf("%11d | %24.0f | %28s |       -\n", depths[d], sync[d], "-");
+        }
+    }
+
+    if (uring_ok) {
+        chain_test();
+    }
+
+    aes_key_unregister(key_handle);
+    close_device();
+    return 0;
+}
@@ -0,0 +1,378 @@
+#include "ghash.h"
+#include <string.h>
+
+// Pick the carry-less multiply: ARMv8 PMULL, x86 PCLMULQDQ, or portable C (force with -DGHASH_GENERIC)
+#if !defined(GHASH_GENERIC) && defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO)
+#define GHASH_PMULL     1
+#include <arm_neon.h>
+#elif !defined(GHASH_GENERIC) && (defined(__x86_64__) || defined(__i386__)) && defined(__PCLMUL__) && defined(__SSSE3__)
+#define GHASH_PCLMUL    1
+#include <immintrin.h>
+#endif
+
+#if defined(GHASH_PCLMUL)
+
+// Internal form: the 16 bytes reversed, so the block is a 128-bit integer with bit order as in
+// the Intel carry-less multiplication white paper
+static inline __m128i ghash_load(const uint8_t *p)
+{
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), bswap);
+}
+
+static inline void ghash_store(uint8_t *p, __m128i x)
+{
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    _mm_storeu_si128((__m128i *)p, _mm_shuffle_epi8(x, bswap));
+}
+
+// Add the unreduced 256-bit product a * b to lo, mid (the cross terms) and hi
+static inline void ghash_mul_acc(__m128i a, __m128i b, __m128i *lo, __m128i *mid, __m128i *hi)
+{
+    *lo = _mm_xor_si128(*lo, _mm_clmulepi64_si128(a, b, 0x00));
+    *hi = _mm_xor_si128(*hi, _mm_clmulepi64_si128(a, b, 0x11));
+    *mid = _mm_xor_si128(*mid, _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01)));
+}
+
+// Sum of products to GF(2^128): shift left by one for the reflected order, reduce. Both steps
+// are linear, so one reduction serves any number of accumulated products
+static inline __m128i ghash_reduce(__m128i lo, __m128i mid, __m128i hi)
+{
+    __m128i t, carry_lo, carry_hi, carry_mid;
+
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+    // Shift the 256-bit product hi:lo left by one bit
+    carry_lo = _mm_srli_epi32(lo, 31);
+    carry_hi = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    carry_mid = _mm_srli_si128(carry_lo, 12);
+    carry_hi = _mm_slli_si128(carry_hi, 4);
+    carry_lo = _mm_slli_si128(carry_lo, 4);
+    lo = _mm_or_si128(lo, carry_lo);
+    hi = _mm_or_si128(hi, carry_hi);
+    hi = _mm_or_si128(hi, carry_mid);
+
+    // Reduce modulo x^128 + x^7 + x^2 + x + 1
+    t = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+    mid = _mm_srli_si128(t, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(t, 12));
+    t = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+    t = _mm_xor_si128(t, mid);
+    lo = _mm_xor_si128(lo, t);
+    return _mm_xor_si128(hi, lo);
+}
+
+static inline __m128i ghash_gfmul(__m128i a, __m128i b)
+{
+    __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+    ghash_mul_acc(a, b, &lo, &mid, &hi);
+    return ghash_reduce(lo, mid, hi);
+}
+
+// GHASH_AGG blocks at a time: Y' = (Y ^ X1) * H^n ^ X2 * H^(n-1) ^ ... ^ Xn * H, reduced once
+static void ghash_blocks(struct ghash_ctx *ctx, const uint8_t *p, size_t blocks)
+{
+    __m128i h = _mm_loadu_si128((const __m128i *)ctx->h[0]);
+    __m128i y = _mm_loadu_si128((const __m128i *)ctx->y);
+
+    for (; blocks >= GHASH_AGG; blocks -= GHASH_AGG, p += GHASH_AGG * GHASH_BLOCK_SIZE) {
+        __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+        ghash_mul_acc(_mm_xor_si128(y, ghash_load(p)), _mm_loadu_si128((const __m128i *)ctx->h[GHASH_AGG - 1]),
+                      &lo, &mid, &hi);
+        for (int i = 1; i < GHASH_AGG; i++) {
+            ghash_mul_acc(ghash_load(p + i * GHASH_BLOCK_SIZE),
+                          _mm_loadu_si128((const __m128i *)ctx->h[GHASH_AGG - 1 - i]), &lo, &mid, &hi);
+        }
+        y = ghash_reduce(lo, mid, hi);
+    }
+    while (blocks--) {
+        y = ghash_gfmul(_mm_xor_si128(y, ghash_load(p)), h);
+        p += GHASH_BLOCK_SIZE;
+    }
+    _mm_storeu_si128((__m128i *)ctx->y, y);
+}
+
+static void ghash_set_key(struct ghash_ctx *ctx, const uint8_t *h)
+{
+    __m128i h1 = ghash_load(h), hn = h1;
+
+    _mm_storeu_si128((__m128i *)ctx->h[0], h1);
+    for (int i = 1; i < GHASH_AGG; i++) {
+        hn = ghash_gfmul(hn, h1);
+        _mm_storeu_si128((__m128i *)ctx->h[i], hn);
+    }
+}
+
+static void ghash_get(const struct ghash_ctx *ctx, uint8_t *out)
+{
+    ghash_store(out, _mm_loadu_si128((const __m128i *)ctx->y));
+}
+
+const char *ghash_impl(void)
+{
+    return "pclmul";
+}
+
+#else
+
+// Internal form: the bits of each byte reversed and the 16 bytes read as a little-endian 128-bit
+// integer. Bit i is then the coefficient of x^i and GCM multiplication becomes a plain carry-less
+// product reduced modulo x^128 + x^7 + x^2 + x + 1, which maps directly onto PMULL.
+static const uint8_t rbit_nibble[16] = {
+    0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF
+};
+
+static inline uint8_t rbit8(uint8_t b)
+{
+    return (uint8_t)((rbit_nibble[b & 0xF] << 4) | rbit_nibble[b >> 4]);
+}
+
+#if defined(GHASH_PMULL)
+
+static inline uint64x2_t ghash_load(const uint8_t *p)
+{
+    return vreinterpretq_u64_u8(vrbitq_u8(vld1q_u8(p)));
+}
+
+static inline void ghash_store(uint8_t *p, uint64x2_t x)
+{
+    vst1q_u8(p, vrbitq_u8(vreinterpretq_u8_u64(x)));
+}
+
+static inline uint64x2_t clmul64(uint64_t a, uint64_t b)
+{
+    return vreinterpretq_u64_p128(vmull_p64((poly64_t)a, (poly64_t)b));
+}
+
+// Add the unreduced 256-bit product a * b to lo, mid (the cross terms) and hi
+static inline void ghash_mul_acc(uint64x2_t a, uint64x2_t b, uint64x2_t *lo, uint64x2_t *mid, uint64x2_t *hi)
+{
+    poly64x2_t pa = vreinterpretq_p64_u64(a), pb = vreinterpretq_p64_u64(b);
+    uint64x2_t cross;
+
+    *lo = veorq_u64(*lo, vreinterpretq_u64_p128(vmull_p64(vgetq_lane_p64(pa, 0), vgetq_lane_p64(pb, 0))));
+    *hi = veorq_u64(*hi, vreinterpretq_u64_p128(vmull_high_p64(pa, pb)));
+    cross = veorq_u64(vreinterpretq_u64_p128(vmull_p64(vgetq_lane_p64(pa, 0), vgetq_lane_p64(pb, 1))),
+                      vreinterpretq_u64_p128(vmull_p64(vgetq_lane_p64(pa, 1), vgetq_lane_p64(pb, 0))));
+    *mid = veorq_u64(*mid, cross);
+}
+
+// Sum of products modulo x^128 + x^7 + x^2 + x + 1, one reduction for any number of products
+static inline uint64x2_t ghash_reduce(uint64x2_t lo, uint64x2_t mid, uint64x2_t hi)
+{
+    uint64_t p0 = vgetq_lane_u64(lo, 0);
+    uint64_t p1 = vgetq_lane_u64(lo, 1) ^ vgetq_lane_u64(mid, 0);
+    uint64_t p2 = vgetq_lane_u64(hi, 0) ^ vgetq_lane_u64(mid, 1);
+    uint64_t p3 = vgetq_lane_u64(hi, 1);
+    uint64x2_t t;
+
+    // x^128 = x^7 + x^2 + x + 1: fold p3 into p2:p1, then p2 into p1:p0
+    t = clmul64(p3, 0x87);
+    p1 ^= vgetq_lane_u64(t, 0);
+    p2 ^= vgetq_lane_u64(t, 1);
+    t = clmul64(p2, 0x87);
+    return vcombine_u64(vcreate_u64(p0 ^ vgetq_lane_u64(t, 0)), vcreate_u64(p1 ^ vgetq_lane_u64(t, 1)));
+}
+
+static inline uint64x2_t ghash_gfmul(uint64x2_t a, uint64x2_t b)
+{
+    uint64x2_t lo = vdupq_n_u64(0), mid = vdupq_n_u64(0), hi = vdupq_n_u64(0);
+
+    ghash_mul_acc(a, b, &lo, &mid, &hi);
+    return ghash_reduce(lo, mid, hi);
+}
+
+// GHASH_AGG blocks at a time: Y' = (Y ^ X1) * H^n ^ X2 * H^(n-1) ^ ... ^ Xn * H, reduced once
+static void ghash_blocks(struct ghash_ctx *ctx, const uint8_t *p, size_t blocks)
+{
+    uint64x2_t h = vld1q_u64(ctx->h[0]);
+    uint64x2_t y = vld1q_u64(ctx->y);
+
+    for (; blocks >= GHASH_AGG; blocks -= GHASH_AGG, p += GHASH_AGG * GHASH_BLOCK_SIZE) {
+        uint64x2_t lo = vdupq_n_u64(0), mid = vdupq_n_u64(0), hi = vdupq_n_u64(0);
+
+        ghash_mul_acc(veorq_u64(y, ghash_load(p)), vld1q_u64(ctx->h[GHASH_AGG - 1]), &lo, &mid, &hi);
+        for (int i = 1; i < GHASH_AGG; i++) {
+            ghash_mul_acc(ghash_load(p + i * GHASH_BLOCK_SIZE), vld1q_u64(ctx->h[GHASH_AGG - 1 - i]),
+                          &lo, &mid, &hi);
+        }
+        y = ghash_reduce(lo, mid, hi);
+    }
+    while (blocks--) {
+        y = ghash_gfmul(veorq_u64(y, ghash_load(p)), h);
+        p += GHASH_BLOCK_SIZE;
+    }
+    vst1q_u64(ctx->y, y);
+}
+
+static void ghash_set_key(struct ghash_ctx *ctx, const uint8_t *h)
+{
+    uint64x2_t h1 = ghash_load(h), hn = h1;
+
+    vst1q_u64(ctx->h[0], h1);
+    for (int i = 1; i < GHASH_AGG; i++) {
+        hn = ghash_gfmul(hn, h1);
+        vst1q_u64(ctx->h[i], hn);
+    }
+}
+
+static void ghash_get(const struct ghash_ctx *ctx, uint8_t *out)
+{
+    ghash_store(out, vld1q_u64(ctx->y));
+}
+
+#else
+
+static inline void ghash_load_generic(const uint8_t *p, uint64_t x[2])
+{
+    x[0] = x[1] = 0;
+    for (int i = 0; i < 16; i++) {
+        x[i >> 3] |= (uint64_t)rbit8(p[i]) << (8 * (i & 7));
+    }
+}
+
+static inline void ghash_store_generic(uint8_t *p, const uint64_t x[2])
+{
+    for (int i = 0; i < 16; i++) {
+        p[i] = rbit8((uint8_t)(x[i >> 3] >> (8 * (i & 7))));
+    }
+}
+
+// 64x64 -> 128-bit carry-less product, r[0] low half
+static inline void clmul64_generic(uint64_t a, uint64_t b, uint64_t r[2])
+{
+    uint64_t lo = 0, hi = 0;
+
+    for (int i = 0; i < 64; i++) {
+        uint64_t mask = 0 - ((b >> i) & 1);
+        lo ^= (a << i) & mask;
+        hi ^= (i ? (a >> (64 - i)) : 0) & mask;
+    }
+    r[0] = lo;
+    r[1] = hi;
+}
+
+// a * b modulo x^128 + x^7 + x^2 + x + 1 in the bit-reflected form, r[0] low half
+static inline void ghash_gfmul(const uint64_t a[2], const uint64_t b[2], uint64_t r[2])
+{
+    uint64_t p0, p1, p2, p3;
+    uint64_t ll[2], hh[2], lh[2], hl[2], t[2];
+
+    clmul64_generic(a[0], b[0], ll);
+    clmul64_generic(a[1], b[1], hh);
+    clmul64_generic(a[0], b[1], lh);
+    clmul64_generic(a[1], b[0], hl);
+
+    p0 = ll[0];
+    p1 = ll[1] ^ lh[0] ^ hl[0];
+    p2 = hh[0] ^ lh[1] ^ hl[1];
+    p3 = hh[1];
+
+    // x^128 = x^7 + x^2 + x + 1: fold p3 into p2:p1, then p2 into p1:p0
+    clmul64_generic(p3, 0x87, t);
+    p1 ^= t[0];
+    p2 ^= t[1];
+    clmul64_generic(p2, 0x87, t);
+    r[0] = p0 ^ t[0];
+    r[1] = p1 ^ t[1];
+}
+
+// One block at a time, aggregation does not pay without a carry-less multiply instruction
+static void ghash_blocks(struct ghash_ctx *ctx, const uint8_t *p, size_t blocks)
+{
+    uint64_t x[2];
+
+    while (blocks--) {
+        ghash_load_generic(p, x);
+        x[0] ^= ctx->y[0];
+        x[1] ^= ctx->y[1];
+        ghash_gfmul(x, ctx->h[0], ctx->y);
+        p += GHASH_BLOCK_SIZE;
+    }
+}
+
+// The powers are kept for a uniform context layout
+static void ghash_set_key(struct ghash_ctx *ctx, const uint8_t *h)
+{
+    ghash_load_generic(h, ctx->h[0]);
+    for (int i = 1; i < GHASH_AGG; i++) {
+        ghash_gfmul(ctx->h[i - 1], ctx->h[0], ctx->h[i]);
+    }
+}
+
+static void ghash_get(const struct ghash_ctx *ctx, uint8_t *out)
+{
+    ghash_store_generic(out, ctx->y);
+}
+
+#endif
+
+const char *ghash_impl(void)
+{
+#if defined(GHASH_PMULL)
+    return "pmull";
+#else
+    return "generic";
+#endif
+}
+
+#endif
+
+// Hash whole blocks, then a zero-padded tail
+static void ghash_absorb(struct ghash_ctx *ctx, const uint8_t *p, size_t len)
+{
+    uint8_t block[GHASH_BLOCK_SIZE];
+    size_t blocks = len / GHASH_BLOCK_SIZE;
+    size_t tail = len % GHASH_BLOCK_SIZE;
+
+    ghash_blocks(ctx, p, blocks);
+    if (tail) {
+        memset(block, 0, sizeof(block));
+        memcpy(block, p + blocks * GHASH_BLOCK_SIZE, tail);
+        ghash_blocks(ctx, block, 1);
+    }
+}
+
+void ghash_init(struct ghash_ctx *ctx, const uint8_t h[GHASH_BLOCK_SIZE])
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ghash_set_key(ctx, h);
+}
+
+void ghash_reset(struct ghash_ctx *ctx)
+{
+    ctx->y[0] = ctx->y[1] = 0;
+    ctx->aad_len = ctx->ct_len = 0;
+}
+
+void ghash_update_aad(struct ghash_ctx *ctx, const uint8_t *aad, size_t len)
+{
+    ghash_absorb(ctx, aad, len);
+    ctx->aad_len += len;
+}
+
+void ghash_update(struct ghash_ctx *ctx, const uint8_t *ct, size_t len)
+{
+    ghash_absorb(ctx, ct, len);
+    ctx->ct_len += len;
+}
+
+void ghash_final(struct ghash_ctx *ctx, uint8_t out[GHASH_BLOCK_SIZE])
+{
+    uint8_t block[GHASH_BLOCK_SIZE];
+    uint64_t aad_bits = ctx->aad_len * 8;
+    uint64_t ct_bits = ctx->ct_len * 8;
+
+    // len(A) || len(C) in bits, both 64-bit big-endian
+    for (int i = 0; i < 8; i++) {
+        block[i] = (uint8_t)(aad_bits >> (56 - 8 * i));
+        block[8 + i] = (uint8_t)(ct_bits >> (56 - 8 * i));
+    }
+    ghash_blocks(ctx, block, 1);
+    ghash_get(ctx, out);
+}
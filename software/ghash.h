@@ -0,0 +1,36 @@
+#ifndef GHASH_H
+#define GHASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define GHASH_BLOCK_SIZE    16
+#define GHASH_AGG           8       /* Blocks hashed per reduction */
+
+/* GHASH state for one AES-GCM message */
+struct ghash_ctx {
+    uint64_t h[GHASH_AGG][2];   /* H^1..H^GHASH_AGG, H = E(K, 0^128), in the multiplier's internal form */
+    uint64_t y[2];              /* Running hash in the multiplier's internal form */
+    uint64_t aad_len;           /* AAD bytes hashed */
+    uint64_t ct_len;            /* Ciphertext bytes hashed */
+};
+
+// Start a hash with H = E(K, 0^128) in GCM byte order
+void ghash_init(struct ghash_ctx *ctx, const uint8_t h[GHASH_BLOCK_SIZE]);
+
+// Start the next message with the same H, keeping the precomputed powers
+void ghash_reset(struct ghash_ctx *ctx);
+
+// Hash AAD. Only the last call may pass a length that is not a multiple of 16, the tail is zero padded
+void ghash_update_aad(struct ghash_ctx *ctx, const uint8_t *aad, size_t len);
+
+// Hash ciphertext, same rule for partial blocks
+void ghash_update(struct ghash_ctx *ctx, const uint8_t *ct, size_t len);
+
+// Hash the length block and write S in GCM byte order (tag = E(K, J0) xor S)
+void ghash_final(struct ghash_ctx *ctx, uint8_t out[GHASH_BLOCK_SIZE]);
+
+// Name of the carry-less multiply in use: "pmull", "pclmul" or "generic"
+const char *ghash_impl(void);
+
+#endif // GHASH_H